@@ -0,0 +1,437 @@
+// This file is part of Alelib, a toolbox for finite element codes.
+//
+// Alelib is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// Alelib is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// Alelib. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALELIB_DOF_CONSTRAINTS_HPP
+#define ALELIB_DOF_CONSTRAINTS_HPP
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "dof_mapper.hpp"
+#include "../util/assert.hpp"
+
+namespace alelib
+{
+
+/**
+*  Dirichlet and linear (e.g. hanging node) constraints on the dofs of a DofMapper.
+*
+*  Each constrained dof satisfies u_d = sum_k w_k u_{m_k} + b_d. After close(), the
+*  remaining dofs are numbered contiguously as "free" dofs, preserving their order,
+*  and the constrained dofs are expressed in terms of the free ones only: u = C u_f + b.
+*  condense() turns an element system into its contribution to the reduced system
+*  C^T K C u_f = C^T (F - K b), so the global system never holds constrained rows.
+*/
+template<class Mesh_t>
+class DofConstraints
+{
+public:
+  typedef Mesh_t MeshT;
+  typedef typename MeshT::VertexH VertexH;
+  typedef typename MeshT::CellH CellH;
+  typedef typename MeshT::FacetH FacetH;
+  typedef typename MeshT::RidgeH RidgeH;
+  typedef DofMapper<Mesh_t> DofMapperT;
+  typedef VarDofs<Mesh_t> VarT;
+
+protected:
+
+  struct Constraint
+  {
+    std::vector<index_t> masters;
+    std::vector<Real>    weights;
+    Real                 inhomogeneity;
+  };
+
+  std::map<index_t, Constraint> m_constraints; // given by the user, relative to m_first_dof
+
+  index_t m_first_dof;
+  index_t m_n_dofs;
+  bool    m_closed;
+
+  // after close()
+  std::vector<index_t> m_free_index; // free number of each dof, -1 if constrained
+  std::vector<index_t> m_ptr;        // C row of dof d: [m_ptr[d], m_ptr[d+1]), empty for free dofs
+  std::vector<index_t> m_cols;       // free numbers
+  std::vector<Real>    m_vals;
+  std::vector<Real>    m_inhom;      // b
+  index_t              m_n_free;
+
+public:
+
+  explicit DofConstraints(DofMapperT const* mapper = NULL)
+    : m_constraints(), m_first_dof(0), m_n_dofs(0), m_closed(false), m_n_free(0)
+  {
+    if (mapper)
+      attachDofMapper(mapper);
+  }
+
+  /// Takes the number of dofs and the initial dof of `mapper`. Clears all constraints.
+  void attachDofMapper(DofMapperT const* mapper)
+  {
+    m_constraints.clear();
+    m_first_dof = mapper->initialDof();
+    m_n_dofs = mapper->numDofs();
+    m_closed = false;
+  }
+
+  /// Dirichlet condition u_dof = value.
+  void addDirichlet(index_t dof, Real value = 0)
+  {
+    ALELIB_CHECK(!m_closed, "DofConstraints: already closed", std::runtime_error);
+    ALELIB_CHECK(dof >= m_first_dof && dof < m_first_dof + m_n_dofs, "DofConstraints: invalid dof", std::invalid_argument);
+
+    Constraint & c = m_constraints[dof - m_first_dof];
+    c.masters.clear();
+    c.weights.clear();
+    c.inhomogeneity = value;
+  }
+
+  /// Dirichlet conditions on a list of dofs; values = NULL means homogeneous. Negative dofs are ignored.
+  void addDirichlet(index_t n, index_t const* dofs, Real const* values = NULL)
+  {
+    for (index_t i = 0; i < n; ++i)
+      if (dofs[i] >= 0)
+        addDirichlet(dofs[i], values ? values[i] : 0);
+  }
+
+  /// Dirichlet condition u = value on all dofs of the variable `var` that live in
+  /// vertices, ridges, facets or cells with one of the given tags.
+  void addDirichletByTags(DofMapperT const& mapper, int var, int n_tags, int const* tags, Real value = 0)
+  {
+    std::vector<index_t> dofs;
+    collectDofs(dofs, mapper.variable(var), -1, n_tags, tags);
+    for (unsigned i = 0; i < dofs.size(); ++i)
+      addDirichlet(dofs[i], value);
+  }
+
+  /// Dirichlet condition u = value on all dofs of the variable `var` in the region `region`.
+  void addDirichletByRegion(DofMapperT const& mapper, int var, int region, Real value = 0)
+  {
+    std::vector<index_t> dofs;
+    collectDofs(dofs, mapper.variable(var), region, 0, NULL);
+    for (unsigned i = 0; i < dofs.size(); ++i)
+      addDirichlet(dofs[i], value);
+  }
+
+  /// Linear constraint u_dof = sum_k weights[k] u_{masters[k]} + inhomogeneity.
+  /// Masters may be constrained themselves, as long as there are no cycles.
+  void addConstraint(index_t dof, int n_masters, index_t const* masters, Real const* weights, Real inhomogeneity = 0)
+  {
+    ALELIB_CHECK(!m_closed, "DofConstraints: already closed", std::runtime_error);
+    ALELIB_CHECK(dof >= m_first_dof && dof < m_first_dof + m_n_dofs, "DofConstraints: invalid dof", std::invalid_argument);
+
+    Constraint & c = m_constraints[dof - m_first_dof];
+    c.masters.assign(masters, masters + n_masters);
+    c.weights.assign(weights, weights + n_masters);
+    c.inhomogeneity = inhomogeneity;
+    for (int k = 0; k < n_masters; ++k)
+    {
+      ALELIB_CHECK(masters[k] >= m_first_dof && masters[k] < m_first_dof + m_n_dofs && masters[k] != dof,
+                   "DofConstraints: invalid master dof", std::invalid_argument);
+      c.masters[k] -= m_first_dof;
+    }
+  }
+
+  bool isConstrained(index_t dof) const
+  { return m_constraints.find(dof - m_first_dof) != m_constraints.end(); }
+
+  index_t numConstrained() const
+  { return m_constraints.size(); }
+
+  /// Resolves chains of constraints and builds the free numbering and the matrix C.
+  /// Each constrained dof is closed once, after its masters (depth-first, without
+  /// recursion), so masters shared by many dofs are not expanded again.
+  /// Throws std::runtime_error if the constraints have a cycle.
+  void close()
+  {
+    m_free_index.assign(m_n_dofs, -1);
+    m_n_free = 0;
+    for (index_t d = 0; d < m_n_dofs; ++d)
+      if (m_constraints.find(d) == m_constraints.end())
+        m_free_index[d] = m_n_free++;
+
+    m_inhom.assign(m_n_dofs, 0);
+
+    // closed rows, in the order they are closed: [row_begin[d], row_end[d]) of cols/vals
+    std::vector<index_t> row_begin(m_n_dofs, 0), row_end(m_n_dofs, 0);
+    std::vector<index_t> cols;
+    std::vector<Real>    vals;
+
+    // sparse accumulator of a row, by free number
+    std::vector<Real>    acc(m_n_free, 0.);
+    std::vector<char>    used(m_n_free, 0);
+    std::vector<index_t> touched;
+
+    enum { UNVISITED, VISITING, DONE };
+    std::vector<char> state(m_n_dofs, UNVISITED);
+    std::vector<std::pair<Constraint const*, unsigned> > stack; // constraint and its next master
+    std::vector<index_t> stack_dofs;
+
+    typename std::map<index_t, Constraint>::const_iterator it = m_constraints.begin();
+    for (; it != m_constraints.end(); ++it)
+    {
+      if (state[it->first] == DONE)
+        continue;
+      state[it->first] = VISITING;
+      stack.push_back(std::make_pair(&it->second, 0u));
+      stack_dofs.push_back(it->first);
+
+      while (!stack.empty())
+      {
+        Constraint const& c = *stack.back().first;
+        unsigned & k = stack.back().second;
+
+        // visit the constrained masters first
+        if (k < c.masters.size())
+        {
+          index_t const m = c.masters[k++];
+          if (m_free_index[m] >= 0 || state[m] == DONE)
+            continue;
+          ALELIB_ASSERT(state[m] != VISITING, "DofConstraints: cyclic constraints", std::runtime_error);
+          state[m] = VISITING;
+          stack.push_back(std::make_pair(&m_constraints.find(m)->second, 0u));
+          stack_dofs.push_back(m);
+          continue;
+        }
+
+        // all masters are free or closed: close this one
+        index_t const d = stack_dofs.back();
+        Real b = c.inhomogeneity;
+        for (unsigned j = 0; j < c.masters.size(); ++j)
+        {
+          index_t const m = c.masters[j];
+          Real const w = c.weights[j];
+          if (m_free_index[m] >= 0)
+            accumulate(m_free_index[m], w, acc, used, touched);
+          else
+          {
+            for (index_t q = row_begin[m]; q < row_end[m]; ++q)
+              accumulate(cols[q], w*vals[q], acc, used, touched);
+            b += w*m_inhom[m];
+          }
+        }
+        std::sort(touched.begin(), touched.end());
+        row_begin[d] = cols.size();
+        for (unsigned j = 0; j < touched.size(); ++j)
+        {
+          cols.push_back(touched[j]);
+          vals.push_back(acc[touched[j]]);
+          acc[touched[j]] = 0.;
+          used[touched[j]] = 0;
+        }
+        row_end[d] = cols.size();
+        touched.clear();
+        m_inhom[d] = b;
+
+        state[d] = DONE;
+        stack.pop_back();
+        stack_dofs.pop_back();
+      }
+    }
+
+    // the rows in the order of the dofs
+    m_ptr.assign(m_n_dofs + 1, 0);
+    m_cols.clear();
+    m_vals.clear();
+    m_cols.reserve(cols.size());
+    m_vals.reserve(vals.size());
+    for (index_t d = 0; d < m_n_dofs; ++d)
+    {
+      m_cols.insert(m_cols.end(), cols.begin() + row_begin[d], cols.begin() + row_end[d]);
+      m_vals.insert(m_vals.end(), vals.begin() + row_begin[d], vals.begin() + row_end[d]);
+      m_ptr[d+1] = m_cols.size();
+    }
+
+    m_closed = true;
+  }
+
+  bool isClosed() const
+  { return m_closed; }
+
+  index_t numFreeDofs() const
+  { return m_n_free; }
+
+  /// free number of the dof (starting at 0), or -1 if it is constrained
+  index_t freeIndex(index_t dof) const
+  { return m_free_index[dof - m_first_dof]; }
+
+  /// row of C for `dof`: u_dof = sum_k vals[k] u_f[cols[k]] + inhomogeneity(dof).
+  /// @return the number of entries; 0 for free dofs
+  index_t constraintRow(index_t dof, index_t const** cols, Real const** vals) const
+  {
+    index_t const d = dof - m_first_dof;
+    *cols = m_cols.data() + m_ptr[d];
+    *vals = m_vals.data() + m_ptr[d];
+    return m_ptr[d+1] - m_ptr[d];
+  }
+
+  Real inhomogeneity(index_t dof) const
+  { return m_inhom[dof - m_first_dof]; }
+
+  /// Condenses an element system onto the free dofs.
+  /// @param n number of element dofs, `dofs` their numbers (-1 entries are skipped).
+  /// @param Ke n x n element matrix (row major), Fe element vector (may be NULL).
+  /// @param[out] fdofs the m free numbers the element contributes to, Kf (m x m) and Ff (m).
+  void condense(int n, index_t const* dofs, Real const* Ke, Real const* Fe,
+                std::vector<index_t> & fdofs, std::vector<Real> & Kf, std::vector<Real> & Ff) const
+  {
+    ALELIB_CHECK(m_closed, "DofConstraints: close() must be called before", std::runtime_error);
+
+    // local position in fdofs of each entry of each C row
+    fdofs.clear();
+    std::vector<index_t> begin(n+1, 0), pos;
+    std::vector<Real> w, b(n, 0.);
+    for (int i = 0; i < n; ++i)
+    {
+      if (dofs[i] >= 0)
+      {
+        index_t const d = dofs[i] - m_first_dof;
+        if (m_free_index[d] >= 0)
+        {
+          pos.push_back(localPos(fdofs, m_free_index[d]));
+          w.push_back(1.);
+        }
+        else
+        {
+          for (index_t k = m_ptr[d]; k < m_ptr[d+1]; ++k)
+          {
+            pos.push_back(localPos(fdofs, m_cols[k]));
+            w.push_back(m_vals[k]);
+          }
+          b[i] = m_inhom[d];
+        }
+      }
+      begin[i+1] = pos.size();
+    }
+
+    int const m = fdofs.size();
+    Kf.assign(m*m, 0.);
+    Ff.assign(m, 0.);
+
+    for (int i = 0; i < n; ++i)
+    {
+      if (begin[i] == begin[i+1])
+        continue;
+
+      // F - K b
+      Real fi = Fe ? Fe[i] : 0.;
+      for (int j = 0; j < n; ++j)
+        fi -= Ke[i*n + j]*b[j];
+
+      for (index_t a = begin[i]; a < begin[i+1]; ++a)
+      {
+        Ff[pos[a]] += w[a]*fi;
+        for (int j = 0; j < n; ++j)
+          for (index_t c = begin[j]; c < begin[j+1]; ++c)
+            Kf[pos[a]*m + pos[c]] += w[a]*Ke[i*n + j]*w[c];
+      }
+    }
+  }
+
+  /// Computes all dofs from the free ones: u = C u_free + b.
+  void distribute(Real const* u_free, Real* u) const
+  {
+    ALELIB_CHECK(m_closed, "DofConstraints: close() must be called before", std::runtime_error);
+    for (index_t d = 0; d < m_n_dofs; ++d)
+    {
+      if (m_free_index[d] >= 0)
+      {
+        u[d] = u_free[m_free_index[d]];
+        continue;
+      }
+      Real val = m_inhom[d];
+      for (index_t k = m_ptr[d]; k < m_ptr[d+1]; ++k)
+        val += m_vals[k]*u_free[m_cols[k]];
+      u[d] = val;
+    }
+  }
+
+private:
+
+  static void accumulate(index_t col, Real val, std::vector<Real> & acc, std::vector<char> & used,
+                         std::vector<index_t> & touched)
+  {
+    if (!used[col])
+    {
+      used[col] = 1;
+      touched.push_back(col);
+    }
+    acc[col] += val;
+  }
+
+  static index_t localPos(std::vector<index_t> & fdofs, index_t free_dof)
+  {
+    std::vector<index_t>::iterator it = std::find(fdofs.begin(), fdofs.end(), free_dof);
+    if (it != fdofs.end())
+      return it - fdofs.begin();
+    fdofs.push_back(free_dof);
+    return fdofs.size() - 1;
+  }
+
+  // dofs of `var` in the entities with one of the tags (if tags != NULL) or in the
+  // region (if region >= 0)
+  void collectDofs(std::vector<index_t> & dofs, VarT const& var, int region, int n_tags, int const* tags) const
+  {
+    MeshT const* mp = var.mesh();
+    int const reg_begin = region >= 0 ? region : 0;
+    int const reg_end   = region >= 0 ? region + 1 : var.numRegions();
+    index_t buf[64];
+
+    ALELIB_CHECK(var.numDofsInVertex() <= 64 && var.numDofsInRidge() <= 64 &&
+                 var.numDofsInFacet()  <= 64 && var.numDofsInCell()  <= 64,
+                 "DofConstraints: too many dofs per entity", std::runtime_error);
+
+    for (int reg = reg_begin; reg < reg_end; ++reg)
+    {
+      for (VertexH p = mp->vertexBegin(), p_end = mp->vertexEnd(); p != p_end; ++p)
+        if (!p.isDisabled(mp) && hasTag(p.tag(mp), n_tags, tags))
+          dofs.insert(dofs.end(), buf, var.getVertexDofs(buf, p, reg));
+
+      if (MeshT::cell_dim > 2)
+        for (RidgeH p = mp->ridgeBegin(), p_end = mp->ridgeEnd(); p != p_end; ++p)
+          if (!p.isDisabled(mp) && hasTag(p.tag(mp), n_tags, tags))
+            dofs.insert(dofs.end(), buf, var.getDofsInRidge(buf, p, reg));
+
+      if (MeshT::cell_dim > 1)
+        for (FacetH p = mp->facetBegin(), p_end = mp->facetEnd(); p != p_end; ++p)
+          if (!p.isDisabled(mp) && hasTag(p.tag(mp), n_tags, tags))
+            dofs.insert(dofs.end(), buf, var.getDofsInFacet(buf, p, reg));
+
+      for (CellH p = mp->cellBegin(), p_end = mp->cellEnd(); p != p_end; ++p)
+        if (!p.isDisabled(mp) && hasTag(p.tag(mp), n_tags, tags) && var.region(p.tag(mp)) == reg)
+          dofs.insert(dofs.end(), buf, var.getDofsInCell(buf, p));
+    }
+
+    dofs.erase(std::remove(dofs.begin(), dofs.end(), -1), dofs.end());
+    std::sort(dofs.begin(), dofs.end());
+    dofs.erase(std::unique(dofs.begin(), dofs.end()), dofs.end());
+  }
+
+  static bool hasTag(int tag, int n_tags, int const* tags)
+  { return tags == NULL || std::find(tags, tags + n_tags, tag) != tags + n_tags; }
+
+};
+
+} // end namespace alelib
+
+
+#endif
@@ -23,12 +23,43 @@
 #define ALELIB_DOF_MAPPER_HPP
 
 #include <vector>
+#include <set>
+#include <algorithm>
 #include "var_dof.hpp"
+#include "../mesh/mesh_changes.hpp"
 #include "../util/assert.hpp"
+#include "../util/cuthil_mckee.hpp"
 
 namespace alelib
 {
 
+/// How the dofs are numbered by DofMapper::SetUp
+enum EDofOrdering
+{
+  DOF_ORDER_BLOCKED       = 0, // variable by variable: vertices, ridges, facets and cells (default)
+  DOF_ORDER_INTERLEAVED   = 1, // entity by entity, all variables and components of an entity together
+  DOF_ORDER_CELL_LOCALITY = 2, // in the order the cells of the mesh visit them
+  DOF_ORDER_RCM           = 3  // reverse Cuthill-McKee over the dof graph (bandwidth reduction)
+};
+
+/// Kind of entity a dof lives in. The values follow the order of the VarDofs containers.
+enum EDofEntity
+{
+  DOF_AT_VERTEX = 0,
+  DOF_AT_RIDGE  = 1,
+  DOF_AT_FACET  = 2,
+  DOF_AT_CELL   = 3
+};
+
+/// What a dof is, see DofMapper::dofInfo()
+struct DofInfo
+{
+  index_t  entity;   // id of the vertex, ridge, facet or cell
+  uint16_t var;      // variable index
+  uint8_t  kind;     // EDofEntity
+  uint8_t  comp;     // component within the entity
+};
+
 template<class Mesh_t>
 class DofMapper
 {
@@ -46,10 +77,16 @@ protected:
   MeshT const* m_mp;
   index_t m_n_links;
   std::vector<VarT> m_vars;
+  EDofOrdering m_ordering;
+  std::vector<index_t> m_perm; // m_perm[i] = new number of the dof that DOF_ORDER_BLOCKED numbers as i
+  index_t m_first_dof;         // initial dof given to SetUp()
+  std::vector<DofInfo> m_dof_info; // inverse table, see buildInverseMap()
+  bool m_has_inverse;
 
 public:
 
-  DofMapper(MeshT const* mesh = NULL) : m_mp(mesh), m_n_links(0), m_vars()
+  DofMapper(MeshT const* mesh = NULL) : m_mp(mesh), m_n_links(0), m_vars(), m_ordering(DOF_ORDER_BLOCKED), m_perm(),
+                                         m_first_dof(0), m_dof_info(), m_has_inverse(false)
   {}
 
   /*  Add a variable.
@@ -87,6 +124,13 @@ public:
     m_mp = mesh;
   }
 
+  MeshT const* mesh() const
+  { return m_mp; }
+
+  /// the initial dof given to SetUp()
+  index_t initialDof() const
+  { return m_first_dof; }
+
   int numVars() const
   { return m_vars.size(); }
 
@@ -106,16 +150,408 @@ public:
     return total;
   }
 
+  /// Set the ordering strategy used by the next calls of SetUp().
+  void setOrdering(EDofOrdering ord)
+  { m_ordering = ord; }
+
+  EDofOrdering ordering() const
+  { return m_ordering; }
+
+  /// The permutation applied by the last SetUp(), relative to the initial dof:
+  /// permutation()[i] is the new number of the dof that DOF_ORDER_BLOCKED would number
+  /// as i. It is the identity for DOF_ORDER_BLOCKED.
+  /// It is empty after updateDofs().
+  /// @note linkDofs() changes the numbering afterwards and is not reflected here.
+  std::vector<index_t> const& permutation() const
+  { return m_perm; }
+
   void SetUp(index_t initial_dof = 0)
   {
+    index_t const first = initial_dof;
+    m_first_dof = first;
     for (unsigned i = 0; i < m_vars.size(); ++i)
     {
       m_vars[i].setUp(initial_dof);
       initial_dof += m_vars[i].numPositiveDofs();
     }
+
+    index_t const n_dofs = initial_dof - first;
+
+    m_perm.assign(n_dofs, -1);
+
+    switch (m_ordering)
+    {
+      case DOF_ORDER_BLOCKED:       break;
+      case DOF_ORDER_INTERLEAVED:   orderInterleaved(first);  break;
+      case DOF_ORDER_CELL_LOCALITY: orderCellLocality(first); break;
+      case DOF_ORDER_RCM:           orderRcm(first);          break;
+      default:
+        ALELIB_CHECK(false, "invalid dof ordering", std::invalid_argument);
+    }
+
+    // dofs that were not reached by the strategy keep their relative order at the end
+    index_t counter = 0;
+    for (index_t i = 0; i < n_dofs; ++i)
+      counter = std::max(counter, m_perm[i] + 1);
+    for (index_t i = 0; i < n_dofs; ++i)
+      if (m_perm[i] < 0)
+        m_perm[i] = counter++;
+
+    if (m_ordering != DOF_ORDER_BLOCKED)
+      renumber(first, m_perm);
+
+    refreshInverseMap();
+  }
+
+  /// Renumbers the dofs: the dof `initial_dof + i` becomes `initial_dof + perm[i]`,
+  /// where initial_dof is the one given to SetUp(). permutation() is updated accordingly.
+  void permuteDofs(std::vector<index_t> const& perm)
+  {
+    ALELIB_CHECK((index_t)perm.size() == numDofs(), "permuteDofs: wrong permutation size", std::invalid_argument);
+
+    renumber(m_first_dof, perm);
+    for (unsigned i = 0; i < m_perm.size(); ++i)
+      m_perm[i] = perm[m_perm[i]];
+
+    refreshInverseMap();
+  }
+
+  /// Builds the inverse table dof -> (variable, entity kind, entity id, component),
+  /// in parallel. Once built, it is kept up to date by SetUp(), updateDofs(),
+  /// permuteDofs() and linkDofs(). A dof shared by several entities (see linkDofs())
+  /// is described by the first one, in the order var, kind, entity id, region.
+  void buildInverseMap()
+  {
+    m_has_inverse = true;
+    m_dof_info.resize(numDofs());
+
+    DofInfo none;
+    none.entity = -1;
+    none.var = 0;
+    none.kind = 0;
+    none.comp = 0;
+    std::fill(m_dof_info.begin(), m_dof_info.end(), none);
+
+    for (unsigned i = 0; i < m_vars.size(); ++i)
+    {
+      typename VarT::Container const* cs[] = {&m_vars[i].m_verts_dofs, &m_vars[i].m_ridges_dofs,
+                                               &m_vars[i].m_facets_dofs, &m_vars[i].m_cells_dofs};
+      for (int k = 0; k < 4; ++k)
+      {
+        typename VarT::Container const& c = *cs[k];
+        index_t const n_entities = c.size() == 0 ? 0 : c.numEntities();
+        int const n_comps = c.numComps();
+        ALELIB_CHECK(i < 65536 && n_comps < 256, "buildInverseMap: too many variables or components", std::runtime_error);
+
+        // with linked dofs, several entities write the same dof: keep it serial so the first one wins
+        bool const no_links = m_n_links == 0;
+        (void)no_links;
+        ALE_PRAGMA_OMP(parallel for if(no_links))
+        for (index_t id = 0; id < n_entities; ++id)
+          for (int reg = 0; reg < c.numRegions(); ++reg)
+          {
+            index_t const* dofs = c.find(reg, id);
+            if (!dofs)
+              continue;
+            for (int j = 0; j < n_comps; ++j)
+            {
+              if (dofs[j] < 0)
+                continue;
+              DofInfo & info = m_dof_info[dofs[j] - m_first_dof];
+              if (info.entity >= 0)
+                continue;
+              info.entity = id;
+              info.var    = (uint16_t)i;
+              info.kind   = (uint8_t)k;
+              info.comp   = (uint8_t)j;
+            }
+          }
+      }
+    }
+  }
+
+  bool hasInverseMap() const
+  { return m_has_inverse; }
+
+  /// What the dof is. buildInverseMap() must be called before.
+  DofInfo const& dofInfo(index_t dof) const
+  {
+    ALELIB_CHECK(m_has_inverse, "dofInfo: call buildInverseMap() before", std::runtime_error);
+    return m_dof_info[dof - m_first_dof];
+  }
+
+  /// Updates the numbering after local changes of the mesh. Only the dofs of the
+  /// entities listed in `changes` are touched (see Mesh::trackChanges): the dofs of
+  /// removed entities are freed and their numbers are given to the dofs of the added
+  /// entities; new numbers are appended only when no freed number is left. If some
+  /// freed numbers remain unused, the dofs with the highest numbers are moved into
+  /// them, so the numbering stays contiguous.
+  /// @param changes entities added and removed since the last SetUp() or updateDofs().
+  /// @param[out] old_to_new old_to_new[i] is the new number of the old dof i, or -1
+  ///             if it was removed. Both are relative to the initial dof of SetUp().
+  /// @note linked dofs (see linkDofs()) are not supported.
+  void updateDofs(MeshChanges const& changes, std::vector<index_t> & old_to_new)
+  {
+    ALELIB_CHECK(m_n_links == 0, "updateDofs: linked dofs are not supported", std::runtime_error);
+
+    index_t const first = m_first_dof;
+    index_t const n_old = numDofs();
+
+    old_to_new.resize(n_old);
+    for (index_t i = 0; i < n_old; ++i)
+      old_to_new[i] = i;
+
+    m_perm.clear();
+
+    // free the dofs of the removed entities
+    std::vector<index_t> freed;
+    for (unsigned i = 0; i < m_vars.size(); ++i)
+    {
+      VarT & var = m_vars[i];
+      var.growContainers();
+      var.m_n_positive_dofs -= freeDofs(var.m_verts_dofs,  changes.removed_verts,  freed);
+      var.m_n_positive_dofs -= freeDofs(var.m_ridges_dofs, changes.removed_ridges, freed);
+      var.m_n_positive_dofs -= freeDofs(var.m_facets_dofs, changes.removed_facets, freed);
+      var.m_n_positive_dofs -= freeDofs(var.m_cells_dofs,  changes.removed_cells,  freed);
+    }
+    std::sort(freed.begin(), freed.end());
+    for (unsigned k = 0; k < freed.size(); ++k)
+      old_to_new[freed[k] - first] = -1;
+
+    // number the dofs of the added entities, smallest freed numbers first
+    unsigned next_free = 0;
+    index_t counter = first + n_old;
+    for (unsigned i = 0; i < m_vars.size(); ++i)
+    {
+      VarT & var = m_vars[i];
+      var.m_n_positive_dofs += numberDofs<VertexH>(var, var.m_verts_dofs,  changes.added_verts,  freed, next_free, counter);
+      var.m_n_positive_dofs += numberDofs<RidgeH >(var, var.m_ridges_dofs, changes.added_ridges, freed, next_free, counter);
+      var.m_n_positive_dofs += numberDofs<FacetH >(var, var.m_facets_dofs, changes.added_facets, freed, next_free, counter);
+      var.m_n_positive_dofs += numberDofs<CellH  >(var, var.m_cells_dofs,  changes.added_cells,  freed, next_free, counter);
+    }
+
+    if (next_free == freed.size())
+    {
+      refreshInverseMap();
+      return;
+    }
+
+    // Close the gaps. Since freed numbers are reused in increasing order, the dofs
+    // numbered beyond `end` are all old dofs, and there are as many of them as
+    // unused freed numbers below `end`.
+    index_t const end = first + n_old - (index_t)(freed.size() - next_free);
+    for (unsigned i = 0; i < m_vars.size(); ++i)
+    {
+      typename VarT::Container * cs[] = {&m_vars[i].m_verts_dofs, &m_vars[i].m_ridges_dofs,
+                                         &m_vars[i].m_facets_dofs, &m_vars[i].m_cells_dofs};
+      for (int k = 0; k < 4; ++k)
+      {
+        typename VarT::Container & c = *cs[k];
+        for (index_t j = 0; j < (index_t)c.size(); ++j)
+        {
+          index_t const dof = c.access(j);
+          if (dof < end)
+            continue;
+          ALELIB_ASSERT(next_free < freed.size() && freed[next_free] < end, "updateDofs: inconsistent dofs", std::runtime_error);
+          old_to_new[dof - first] = freed[next_free] - first;
+          c.access(j) = freed[next_free++];
+        }
+      }
+    }
+    refreshInverseMap();
   }
 
   private:
+
+  void refreshInverseMap()
+  {
+    if (m_has_inverse)
+      buildInverseMap();
+  }
+
+  // free the dofs stored for the entities `ids`; return how many were freed
+  static index_t freeDofs(typename VarT::Container & c, std::vector<index_t> const& ids, std::vector<index_t> & freed)
+  {
+    if (c.size() == 0)
+      return 0;
+    index_t n = 0;
+    for (unsigned k = 0; k < ids.size(); ++k)
+    {
+      for (int reg = 0; reg < c.numRegions(); ++reg)
+      {
+        index_t const* dofs = c.find(reg, ids[k]);
+        if (!dofs)
+          continue;
+        for (int j = 0; j < c.numComps(); ++j)
+          if (dofs[j] >= 0)
+          {
+            freed.push_back(dofs[j]);
+            ++n;
+          }
+      }
+      c.erase(ids[k]);
+    }
+    return n;
+  }
+
+  // number the dofs of the enabled entities `ids` that do not have dofs yet;
+  // return how many were numbered
+  template<class Handle>
+  index_t numberDofs(VarT const& var, typename VarT::Container & c, std::vector<index_t> const& ids,
+                     std::vector<index_t> const& freed, unsigned & next_free, index_t & counter)
+  {
+    if (c.size() == 0)
+      return 0;
+    index_t n = 0;
+    for (unsigned k = 0; k < ids.size(); ++k)
+    {
+      Handle const h(ids[k]);
+      if (h.isDisabled(m_mp))
+        continue;
+      int const tag = h.tag(m_mp);
+      for (int reg = 0; reg < c.numRegions(); ++reg)
+      {
+        if (!var.inRegion(reg, tag))
+          continue;
+        index_t* dofs = c.insert(reg, ids[k]);
+        if (dofs[0] >= 0)
+          continue;
+        for (int j = 0; j < c.numComps(); ++j)
+        {
+          dofs[j] = next_free < freed.size() ? freed[next_free++] : counter++;
+          ++n;
+        }
+      }
+    }
+    return n;
+  }
+
+  // give the next new number to `dof` if it has not been numbered yet
+  void visitDof(index_t dof, index_t first, index_t & counter)
+  {
+    if (dof < 0)
+      return;
+    index_t & p = m_perm[dof - first];
+    if (p < 0)
+      p = counter++;
+  }
+
+  // visit all dofs (all regions and components) that `c` stores for the entity `id`
+  void visitEntityDofs(typename VarT::Container const& c, index_t id, index_t first, index_t & counter)
+  {
+    if (c.size() == 0)
+      return;
+    for (int reg = 0; reg < c.numRegions(); ++reg)
+    {
+      index_t const* dofs = c.find(reg, id);
+      if (dofs)
+        for (int j = 0; j < c.numComps(); ++j)
+          visitDof(dofs[j], first, counter);
+    }
+  }
+
+  void orderInterleaved(index_t first)
+  {
+    index_t counter = 0;
+    index_t const n_verts  = m_mp->numVerticesTotal();
+    index_t const n_ridges = m_mp->numRidgesTotal();
+    index_t const n_facets = m_mp->numFacetsTotal();
+    index_t const n_cells  = m_mp->numCellsTotal();
+
+    for (index_t e = 0; e < n_verts; ++e)
+      for (unsigned i = 0; i < m_vars.size(); ++i)
+        visitEntityDofs(m_vars[i].m_verts_dofs, e, first, counter);
+
+    for (index_t e = 0; e < n_ridges; ++e)
+      for (unsigned i = 0; i < m_vars.size(); ++i)
+        visitEntityDofs(m_vars[i].m_ridges_dofs, e, first, counter);
+
+    for (index_t e = 0; e < n_facets; ++e)
+      for (unsigned i = 0; i < m_vars.size(); ++i)
+        visitEntityDofs(m_vars[i].m_facets_dofs, e, first, counter);
+
+    for (index_t e = 0; e < n_cells; ++e)
+      for (unsigned i = 0; i < m_vars.size(); ++i)
+        visitEntityDofs(m_vars[i].m_cells_dofs, e, first, counter);
+  }
+
+  void orderCellLocality(index_t first)
+  {
+    index_t counter = 0;
+    std::vector<index_t> dofs;
+
+    for (CellH cell = m_mp->cellBegin(), cell_end = m_mp->cellEnd(); cell != cell_end; ++cell)
+    {
+      if (cell.isDisabled(m_mp))
+        continue;
+
+      for (unsigned i = 0; i < m_vars.size(); ++i)
+      {
+        dofs.resize(m_vars[i].numDofsPerCell());
+        m_vars[i].getCellDofs(dofs.data(), cell);
+        for (unsigned k = 0; k < dofs.size(); ++k)
+          visitDof(dofs[k], first, counter);
+      }
+    }
+  }
+
+  void orderRcm(index_t first)
+  {
+    index_t const n_dofs = m_perm.size();
+
+    if (n_dofs == 0)
+      return;
+
+    CuthilMckee::TableT graph(n_dofs);
+    std::vector<index_t> dofs;
+
+    for (CellH cell = m_mp->cellBegin(), cell_end = m_mp->cellEnd(); cell != cell_end; ++cell)
+    {
+      if (cell.isDisabled(m_mp))
+        continue;
+
+      dofs.clear();
+      for (unsigned i = 0; i < m_vars.size(); ++i)
+      {
+        index_t const n = dofs.size();
+        dofs.resize(n + m_vars[i].numDofsPerCell());
+        m_vars[i].getCellDofs(dofs.data() + n, cell);
+      }
+      dofs.erase(std::remove(dofs.begin(), dofs.end(), -1), dofs.end());
+
+      for (unsigned k = 0; k < dofs.size(); ++k)
+        for (unsigned l = 0; l < dofs.size(); ++l)
+          graph[dofs[k] - first].insert(dofs[l] - first);
+    }
+
+    // dofs that no cell sees are still numbered
+    for (index_t i = 0; i < n_dofs; ++i)
+      graph[i].insert(i);
+
+    std::vector<int> perm(n_dofs);
+    CuthilMckee()(graph, 0, perm.data());
+
+    for (index_t i = 0; i < n_dofs; ++i)
+      m_perm[i] = perm[i];
+  }
+
+  // apply `perm` (relative to `first`) to all variables
+  void renumber(index_t first, std::vector<index_t> const& perm)
+  {
+    for (unsigned i = 0; i < m_vars.size(); ++i)
+    {
+      typename VarT::Container * cs[] = {&m_vars[i].m_verts_dofs, &m_vars[i].m_ridges_dofs,
+                                         &m_vars[i].m_facets_dofs, &m_vars[i].m_cells_dofs};
+      for (int k = 0; k < 4; ++k)
+      {
+        typename VarT::Container & c = *cs[k];
+        for (index_t j = 0; j < (index_t)c.size(); ++j)
+          if (c.access(j) >= 0)
+            c.access(j) = first + perm[c.access(j) - first];
+      }
+    }
+  }
+
   struct AuxRemoveGaps
   {
     static bool compare_ptr(index_t const* a, index_t const* b)
@@ -189,6 +625,7 @@ public:
       }
     }
 
+    refreshInverseMap();
   }
 
 
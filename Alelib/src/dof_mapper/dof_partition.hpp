@@ -0,0 +1,299 @@
+// This file is part of Alelib, a toolbox for finite element codes.
+//
+// Alelib is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// Alelib is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// Alelib. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALELIB_DOF_PARTITION_HPP
+#define ALELIB_DOF_PARTITION_HPP
+
+#include <vector>
+#include <algorithm>
+#include "dof_mapper.hpp"
+#include "../util/assert.hpp"
+
+namespace alelib
+{
+
+/**
+*  Ownership of the dofs of a DofMapper among partitions of the mesh cells.
+*
+*  Each dof is owned by exactly one partition, and the dofs owned by a partition are
+*  numbered contiguously. The dofs that a partition reads but does not own are its
+*  ghosts. The local vector of a partition has its owned dofs first, in increasing
+*  order, and then its ghosts, also in increasing order.
+*
+*  The scatter plans say which entries each partition exchanges with each neighbor,
+*  which is what a message-passing implementation needs. sumGhosts() and
+*  updateGhosts() carry out the exchange in shared memory.
+*/
+template<class Mesh_t>
+class DofPartition
+{
+public:
+  typedef Mesh_t MeshT;
+  typedef typename MeshT::CellH CellH;
+  typedef DofMapper<Mesh_t> DofMapperT;
+
+  /// Dofs exchanged with each neighbor, CSR-like: the dofs exchanged with neighbors[k]
+  /// are dofs[offsets[k]], ..., dofs[offsets[k+1]-1], in increasing order.
+  struct ScatterPlan
+  {
+    std::vector<int>     neighbors;
+    std::vector<index_t> offsets;
+    std::vector<index_t> dofs;
+
+    int numNeighbors() const
+    { return (int)neighbors.size(); }
+  };
+
+protected:
+  int m_n_parts;
+  index_t m_first_dof;
+  std::vector<index_t> m_owned_offsets;        // dofs owned by p: [m_owned_offsets[p], m_owned_offsets[p+1]), relative to m_first_dof
+  std::vector<std::vector<index_t> > m_ghosts; // sorted, for each partition
+  std::vector<ScatterPlan> m_send;             // ghosts of p, grouped by owner
+  std::vector<ScatterPlan> m_recv;             // owned dofs of p that are ghosts of other partitions
+
+public:
+
+  DofPartition() : m_n_parts(0), m_first_dof(0), m_owned_offsets(), m_ghosts(), m_send(), m_recv()
+  {}
+
+  /// Distributes the dofs of `mapper` among the partitions of the cells and renumbers
+  /// the mapper so that the dofs owned by each partition are contiguous, partition 0 first.
+  /// A dof is owned by the lowest partition among the cells that contain it.
+  /// Dofs that no cell contains belong to partition 0.
+  /// @param cell_part cell_part[cell_id] is the partition of the cell, in [0, n_parts).
+  /// @note mapper.SetUp() must be called before.
+  void setUp(DofMapperT & mapper, int n_parts, int const* cell_part)
+  {
+    MeshT const* mp = mapper.mesh();
+    index_t const n_dofs = mapper.numDofs();
+
+    m_n_parts = n_parts;
+    m_first_dof = mapper.initialDof();
+
+    std::vector<index_t> dofs;
+
+    // owners
+    std::vector<int> owner(n_dofs, n_parts);
+    for (CellH cell = mp->cellBegin(), cell_end = mp->cellEnd(); cell != cell_end; ++cell)
+    {
+      if (cell.isDisabled(mp))
+        continue;
+
+      int const p = cell_part[cell.id(mp)];
+      ALELIB_CHECK(p >= 0 && p < n_parts, "DofPartition: invalid cell partition", std::invalid_argument);
+
+      getCellDofs(dofs, mapper, cell);
+      for (unsigned k = 0; k < dofs.size(); ++k)
+        owner[dofs[k]] = std::min(owner[dofs[k]], p);
+    }
+    for (index_t i = 0; i < n_dofs; ++i)
+      if (owner[i] == n_parts)
+        owner[i] = 0;
+
+    // owned dofs are numbered contiguously, keeping their relative order
+    m_owned_offsets.assign(n_parts + 1, 0);
+    for (index_t i = 0; i < n_dofs; ++i)
+      ++m_owned_offsets[owner[i] + 1];
+    for (int p = 0; p < n_parts; ++p)
+      m_owned_offsets[p+1] += m_owned_offsets[p];
+
+    std::vector<index_t> next(m_owned_offsets.begin(), m_owned_offsets.end() - 1);
+    std::vector<index_t> perm(n_dofs);
+    for (index_t i = 0; i < n_dofs; ++i)
+      perm[i] = next[owner[i]]++;
+    mapper.permuteDofs(perm);
+
+    // ghosts
+    m_ghosts.assign(n_parts, std::vector<index_t>());
+    for (CellH cell = mp->cellBegin(), cell_end = mp->cellEnd(); cell != cell_end; ++cell)
+    {
+      if (cell.isDisabled(mp))
+        continue;
+
+      int const p = cell_part[cell.id(mp)];
+      getCellDofs(dofs, mapper, cell);
+      for (unsigned k = 0; k < dofs.size(); ++k)
+        if (!isOwned(p, dofs[k] + m_first_dof))
+          m_ghosts[p].push_back(dofs[k] + m_first_dof);
+    }
+    for (int p = 0; p < n_parts; ++p)
+    {
+      std::sort(m_ghosts[p].begin(), m_ghosts[p].end());
+      m_ghosts[p].erase(std::unique(m_ghosts[p].begin(), m_ghosts[p].end()), m_ghosts[p].end());
+    }
+
+    // scatter plans: since the owned ranges are increasing, the sorted ghosts are
+    // already grouped by owner
+    m_send.assign(n_parts, ScatterPlan());
+    m_recv.assign(n_parts, ScatterPlan());
+    for (int p = 0; p < n_parts; ++p)
+    {
+      ScatterPlan & send = m_send[p];
+      send.offsets.push_back(0);
+      for (unsigned k = 0; k < m_ghosts[p].size(); ++k)
+      {
+        index_t const dof = m_ghosts[p][k];
+        int const q = owner_(dof);
+        if (send.neighbors.empty() || send.neighbors.back() != q)
+        {
+          send.neighbors.push_back(q);
+          send.offsets.push_back(send.offsets.back());
+        }
+        send.dofs.push_back(dof);
+        ++send.offsets.back();
+      }
+
+      for (int k = 0; k < send.numNeighbors(); ++k)
+      {
+        ScatterPlan & recv = m_recv[send.neighbors[k]];
+        if (recv.offsets.empty())
+          recv.offsets.push_back(0);
+        recv.neighbors.push_back(p);
+        recv.dofs.insert(recv.dofs.end(), send.dofs.begin() + send.offsets[k], send.dofs.begin() + send.offsets[k+1]);
+        recv.offsets.push_back(recv.dofs.size());
+      }
+    }
+    for (int p = 0; p < n_parts; ++p)
+      if (m_recv[p].offsets.empty())
+        m_recv[p].offsets.push_back(0);
+  }
+
+  int numParts() const
+  { return m_n_parts; }
+
+  /// first dof owned by the partition p
+  index_t ownedBegin(int p) const
+  { return m_first_dof + m_owned_offsets[p]; }
+
+  /// one past the last dof owned by the partition p
+  index_t ownedEnd(int p) const
+  { return m_first_dof + m_owned_offsets[p+1]; }
+
+  index_t numOwned(int p) const
+  { return m_owned_offsets[p+1] - m_owned_offsets[p]; }
+
+  bool isOwned(int p, index_t dof) const
+  { return dof >= ownedBegin(p) && dof < ownedEnd(p); }
+
+  /// the partition that owns the dof
+  int owner(index_t dof) const
+  { return owner_(dof); }
+
+  /// dofs read by the partition p and owned by others, in increasing order
+  std::vector<index_t> const& ghosts(int p) const
+  { return m_ghosts[p]; }
+
+  index_t numGhosts(int p) const
+  { return m_ghosts[p].size(); }
+
+  /// size of the local vector of the partition p
+  index_t numLocal(int p) const
+  { return numOwned(p) + numGhosts(p); }
+
+  /// position of the dof in the local vector of the partition p, or -1 if p does not see it
+  index_t localIndex(int p, index_t dof) const
+  {
+    if (isOwned(p, dof))
+      return dof - ownedBegin(p);
+    std::vector<index_t>::const_iterator it = std::lower_bound(m_ghosts[p].begin(), m_ghosts[p].end(), dof);
+    if (it == m_ghosts[p].end() || *it != dof)
+      return -1;
+    return numOwned(p) + (index_t)(it - m_ghosts[p].begin());
+  }
+
+  /// ghosts of the partition p grouped by owner: what p sends when summing contributions.
+  /// The dofs sent to neighbors[k] are the local entries numOwned(p) + offsets[k], ...
+  ScatterPlan const& sendPlan(int p) const
+  { return m_send[p]; }
+
+  /// owned dofs of the partition p that other partitions have as ghosts: what p receives
+  /// when summing contributions, in the same order as the neighbors send them.
+  ScatterPlan const& recvPlan(int p) const
+  { return m_recv[p]; }
+
+  /// Adds the ghost entries of the local vectors to the owners' entries and zeroes them.
+  /// local[p] is the local vector of the partition p (see numLocal()).
+  template<class T>
+  void sumGhosts(T* const* local) const
+  {
+    for (int p = 0; p < m_n_parts; ++p)
+    {
+      ScatterPlan const& send = m_send[p];
+      T* ghost = local[p] + numOwned(p);
+      for (int k = 0; k < send.numNeighbors(); ++k)
+      {
+        int const q = send.neighbors[k];
+        for (index_t i = send.offsets[k]; i < send.offsets[k+1]; ++i)
+        {
+          local[q][send.dofs[i] - ownedBegin(q)] += ghost[i];
+          ghost[i] = T(0);
+        }
+      }
+    }
+  }
+
+  /// Copies the owners' entries to the ghost entries of the local vectors.
+  template<class T>
+  void updateGhosts(T* const* local) const
+  {
+    for (int p = 0; p < m_n_parts; ++p)
+    {
+      ScatterPlan const& send = m_send[p];
+      T* ghost = local[p] + numOwned(p);
+      for (int k = 0; k < send.numNeighbors(); ++k)
+      {
+        int const q = send.neighbors[k];
+        for (index_t i = send.offsets[k]; i < send.offsets[k+1]; ++i)
+          ghost[i] = local[q][send.dofs[i] - ownedBegin(q)];
+      }
+    }
+  }
+
+private:
+
+  int owner_(index_t dof) const
+  {
+    return (int)(std::upper_bound(m_owned_offsets.begin(), m_owned_offsets.end(), dof - m_first_dof)
+                 - m_owned_offsets.begin()) - 1;
+  }
+
+  // all dofs of all variables of the cell, relative to the initial dof, without -1's
+  void getCellDofs(std::vector<index_t> & dofs, DofMapperT const& mapper, CellH cell) const
+  {
+    dofs.clear();
+    for (int i = 0; i < mapper.numVars(); ++i)
+    {
+      index_t const n = dofs.size();
+      dofs.resize(n + mapper.variable(i).numDofsPerCell());
+      mapper.variable(i).getCellDofs(dofs.data() + n, cell);
+    }
+    dofs.erase(std::remove(dofs.begin(), dofs.end(), -1), dofs.end());
+    for (unsigned k = 0; k < dofs.size(); ++k)
+      dofs[k] -= m_first_dof;
+  }
+
+};
+
+} // end namespace alelib
+
+
+#endif
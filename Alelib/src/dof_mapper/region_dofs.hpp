@@ -0,0 +1,199 @@
+// This file is part of Alelib, a toolbox for finite element codes.
+//
+// Alelib is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// Alelib is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// Alelib. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALELIB_REGION_DOFS_HPP
+#define ALELIB_REGION_DOFS_HPP
+
+#include <vector>
+#include "conf/directives.hpp"
+
+namespace alelib
+{
+
+/**
+*  Dofs of one kind of entity (vertices, ridges, facets or cells) of a variable,
+*  for each region the entity belongs to.
+*
+*  Most entities belong to a single region, so the first region of each entity is
+*  stored inline (n_entities x n_comps). Entities shared by more regions (interfaces)
+*  keep the other ones in a list of extra blocks, whose head is indexed by the entity,
+*  so find() and insert() take O(number of regions of the entity). The blocks released
+*  by erase() are reused by the next inserts. The memory is then ~(n_comps+2) x n_entities,
+*  independent of the number of regions.
+*
+*  size() and access(j) run over all stored dofs, absent ones are -1.
+*/
+class RegionDofs
+{
+  int     m_n_regions;
+  index_t m_n_entities;
+  int     m_n_comps;
+
+  std::vector<int>     m_regions;     // region of the inline block of each entity, -1 if none
+  std::vector<index_t> m_dofs;        // inline blocks, n_comps per entity
+
+  std::vector<index_t> m_extra_head;    // per entity, first extra block or -1; empty until needed
+  std::vector<int>     m_extra_regions; // per extra block
+  std::vector<index_t> m_extra_next;    // per extra block, -1 ends the list
+  std::vector<index_t> m_extra_dofs;    // n_comps per extra block
+  index_t              m_extra_free;    // first released block, linked by m_extra_next
+
+public:
+
+  RegionDofs() : m_n_regions(0), m_n_entities(0), m_n_comps(0), m_extra_free(-1) {}
+
+  /// @warning all dofs are destroyed
+  void reshape(int n_regions, index_t n_entities, int n_comps)
+  {
+    clear();
+    m_n_regions  = n_regions;
+    m_n_entities = n_entities;
+    m_n_comps    = n_comps;
+    m_regions.assign(n_entities, -1);
+    m_dofs.assign(n_entities*n_comps, -1);
+  }
+
+  /// Make room for more entities, keeping the stored dofs.
+  void resize(index_t n_entities)
+  {
+    if (n_entities <= m_n_entities)
+      return;
+    m_n_entities = n_entities;
+    m_regions.resize(n_entities, -1);
+    m_dofs.resize(n_entities*m_n_comps, -1);
+    if (!m_extra_head.empty())
+      m_extra_head.resize(n_entities, -1);
+  }
+
+  void clear()
+  {
+    m_n_regions = 0;
+    m_n_entities = 0;
+    m_n_comps = 0;
+    m_regions.clear();
+    m_dofs.clear();
+    m_extra_head.clear();
+    m_extra_regions.clear();
+    m_extra_next.clear();
+    m_extra_dofs.clear();
+    m_extra_free = -1;
+  }
+
+  int numRegions() const
+  { return m_n_regions; }
+
+  index_t numEntities() const
+  { return m_n_entities; }
+
+  int numComps() const
+  { return m_n_comps; }
+
+  /// number of stored dofs, see access()
+  index_t size() const
+  { return (index_t)(m_dofs.size() + m_extra_dofs.size()); }
+
+  index_t& access(index_t j)
+  { return j < (index_t)m_dofs.size() ? m_dofs[j] : m_extra_dofs[j - m_dofs.size()]; }
+
+  index_t const& access(index_t j) const
+  { return j < (index_t)m_dofs.size() ? m_dofs[j] : m_extra_dofs[j - m_dofs.size()]; }
+
+  /// @return the n_comps dofs of the entity `id` in the region `reg`, or NULL if the
+  ///         entity is not in that region.
+  index_t const* find(int reg, index_t id) const
+  {
+    if (m_regions[id] == reg)
+      return &m_dofs[id*m_n_comps];
+    if (m_extra_head.empty())
+      return NULL;
+    for (index_t b = m_extra_head[id]; b >= 0; b = m_extra_next[b])
+      if (m_extra_regions[b] == reg)
+        return &m_extra_dofs[b*m_n_comps];
+    return NULL;
+  }
+
+  index_t* find(int reg, index_t id)
+  { return const_cast<index_t*>(static_cast<RegionDofs const*>(this)->find(reg, id)); }
+
+  /// @return the dofs of the entity `id` in the region `reg`, adding the entity to
+  ///         the region (with dofs -1) if necessary.
+  /// @warning the returned pointer is invalidated by the next insert().
+  index_t* insert(int reg, index_t id)
+  {
+    index_t* dofs = find(reg, id);
+    if (dofs)
+      return dofs;
+
+    if (m_regions[id] < 0)
+    {
+      m_regions[id] = reg;
+      return &m_dofs[id*m_n_comps];
+    }
+
+    if (m_extra_head.empty())
+      m_extra_head.assign(m_n_entities, -1);
+
+    index_t b = m_extra_free;
+    if (b >= 0)
+      m_extra_free = m_extra_next[b];
+    else
+    {
+      b = (index_t)m_extra_regions.size();
+      m_extra_regions.push_back(-1);
+      m_extra_next.push_back(-1);
+      m_extra_dofs.resize(m_extra_dofs.size() + m_n_comps, -1);
+    }
+    m_extra_regions[b] = reg;
+    m_extra_next[b] = m_extra_head[id];
+    m_extra_head[id] = b;
+    return &m_extra_dofs[b*m_n_comps];
+  }
+
+  /// Remove the entity `id` from all regions. Its extra blocks keep dofs -1 until
+  /// they are reused.
+  void erase(index_t id)
+  {
+    m_regions[id] = -1;
+    for (int j = 0; j < m_n_comps; ++j)
+      m_dofs[id*m_n_comps + j] = -1;
+
+    if (m_extra_head.empty())
+      return;
+    index_t b = m_extra_head[id];
+    while (b >= 0)
+    {
+      index_t const next = m_extra_next[b];
+      m_extra_regions[b] = -1;
+      for (int j = 0; j < m_n_comps; ++j)
+        m_extra_dofs[b*m_n_comps + j] = -1;
+      m_extra_next[b] = m_extra_free;
+      m_extra_free = b;
+      b = next;
+    }
+    m_extra_head[id] = -1;
+  }
+
+};
+
+} // end namespace alelib
+
+
+#endif
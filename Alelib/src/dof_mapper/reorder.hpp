@@ -23,29 +23,13 @@
 #define ALE_REORDER_HPP
 
 #include "../mesh/mesh.hpp"
-#include "../shape_functions/parametric_pts.hpp"
+#include "reorder_table.hpp"
 
 namespace alelib
 {
 
 namespace internal {
 
-static inline
-void reorder_aux(std::vector<int>& v, std::vector<int>& order)
-{
-  std::vector<int> & map = order;
-
-  for (int i=0; i<(int)map.size()-1; ++i)
-  {
-    while (map[i] != i)
-    {
-      std::swap(v[map[i]], v[map[map[i]]]);
-      std::swap(map[i], map[map[i]]);
-    }
-  }
-  return;
-}
-
 template<ECellType CT, typename Mesh_t, class T>
 struct RDL_caller {};
 
@@ -56,41 +40,17 @@ struct RDL_caller<TRIANGLE,Mesh_t,T>
   void operator() (Mesh_t const* mp, typename Mesh_t::CellH c, int n, int ncomps, T * dofs) const
   {
     // n = order
-
     if (n<3)
       return;
 
-    //int const ndofs = (n+1)*(n+2)/2;
-
-    typedef Mesh_t MeshT;
-    //typedef typename MeshT::CellH CellH;
-
-    for (int i = 0; i < MeshT::facets_per_cell; ++i)
-    {
-      
-      c.facet(mp,i);
-      
-      
-      if (c.facet(mp,i).icellSide0(mp) == c)
-        continue;
-      int anchor;
-      // check orientation
-      c.adjSideAndAnchor(mp, i, &anchor);
-      if (!anchor)
-      {
-        int k = ncomps*( MeshT::verts_per_cell + i*(n-1));
-        int l = ncomps*( MeshT::verts_per_cell + (i+1)*(n-1) - 1);
-
-        while (l>k)
-        {
-          for (int m = 0; m < ncomps; ++m)
-            std::swap(dofs[k+m], dofs[l+m]);
-          k += ncomps;
-          l -= ncomps;
-        }
-      }
-    }
+    unsigned const code = mp->orientationCode(c);
+    if (!code)
+      return;
 
+    if (n <= LagrangeReorderTable<TRIANGLE>::max_cached_degree)
+      LagrangeReorderTable<TRIANGLE>::get(n).apply(code, ncomps, dofs);
+    else
+      LagrangeReorderTable<TRIANGLE>(n).apply(code, ncomps, dofs);
   }
 };
 
@@ -98,73 +58,21 @@ struct RDL_caller<TRIANGLE,Mesh_t,T>
 template<typename Mesh_t, class T>
 struct RDL_caller<TETRAHEDRON,Mesh_t,T>
 {
-inline
+  inline
   void operator() (Mesh_t const* mp, typename Mesh_t::CellH c, int n, int ncomps, T * dofs) const
   {
     // n = order
-
     if (n<3)
       return;
 
-    typedef Mesh_t MeshT;
-    //typedef typename MeshT::CellH CellH;
-    typedef typename MeshT::VertexH VertexH;
-
-    // RIDGES FIRST
-    for (int i = 0; i < MeshT::ridges_per_cell; ++i)
-    {
-      if (c.ridge(mp,i).icell(mp) == c)
-        continue;
-
-      VertexH ridge_verts_my[2];
-      VertexH ridge_verts_other[2];
-
-      c.ridge(mp, i).vertices(mp, ridge_verts_other);
-      c.ridgeVertices(mp, i, ridge_verts_my);
-
-      // check orientation
-      if (ridge_verts_other[0] != ridge_verts_my[0])
-      {
-        int k = ncomps*( MeshT::verts_per_cell + i*(n-1));
-        int l = ncomps*( MeshT::verts_per_cell + (i+1)*(n-1) - 1);
-
-        while (l>k)
-        {
-          for (int m = 0; m < ncomps; ++m)
-            std::swap(dofs[k+m], dofs[l+m]);
-          k += ncomps;
-          l -= ncomps;
-        }
-      }
-    }
-
-    if (n<4)
+    unsigned const code = mp->orientationCode(c);
+    if (!code)
       return;
 
-    // NOW THE FACETS
-    std::vector<int> map;
-    int const map_size = (n-1)*(n-2)/2;
-    for (int i = 0; i < MeshT::facets_per_cell; ++i)
-    {
-      if (c.facet(mp,i).icellSide0(mp) == c)
-        continue;
-      int anchor;
-      c.adjSideAndAnchor(mp, i, &anchor);
-      mapTriInteriorPtsToOpp(n, anchor, map);
-      T * v = dofs + ncomps*( 4+6*(n-1)  +  i*map_size ) ;
-      // reordering
-      for (int k=0; k<map_size; ++k)
-      {
-        while (map[k] != k)
-        {
-          int& mmk = map[map[k]];
-          for (int j = 0; j < ncomps; ++j)
-            std::swap(v[ncomps*map[k]+j], v[ncomps*mmk+j]);
-          std::swap(map[k], mmk);
-        }
-      }
-    }
-
+    if (n <= LagrangeReorderTable<TETRAHEDRON>::max_cached_degree)
+      LagrangeReorderTable<TETRAHEDRON>::get(n).apply(code, ncomps, dofs);
+    else
+      LagrangeReorderTable<TETRAHEDRON>(n).apply(code, ncomps, dofs);
   }
 };
 
@@ -172,6 +80,10 @@ inline
 }
 
 
+/// Reorders the dofs of a Lagrange cell of degree n so that the dofs of shared ridges
+/// and facets match the orientation of the cells that own them. It uses the cached
+/// orientation code of the cell (see Mesh::orientationCode) and precomputed swap
+/// tables, without allocation for n <= 12.
 /// @param mp mesh
 /// @param c which cell the dofs correspond
 /// @param n the degree of the Lagrange polinomial
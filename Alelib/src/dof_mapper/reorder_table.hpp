@@ -0,0 +1,154 @@
+// This file is part of Alelib, a toolbox for finite element codes.
+//
+// Alelib is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// Alelib is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// Alelib. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALE_REORDER_TABLE_HPP
+#define ALE_REORDER_TABLE_HPP
+
+#include "../mesh/enums.hpp"
+#include "../shape_functions/parametric_pts.hpp"
+#include <vector>
+
+namespace alelib
+{
+
+namespace internal {
+
+// Swap lists that reorder the Lagrange nodes of the sub-entities of a cell of
+// degree n, according to the orientation code of the cell (see Mesh::orientationCode).
+// The operation k swaps the nodes m_swaps[2*j] and m_swaps[2*j+1], for j in
+// [m_ptr[k], m_ptr[k+1]), in this order:
+//   op i            reverses the edge (ridge in 3D) i
+//   op 6 + 3*i + a  reorders the interior nodes of the facet i with anchor a (tetrahedra)
+template<ECellType CT>
+class LagrangeReorderTable
+{
+  static const int n_verts = CT == TRIANGLE ? 3 : 4;
+  static const int n_edges = CT == TRIANGLE ? 3 : 6;
+
+  std::vector<int> m_ptr;
+  std::vector<int> m_swaps;
+
+  void close()
+  { m_ptr.push_back(m_swaps.size()/2); }
+
+  void addSwap(int a, int b)
+  {
+    m_swaps.push_back(a);
+    m_swaps.push_back(b);
+  }
+
+  template<class T>
+  void swapNodes(int op, int ncomps, T * dofs) const
+  {
+    for (int j = m_ptr[op]; j < m_ptr[op+1]; ++j)
+    {
+      T * a = dofs + ncomps*m_swaps[2*j];
+      T * b = dofs + ncomps*m_swaps[2*j+1];
+      for (int m = 0; m < ncomps; ++m)
+        std::swap(a[m], b[m]);
+    }
+  }
+
+public:
+
+  // largest degree whose table is kept by get()
+  static const int max_cached_degree = 12;
+
+  explicit LagrangeReorderTable(int n = 0) : m_ptr(1, 0), m_swaps()
+  {
+    // edges
+    for (int i = 0; i < n_edges; ++i)
+    {
+      if (n >= 3)
+      {
+        int k = n_verts + i*(n-1);
+        int l = n_verts + (i+1)*(n-1) - 1;
+        for (; l > k; ++k, --l)
+          addSwap(k, l);
+      }
+      close();
+    }
+
+    // facets, replaying the cycles of mapTriInteriorPtsToOpp()
+    if (CT == TETRAHEDRON)
+    {
+      int const map_size = (n-1)*(n-2)/2;
+      std::vector<int> map;
+      for (int i = 0; i < 4; ++i)
+        for (int anchor = 0; anchor < 3; ++anchor)
+        {
+          if (n >= 4)
+          {
+            int const base = 4 + 6*(n-1) + i*map_size;
+            mapTriInteriorPtsToOpp(n, anchor, map);
+            for (int k = 0; k < map_size; ++k)
+              while (map[k] != k)
+              {
+                int const mk = map[k];
+                addSwap(base + mk, base + map[mk]);
+                std::swap(map[k], map[mk]);
+              }
+          }
+          close();
+        }
+    }
+  }
+
+  /// tables of degrees 0 to max_cached_degree, built once
+  static LagrangeReorderTable const& get(int n)
+  {
+    static std::vector<LagrangeReorderTable> const tables = buildCache();
+    return tables.at(n);
+  }
+
+  // the swaps of an operation are disjoint, so applying the same code twice restores the order
+  template<class T>
+  void apply(unsigned code, int ncomps, T * dofs) const
+  {
+    for (int i = 0; i < n_edges; ++i)
+      if (code & (1u << i))
+        swapNodes(i, ncomps, dofs);
+
+    if (CT == TETRAHEDRON)
+      for (int i = 0; i < 4; ++i)
+      {
+        unsigned const a = (code >> (n_edges + 2*i)) & 3u;
+        if (a)
+          swapNodes(n_edges + 3*i + a - 1, ncomps, dofs);
+      }
+  }
+
+private:
+  static std::vector<LagrangeReorderTable> buildCache()
+  {
+    std::vector<LagrangeReorderTable> tables;
+    tables.reserve(max_cached_degree + 1);
+    for (int n = 0; n <= max_cached_degree; ++n)
+      tables.push_back(LagrangeReorderTable(n));
+    return tables;
+  }
+};
+
+} // namespace internal
+
+} // namespace alelib
+
+#endif
@@ -22,7 +22,7 @@
 #ifndef ALELIB_VAR_DOF_HPP
 #define ALELIB_VAR_DOF_HPP
 
-#include "Array/array.hpp"
+#include "region_dofs.hpp"
 #include <vector>
 #include <string>
 #include "contrib/Loki/set_vector.hpp"
@@ -45,7 +45,7 @@ class VarDofs
   friend
   class DofMapper<Mesh_t>;
 
-  typedef marray::Array<index_t, 3> Container; // (region(defined by tags), obj_id(vts, cells, etc.), component)
+  typedef RegionDofs Container; // dofs per (region(defined by tags), obj_id(vts, cells, etc.), component)
 
 public:
   typedef Mesh_t MeshT;
@@ -165,7 +165,7 @@ protected:
       }
     }
 
-    int n_regions = std::max(1ul, m_regions_tags.size());
+    int n_regions = std::max<std::size_t>(1, m_regions_tags.size());
     bool const number_by_regions = !m_regions_tags.empty();
 
 
@@ -175,13 +175,13 @@ protected:
     m_cells_dofs.clear();
 
     if (m_n_dofs_in_vtx > 0)
-      m_verts_dofs.reshape(marray::listify(n_regions, n_verts_total, m_n_dofs_in_vtx).v, -1);
+      m_verts_dofs.reshape(n_regions, n_verts_total, m_n_dofs_in_vtx);
     if (m_n_dofs_in_ridge > 0)
-      m_ridges_dofs.reshape(marray::listify(n_regions, n_ridges_total, m_n_dofs_in_ridge).v, -1);
+      m_ridges_dofs.reshape(n_regions, n_ridges_total, m_n_dofs_in_ridge);
     if (m_n_dofs_in_facet > 0)
-      m_facets_dofs.reshape(marray::listify(n_regions, n_facets_total, m_n_dofs_in_facet).v, -1);
+      m_facets_dofs.reshape(n_regions, n_facets_total, m_n_dofs_in_facet);
     if (m_n_dofs_in_cell > 0)
-      m_cells_dofs.reshape(marray::listify(n_regions, n_cells_total, m_n_dofs_in_cell).v, -1);
+      m_cells_dofs.reshape(n_regions, n_cells_total, m_n_dofs_in_cell);
 
 
     index_t dof_counter = first_dof_id;
@@ -203,8 +203,11 @@ protected:
             in_region = m_regions_tags[reg].find(tag) != m_regions_tags[reg].end();
           
           if (in_region)
+          {
+            index_t* dofs = m_verts_dofs.insert(reg, p.id(m_mp));
             for (int j = 0; j < m_n_dofs_in_vtx; ++j)
-              m_verts_dofs[reg][p.id(m_mp)][j] = dof_counter++;
+              dofs[j] = dof_counter++;
+          }
         }
       }
 
@@ -224,8 +227,11 @@ protected:
             in_region = m_regions_tags[reg].find(tag) != m_regions_tags[reg].end();
           
           if (in_region)
+          {
+            index_t* dofs = m_ridges_dofs.insert(reg, p.id(m_mp));
             for (int j = 0; j < m_n_dofs_in_ridge; ++j)
-              m_ridges_dofs[reg][p.id(m_mp)][j] = dof_counter++;
+              dofs[j] = dof_counter++;
+          }
         }
       }
 
@@ -245,8 +251,11 @@ protected:
             in_region = m_regions_tags[reg].find(tag) != m_regions_tags[reg].end();
           
           if (in_region)
+          {
+            index_t* dofs = m_facets_dofs.insert(reg, p.id(m_mp));
             for (int j = 0; j < m_n_dofs_in_facet; ++j)
-              m_facets_dofs[reg][p.id(m_mp)][j] = dof_counter++;
+              dofs[j] = dof_counter++;
+          }
         }
       }
 
@@ -266,8 +275,11 @@ protected:
             in_region = m_regions_tags[reg].find(tag) != m_regions_tags[reg].end();
           
           if (in_region)
+          {
+            index_t* dofs = m_cells_dofs.insert(reg, p.id(m_mp));
             for (int j = 0; j < m_n_dofs_in_cell; ++j)
-              m_cells_dofs[reg][p.id(m_mp)][j] = dof_counter++;
+              dofs[j] = dof_counter++;
+          }
         }
       }
 
@@ -279,6 +291,45 @@ protected:
 
   void linkDofs(int size, int const* dofs1, int const* dofs2); // do dofs2 = dofs1
 
+  // does an entity with tag `tag` belong to the region `reg`?
+  bool inRegion(int reg, int tag) const
+  {
+    return m_regions_tags.empty() || m_regions_tags[reg].find(tag) != m_regions_tags[reg].end();
+  }
+
+  // make room for the entities created after setUp(), keeping the stored dofs
+  void growContainers()
+  {
+    int const n_regions = std::max<std::size_t>(1, m_regions_tags.size());
+    growContainer(m_verts_dofs,  n_regions, (index_t)(m_mp->numVerticesTotal()), m_n_dofs_in_vtx  );
+    growContainer(m_ridges_dofs, n_regions, (index_t)(m_mp->numRidgesTotal()  ), m_n_dofs_in_ridge);
+    growContainer(m_facets_dofs, n_regions, (index_t)(m_mp->numFacetsTotal()  ), m_n_dofs_in_facet);
+    growContainer(m_cells_dofs,  n_regions, (index_t)(m_mp->numCellsTotal()   ), m_n_dofs_in_cell );
+  }
+
+  static void growContainer(Container & c, int n_regions, index_t n_entities, int n_comps)
+  {
+    if (n_comps <= 0)
+      return;
+    if (c.numComps() == 0)
+      c.reshape(n_regions, n_entities, n_comps);
+    else
+      c.resize(n_entities);
+  }
+
+  // copy the n dofs that `c` stores for the entity `id` in the region `reg`,
+  // or -1's if the entity is not in that region
+  template<class OutIterator>
+  static OutIterator copyDofs(OutIterator dofs, Container const& c, int reg, index_t id, int n)
+  {
+    if (n <= 0)
+      return dofs;
+    index_t const* d = c.find(reg, id);
+    for (int j = 0; j < n; ++j)
+      *dofs++ = d ? d[j] : -1;
+    return dofs;
+  }
+
 public:
 
   //
@@ -338,11 +389,12 @@ public:
 
   int numRegions() const
   {
-    std::size_t a = std::max(1ul, m_verts_dofs.dim(0));
-    a = std::max(a, m_ridges_dofs.dim(0));
-    a = std::max(a, m_facets_dofs.dim(0));
-    a = std::max(a, m_cells_dofs.dim(0));
-    
+    int a = std::max(1, m_verts_dofs.numRegions());
+    a = std::max(a, m_ridges_dofs.numRegions());
+    a = std::max(a, m_facets_dofs.numRegions());
+    a = std::max(a, m_cells_dofs.numRegions());
+
+
     return a;
   }
 
@@ -422,10 +474,7 @@ public:
     }
 
     index_t const pt_id = vtx.id(m_mp);
-    for (int j = 0; j < m_n_dofs_in_vtx; ++j)
-    {
-      *dofs++ = m_verts_dofs[region][pt_id][j];
-    }
+    dofs = copyDofs(dofs, m_verts_dofs, region, pt_id, m_n_dofs_in_vtx);
     return dofs;
   }
 
@@ -453,20 +502,14 @@ public:
       for (int i = 0; i < MeshT::verts_per_ridge; ++i)
       {
         index_t const pt_id = verts[i].id(m_mp);
-        for (int j = 0; j < m_n_dofs_in_vtx; ++j)
-        {
-          *dofs++ = m_verts_dofs[region][pt_id][j];
-        }
+        dofs = copyDofs(dofs, m_verts_dofs, region, pt_id, m_n_dofs_in_vtx);
       }
     }
 
     // ridges
     {
       index_t const ridge_id = ridge.id(m_mp);
-      for (int j = 0; j < m_n_dofs_in_ridge; ++j)
-      {
-        *dofs++ = m_ridges_dofs[region][ridge_id][j];
-      }
+      dofs = copyDofs(dofs, m_ridges_dofs, region, ridge_id, m_n_dofs_in_ridge);
     }
 
     return dofs;
@@ -492,10 +535,7 @@ public:
       for (int i = 0; i < MeshT::verts_per_facet; ++i)
       {
         index_t const pt_id = verts[i].id(m_mp);
-        for (int j = 0; j < m_n_dofs_in_vtx; ++j)
-        {
-          *dofs++ = m_verts_dofs[region][pt_id][j];
-        }
+        dofs = copyDofs(dofs, m_verts_dofs, region, pt_id, m_n_dofs_in_vtx);
       }
     }
 
@@ -509,20 +549,14 @@ public:
       for (int i = 0; i < MeshT::ridges_per_facet; ++i)
       {
         index_t const rd_id = ridges[i].id(m_mp);
-        for (int j = 0; j < m_n_dofs_in_ridge; ++j)
-        {
-          *dofs++ = m_ridges_dofs[region][rd_id][j];
-        }
+        dofs = copyDofs(dofs, m_ridges_dofs, region, rd_id, m_n_dofs_in_ridge);
       }
     }
 
     // facets
     {
       index_t const f_id = facet.id(m_mp);
-      for (int j = 0; j < m_n_dofs_in_facet; ++j)
-      {
-        *dofs++ = m_facets_dofs[region][f_id][j];
-      }
+      dofs = copyDofs(dofs, m_facets_dofs, region, f_id, m_n_dofs_in_facet);
     }
 
     return dofs;
@@ -550,10 +584,7 @@ public:
       for (int i = 0; i < MeshT::verts_per_cell; ++i)
       {
         index_t const pt_id = verts[i].id(m_mp);
-        for (int j = 0; j < m_n_dofs_in_vtx; ++j)
-        {
-          *dofs++ = m_verts_dofs[reg][pt_id][j];
-        }
+        dofs = copyDofs(dofs, m_verts_dofs, reg, pt_id, m_n_dofs_in_vtx);
       }
     }
 
@@ -565,10 +596,7 @@ public:
       for (int i = 0; i < MeshT::ridges_per_cell; ++i)
       {
         index_t const rd_id = ridges[i].id(m_mp);
-        for (int j = 0; j < m_n_dofs_in_ridge; ++j)
-        {
-          *dofs++ = m_ridges_dofs[reg][rd_id][j];
-        }
+        dofs = copyDofs(dofs, m_ridges_dofs, reg, rd_id, m_n_dofs_in_ridge);
       }
     }
 
@@ -580,10 +608,7 @@ public:
       for (int i = 0; i < MeshT::facets_per_cell; ++i)
       {
         index_t const f_id = facets[i].id(m_mp);
-        for (int j = 0; j < m_n_dofs_in_facet; ++j)
-        {
-          *dofs++ = m_facets_dofs[reg][f_id][j];
-        }
+        dofs = copyDofs(dofs, m_facets_dofs, reg, f_id, m_n_dofs_in_facet);
       }
 
     }
@@ -591,10 +616,7 @@ public:
     // cells
     {
       const index_t cell_id = cell.id(m_mp);
-      for (int j = 0; j < m_n_dofs_in_cell; ++j)
-      {
-        *dofs++ = m_cells_dofs[reg][cell_id][j];
-      }
+      dofs = copyDofs(dofs, m_cells_dofs, reg, cell_id, m_n_dofs_in_cell);
     }
 
     return dofs;
@@ -621,10 +643,7 @@ public:
       for (int i = 0; i < MeshT::verts_per_cell; ++i)
       {
         index_t const pt_id = verts[i].id(m_mp);
-        for (int j = 0; j < m_n_dofs_in_vtx; ++j)
-        {
-          *dofs++ = m_verts_dofs[reg][pt_id][j];
-        }
+        dofs = copyDofs(dofs, m_verts_dofs, reg, pt_id, m_n_dofs_in_vtx);
       }
     }
 
@@ -636,10 +655,7 @@ public:
       for (int i = 0; i < MeshT::ridges_per_cell; ++i)
       {
         index_t const rd_id = ridges[i].id(m_mp);
-        for (int j = 0; j < m_n_dofs_in_ridge; ++j)
-        {
-          *dofs++ = m_ridges_dofs[reg][rd_id][j];
-        }
+        dofs = copyDofs(dofs, m_ridges_dofs, reg, rd_id, m_n_dofs_in_ridge);
       }
     }
 
@@ -651,10 +667,7 @@ public:
       for (int i = 0; i < MeshT::facets_per_cell; ++i)
       {
         index_t const f_id = facets[i].id(m_mp);
-        for (int j = 0; j < m_n_dofs_in_facet; ++j)
-        {
-          *dofs++ = m_facets_dofs[reg][f_id][j];
-        }
+        dofs = copyDofs(dofs, m_facets_dofs, reg, f_id, m_n_dofs_in_facet);
       }
 
     }
@@ -662,10 +675,7 @@ public:
     // cells
     {
       const index_t cell_id = cell.id(m_mp);
-      for (int j = 0; j < m_n_dofs_in_cell; ++j)
-      {
-        *dofs++ = m_cells_dofs[reg][cell_id][j];
-      }
+      dofs = copyDofs(dofs, m_cells_dofs, reg, cell_id, m_n_dofs_in_cell);
     }
 
     return dofs;
@@ -694,10 +704,7 @@ public:
     // ridges
     {
       index_t const ridge_id = ridge.id(m_mp);
-      for (int j = 0; j < m_n_dofs_in_ridge; ++j)
-      {
-        *dofs++ = m_ridges_dofs[region][ridge_id][j];
-      }
+      dofs = copyDofs(dofs, m_ridges_dofs, region, ridge_id, m_n_dofs_in_ridge);
     }
 
     return dofs;
@@ -717,10 +724,7 @@ public:
     // facets
     {
       index_t const f_id = facet.id(m_mp);
-      for (int j = 0; j < m_n_dofs_in_facet; ++j)
-      {
-        *dofs++ = m_facets_dofs[region][f_id][j];
-      }
+      dofs = copyDofs(dofs, m_facets_dofs, region, f_id, m_n_dofs_in_facet);
     }
     return dofs;
   }
@@ -741,10 +745,7 @@ public:
     // cells
     {
       const index_t cell_id = cell.id(m_mp);
-      for (int j = 0; j < m_n_dofs_in_cell; ++j)
-      {
-        *dofs++ = m_cells_dofs[reg][cell_id][j];
-      }
+      dofs = copyDofs(dofs, m_cells_dofs, reg, cell_id, m_n_dofs_in_cell);
     }
     
     return dofs;
@@ -764,6 +765,9 @@ public:
   char const* getName() const
   { return m_name.c_str();}
 
+  MeshT const* mesh() const
+  { return m_mp; }
+
   //void linkVertexDofs(Point const* point1, Point const* point2);
 
 
@@ -121,12 +121,18 @@ public:
 
     if (NULL == fgets(buffer, sizeof(buffer), file_ptr)) // escapa do \n
       ALELIB_ASSERT(false, "invalid msh format", std::runtime_error);
+
+    // kept for the geometry nodes of the cells
+    std::vector<Real> file_coords(SpaceDim*num_pts + 1);
+
     for (index_t i=0; i< num_pts; ++i)
     {
       if ( NULL == fgets(buffer, sizeof(buffer), file_ptr) )
         ALELIB_ASSERT(false, "invalid msh format", std::runtime_error);
       sscanf(buffer, "%d %lf %lf %lf", &node_number, &coord[0], &coord[1], &coord[2]);
       ALELIB_ASSERT(node_number==i+1, "wrong file format", std::invalid_argument);
+      for (int k = 0; k < SpaceDim; ++k)
+        file_coords[SpaceDim*i + k] = coord[k];
 
       VertexH v = mesh->addVertex(coord, 0);
       v.reserve(mesh, max_valency_est);
@@ -193,6 +199,20 @@ public:
 
     nodes_per_cell = numNodeForMshTag(EMshTag(msh_cell_type));
 
+    // the high-order nodes of complete Lagrange cells are kept as the geometry of the mesh
+    {
+      ECellType ct;
+      int deg, cdim;
+      mshTypeAndOrder(EMshTag(msh_cell_type), ct, deg, cdim);
+      bool const same_order = (CellType == TETRAHEDRON) ? (deg <= 3) :
+                              (CellType == QUADRANGLE || CellType == HEXAHEDRON) ? (deg <= 2) : true;
+      if (same_order && nodes_per_cell == MeshT::numGeometryNodes(deg))
+        mesh->setGeometryDegree(deg);
+    }
+    int const geo_nodes = mesh->geometryDegree() > 1 ? MeshT::numGeometryNodes(mesh->geometryDegree()) : 0;
+    std::vector<index_t> cell_nodes(nodes_per_cell);
+    std::vector<Real>    cell_coords(nodes_per_cell*SpaceDim + 1);
+
     mesh->reserveCells(num_cells*1.1);
     mesh->reserveFacets( MeshT::estimateNumFacets(num_cells)*1.1  );
     mesh->reserveRidges( MeshT::estimateNumRidges(num_cells)*1.1  );
@@ -239,19 +259,27 @@ public:
       else if (elm_dim == cell_dim)
       {
         ++inc;
-        for (int i=0; i< MeshT::verts_per_cell; ++i)
+        // vertices, then high order nodes
+        for (int i=0; i< nodes_per_cell; ++i)
         {
           if ( EOF == fscanf(file_ptr, "%d", &id_aux) )
             ALELIB_ASSERT(false, "invalid msh format", std::runtime_error);
-          c_verts[i] = VertexH(--id_aux);
+          cell_nodes[i] = --id_aux;
         }
-        // ignore high order nodes
-        for (int i = MeshT::verts_per_cell; i < nodes_per_cell; ++i)
-          if ( EOF == fscanf(file_ptr, "%d", &id_aux) )
-            ALELIB_ASSERT(false, "invalid msh format", std::runtime_error);
-        
+        for (int i=0; i< MeshT::verts_per_cell; ++i)
+          c_verts[i] = VertexH(cell_nodes[i]);
+
         CellH c = mesh->addCell(c_verts);
         c.setTag(mesh, physical);
+
+        // the high-order nodes (the vertices were added with their coordinates)
+        if (geo_nodes > 0)
+        {
+          for (int i = 0; i < geo_nodes; ++i)
+            for (int j = 0; j < SpaceDim; ++j)
+              cell_coords[i*SpaceDim + j] = file_coords[SpaceDim*cell_nodes[i] + j];
+          mesh->setCellGeometryNodes(c, cell_coords.data());
+        }
       }
       else
       {
@@ -442,8 +470,36 @@ public:
     mesh->removeUnrefVertices();
   }
 
+  // copy the coordinates of the geometry nodes kept by the mesh (see readFile) to `coords'
+  // the degree of `var' must be the geometry degree of the mesh
+  void getCoordinates(MeshT const* mesh, Real* coords, VarT const& var) const
+  {
+    ALELIB_ASSERT(mesh, "invalid mesh pointer", std::invalid_argument);
+
+    int const deg = mesh->geometryDegree();
+    int const nodes_per_cell = MeshT::numGeometryNodes(deg);
+    ALELIB_ASSERT(coordinatesDegree(var) == deg, "current mesh order and variable order are incompatible", std::invalid_argument);
+
+    std::vector<index_t> x_dofs(nodes_per_cell*SpaceDim);
+    std::vector<Real>    X(nodes_per_cell*SpaceDim);
+
+    CellH c = mesh->cellBegin();
+    CellH const c_end = mesh->cellEnd();
+    for (; c != c_end; ++c)
+    {
+      if (c.isDisabled(mesh))
+        continue;
+      mesh->cellGeometryNodes(c, X.data());
+      var.getCellDofs(x_dofs.data(), c);
+      reorderDofsLagrange<MeshT,index_t>(mesh, c, deg, SpaceDim, x_dofs.data());
+      for (int i = 0; i < nodes_per_cell*SpaceDim; ++i)
+        coords[x_dofs[i]] = X[i];
+    }
+  }
+
   // read coordinates from a file
   // it assumes that the space dimension of the mesh is the same of the `coords'
+  // (see getCoordinates() for the nodes the mesh keeps)
   void readCoordinates(const char* filename, MeshT const* mesh, Real* coords, VarT const& var)
   {
     ALELIB_ASSERT(mesh, "invalid mesh pointer", std::invalid_argument);
@@ -506,13 +562,7 @@ public:
 
     // detect expected degree
     int const cell_dim = CTypeDim(CellType);
-    int expected_deg;
-    if (cell_dim == 1)
-      expected_deg = var.numDofsInCell()/SpaceDim + 1;
-    else if(cell_dim == 2)
-      expected_deg = var.numDofsInFacet()/SpaceDim + 1;
-    else
-      expected_deg = var.numDofsInRidge()/SpaceDim + 1;
+    int const expected_deg = coordinatesDegree(var);
 
     ALELIB_ASSERT(!(expected_deg >= 4 && CellType == TETRAHEDRON), "gmsh reader for this cell type is not implemented yet", std::invalid_argument);
 
@@ -622,6 +672,17 @@ public:
 
 
 
+  // degree of the Lagrange coordinates described by `var'
+  static int coordinatesDegree(VarT const& var)
+  {
+    switch (CTypeDim(CellType))
+    {
+      case 1:  return var.numDofsInCell()/SpaceDim + 1;
+      case 2:  return var.numDofsInFacet()/SpaceDim + 1;
+      default: return var.numDofsInRidge()/SpaceDim + 1;
+    }
+  }
+
   ECellType identifiesMeshType(const char* filename, int* space_dim_ = NULL) const
   {
 
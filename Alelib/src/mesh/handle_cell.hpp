@@ -97,7 +97,7 @@ public:
     CellT const& c = mp->m_cells[m_id];
     int const sd = mp->spaceDim();
     for (int i = 0; i < (int)CellT::n_verts; ++i)
-      mp->m_points[c.verts[i]].coord(coords+i*sd, sd);
+      mp->m_points[c.verts[i]].coord(coords+i*sd);
   }
 
   inline void facets(MeshT const* mp, FacetH* facets) const
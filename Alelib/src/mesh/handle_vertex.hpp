@@ -105,11 +105,9 @@ public:
     return mp->m_points[m_id].coord(i);
   }
 
+  /// also marks the geometry of the star as stale, see Mesh::enableGeometryCache()
   inline void setCoord(MeshT* mp, Real const* coord)
-  {
-    if (StoreCoords)
-      return mp->m_points[m_id].setCoord(coord, mp->spaceDim());
-  }
+  { setCoord(mp, m_id, coord); }
 
   // number os cells that contain this vertex
   inline unsigned valency(MeshT const* mp) const
@@ -198,10 +196,22 @@ private:
     return mp->m_points[vtx].coord(i);
   }
 
+  /// also moves the high-order nodes around (see Mesh::setGeometryDegree()) and marks the
+  /// geometry of the star as stale (see Mesh::enableGeometryCache())
   static inline void setCoord(MeshT* mp, index_t vtx, Real const* coord)
   {
-    if (StoreCoords)
-      return mp->m_points[vtx].setCoord(coord, mp->m_spacedim);
+    if (!StoreCoords)
+      return;
+    if (mp->m_ho_degree > 1)
+    {
+      Real d[3];
+      for (int i = 0; i < SpaceDim; ++i)
+        d[i] = coord[i] - mp->m_points[vtx].coord(i);
+      mp->moveGeometryNodes(vtx, d);
+    }
+    mp->m_points[vtx].setCoord(coord);
+    if (mp->m_geo_enabled)
+      mp->m_geo_moved.push_back(vtx);
   }
 
   // number os cells that contain a vertex
@@ -8,6 +8,7 @@
 #include "vertex.hpp"
 #include "point.hpp"
 #include "cell.hpp"
+#include "mesh_changes.hpp"
 #include "enums.hpp"
 #include "Array/array.hpp"
 #include "Alelib/src/util/list_type.hpp"
@@ -18,7 +19,9 @@
 #include "Alelib/src/util/timer.hpp"
 #include "AssocVector.hpp"
 #include "Alelib/src/io/alelib_tags.hpp"
+#include "Alelib/src/dof_mapper/reorder_table.hpp"
 #include <cmath>
+#include <algorithm>
 
 
 #include <iterator>      // std::iterator, std::input_iterator_tag
@@ -110,6 +113,38 @@ class Mesh
   marray::Array<int, 2> const m_table_bC_x_vC;
   marray::Array<int, 2> const m_table_bC_x_fC;
 
+  // log of added/removed entities; not owned
+  MeshChanges* m_changes;
+
+  // orientation codes of the cells, see orientationCode()
+  std::vector<uint16_t> m_orient_codes;
+
+  // affine geometry of the cells, see enableGeometryCache(); m_geo_data[k][cell] is the
+  // component k: J^-1, det J, volume, facet normals and facet areas.
+  bool                            m_geo_enabled;
+  bool                            m_geo_valid;  // false until the first update
+  std::vector<std::vector<Real> > m_geo_data;
+  std::vector<index_t>            m_geo_moved;  // vertices moved since the last update
+  std::vector<index_t>            m_geo_added;  // cells added since the last update
+  std::vector<char>               m_geo_mark;
+  std::vector<index_t>            m_geo_list;
+
+  // high-order geometry nodes, see setGeometryDegree(). The nodes inside an entity are stored once,
+  // in the orientation of the cell that owns it (as the dofs, see orientationCode()):
+  // m_ho_edge[(edge*m_ho_ne + k)*SpaceDim + i], the edges being the facets in 2D and the ridges
+  // in 3D, and likewise m_ho_face per facet in 3D and m_ho_cell per cell. A mesh that does not
+  // store coordinates keeps its vertices in m_ho_vert.
+  int               m_ho_degree;
+  int               m_ho_ne;       // nodes inside an edge,
+  int               m_ho_nf;       // a face
+  int               m_ho_ni;       // and a cell
+  std::vector<Real> m_ho_weights;  // [node*verts_per_cell + j]: P1 weight of the vertex j at the node
+  std::vector<Real> m_ho_vert;
+  std::vector<Real> m_ho_edge;
+  std::vector<Real> m_ho_face;
+  std::vector<Real> m_ho_cell;
+  std::vector<Real> m_ho_buf;      // scratch
+
 public:
 
   Timer timer;
@@ -288,7 +323,15 @@ public:
            m_table_vC_x_fC  (init_tables<CellType>(1)),
            m_table_fC_x_bC  (init_tables<CellType>(2)),
            m_table_bC_x_vC  (init_tables<CellType>(3)),
-           m_table_bC_x_fC  (init_tables<CellType>(4))
+           m_table_bC_x_fC  (init_tables<CellType>(4)),
+           m_changes(NULL),
+           m_orient_codes(),
+           m_geo_enabled(false),
+           m_geo_valid(false),
+           m_ho_degree(1),
+           m_ho_ne(0),
+           m_ho_nf(0),
+           m_ho_ni(0)
   { }
 
   ~Mesh() {}
@@ -307,6 +350,14 @@ public:
   // Dimensional Unstructured Meshes".
   //
 
+  /// Records the ids of all entities added or removed from now on in `changes`.
+  /// Pass NULL to stop recording. The mesh does not take ownership.
+  void trackChanges(MeshChanges* changes)
+  { m_changes = changes; }
+
+  MeshChanges* trackedChanges() const
+  { return m_changes; }
+
   void reserveCells(index_t n)
   { m_cells.reserve(n); }
   
@@ -343,6 +394,12 @@ public:
     //if (cell_dim > 2)
     //  for (index_t i = 0; i < (index_t)m_ridges.totalSize(); ++i)
     //    m_ridges.disable(i);
+    m_orient_codes.clear();
+    m_geo_valid = false;
+    m_geo_moved.clear();
+    m_geo_added.clear();
+    setGeometryDegree(1);
+    m_ho_vert.clear();
     m_cells.clear();
     m_verts.clear();
     if (cell_dim > 1) m_facets.clear();
@@ -361,6 +418,13 @@ public:
     m_verts[id].setTag(tag);
     if (StoreCoords)
       m_points[id].setCoord(coords);
+    else if (coords || !m_ho_vert.empty())
+    {
+      // the vertices of the geometry nodes, see setGeometryDegree()
+      m_ho_vert.resize(numVerticesTotal()*SpaceDim);
+      for (int i = 0; i < SpaceDim; ++i)
+        m_ho_vert[id*SpaceDim + i] = coords ? coords[i] : 0.;
+    }
     return VertexH(this, id);
   }
 
@@ -381,6 +445,8 @@ public:
     if (vtx.valency(this) == 0)
     {
       m_verts.disable(vtx.id(this));
+      if (m_changes)
+        m_changes->removed_verts.push_back(vtx.id(this));
       return true;
     }
     return false;
@@ -418,8 +484,11 @@ public:
 
     index_t const new_cid = pushCell();
     CellT &new_c = m_cells[new_cid];
+    if (m_geo_enabled)
+      m_geo_added.push_back(new_cid);
     index_t adj_id;
     index_t const* it;
+    unsigned new_entities = 0; // see storeGeometryNodes()
 
     // FIRST, SET UP ITSELF and other cells
     for (unsigned i = 0; i < nfpc; ++i)
@@ -457,6 +526,7 @@ public:
         new_f.m_flags = NO_FLAG;
         new_f.valency = 1;
         new_c.facets[i] = pushFacet(new_f);
+        new_entities |= 1u << (CellT::dim == 3 ? geo_edges + i : i);
         //// the new facet will always point to the new cell
         //new_c.facets[i] = pushFacet(FacetT(new_cid, i, NULL_IDX, NO_TAG, NO_FLAG, 1));
       }
@@ -503,6 +573,7 @@ public:
           new_r.m_flags = NO_FLAG;
           new_r.valency = 1;
           new_c.ridges[i] = pushRidge(new_r);
+          new_entities |= 1u << i;
           // the new facet will always point to the new cell
           //new_c.ridges[i] = pushRidge(RidgeT(new_cid, i, NO_TAG, NO_FLAG, 1));
         }
@@ -532,6 +603,16 @@ public:
     #undef nvpc
     #undef nfpc
 
+    // the cells around keep the facets and ridges they owned, so only this code is new
+    updateOrientationCode(new_cid);
+
+    // the nodes of the shared entities are kept
+    if (m_ho_degree > 1)
+    {
+      resizeGeometryNodes();
+      initGeometryNodes(new_cid, new_entities | geo_interior);
+    }
+
     return CellH(this, new_cid);
 
   }
@@ -550,6 +631,31 @@ public:
     index_t const cid = ch.id(this);
     CellT const& cell = this->m_cells[cid];
 
+    // the entities owned by the cell pass to other cells, whose orientation can differ: the nodes
+    // of the cells around are stored again after the orientation codes are updated
+    bool const reorient = m_ho_degree > 2 && (CellType == TRIANGLE || CellType == TETRAHEDRON);
+    std::vector<index_t> around;
+    std::vector<Real>    around_nodes;
+    if (reorient)
+    {
+      for (unsigned i = 0; i < nvpc; ++i)
+      {
+        VertexT const& vtx = m_verts[cell.verts[i]];
+        for (typename SetVector<index_t>::const_iterator it = vtx.icells.begin(); it != vtx.icells.end(); ++it)
+          if (*it != cid)
+            around.push_back(*it);
+      }
+      std::sort(around.begin(), around.end());
+      around.erase(std::unique(around.begin(), around.end()), around.end());
+      int const np = numGeometryNodes(m_ho_degree)*SpaceDim;
+      around_nodes.resize(around.size()*np);
+      for (std::size_t k = 0; k < around.size(); ++k)
+      {
+        loadGeometryNodes(around[k], &around_nodes[k*np]);
+        reorderGeometryNodes(around[k], &around_nodes[k*np]);
+      }
+    }
+
 
     // the facets, the cell and the neighbors
     for (unsigned i = 0; i < nvpc; ++i)
@@ -562,6 +668,8 @@ public:
       if (f.valency == 1) // boundary, delete it
       {
         m_facets.disable(fh.id(this));
+        if (m_changes)
+          m_changes->removed_facets.push_back(fh.id(this));
       }
       else if (f.valency == 2)
       {
@@ -607,7 +715,11 @@ public:
         // Update facets and remove unref facets
 
         if (r.valency == 1) // delete it
+        {
           m_ridges.disable(rh.id(this));
+          if (m_changes)
+            m_changes->removed_ridges.push_back(rh.id(this));
+        }
         else // if (r.valency > 1)
         {
           CellH ics[2];
@@ -630,6 +742,25 @@ public:
       vtx.icells.erase(cid);
     }
 
+    // the facets and ridges of the cell may have passed to other cells, all in these stars
+    for (unsigned i = 0; i < nvpc; ++i)
+    {
+      VertexT const& vtx = m_verts[cell.verts[i]];
+      for (typename SetVector<index_t>::const_iterator it = vtx.icells.begin(); it != vtx.icells.end(); ++it)
+        updateOrientationCode(*it);
+    }
+
+    if (reorient)
+    {
+      int const np = numGeometryNodes(m_ho_degree)*SpaceDim;
+      for (std::size_t k = 0; k < around.size(); ++k)
+      {
+        Real* X = &around_nodes[k*np];
+        reorderGeometryNodes(around[k], X);
+        storeGeometryNodes(around[k], X, geo_all & ~geo_vertices);
+      }
+    }
+
     if (remove_unref_verts)
     {
       for (unsigned i = 0; i < nvpc; ++i)
@@ -639,6 +770,8 @@ public:
     }
 
     m_cells.disable(ch.id(this));
+    if (m_changes)
+      m_changes->removed_cells.push_back(ch.id(this));
 
     #undef nvpc
     #undef nfpc
@@ -804,6 +937,215 @@ public:
   } 
 
 
+  /// Orientation of the sub-entities of a cell relative to the cells that own them,
+  /// packed in a code (used to reorder high-order dofs, see reorderDofsLagrange()):
+  ///   - triangles: bit i is set if the edge i is reversed;
+  ///   - tetrahedra: bit i (i<6) is set if the ridge i is reversed, and bits 6+2i,7+2i
+  ///     hold 0 if the cell owns the facet i, or 1 + the anchor of the facet otherwise.
+  /// Other cell types have code 0.
+  /// The codes are kept up to date by addCell() (the code of the new cell) and removeCell()
+  /// (the codes of the cells around the removed one), so this only reads them and can be
+  /// called from parallel loops.
+  uint16_t orientationCode(CellH c) const
+  { return m_orient_codes[c.id(this)]; }
+
+  /// Keeps (or stops keeping) the affine geometry of every cell: J^-1, det J, volume, and the
+  /// outward unit normals and areas of the facets, stored as one array per component indexed
+  /// by the cell id (disabled cells hold garbage). Only simplices, whose map is affine.
+  /// J is the Jacobian of the map from the reference simplex of the shape functions
+  /// (EDGE: [-1,1]), as in CellGeometry; if the space dimension is greater than the cell
+  /// dimension, the inverse is (J^T J)^-1 J^T and det J = sqrt(det J^T J).
+  ///
+  /// The arrays are brought up to date by updateGeometryCache() only, which must be called after
+  /// enabling the cache and after changes, and before the accessors are used (they check it in
+  /// debug mode). Changes only mark what they touch:
+  ///   - addCell marks the new cell; removeCell changes no other cell;
+  ///   - VertexH::setCoord marks the vertex, whose star is recomputed.
+  /// So the accessors only read, and can be called from parallel loops.
+  void enableGeometryCache(bool enable = true)
+  {
+    ALELIB_ASSERT(!enable || (StoreCoords && CellT::dim == CellT::n_verts - 1),
+                  "the geometry cache is only for simplices, and the mesh must store coordinates",
+                  std::invalid_argument);
+    m_geo_enabled = enable;
+    m_geo_valid = false;
+    m_geo_moved.clear();
+    m_geo_added.clear();
+    if (!enable)
+      std::vector<std::vector<Real> >().swap(m_geo_data);
+  }
+
+  bool geometryCacheEnabled() const
+  { return m_geo_enabled; }
+
+  /// true if the geometry cache is enabled and nothing changed since the last updateGeometryCache()
+  bool geometryCacheUpToDate() const
+  { return m_geo_enabled && m_geo_valid && m_geo_moved.empty() && m_geo_added.empty(); }
+
+  /// number of the components stored by the geometry cache
+  static int numGeometryComponents()
+  { return cell_dim*SpaceDim + 2 + facets_per_cell*(SpaceDim + 1); }
+
+  /// \f$ \partial\xi_j/\partial x_i \f$ of every cell
+  Real const* cellInvJacobians(int j, int i) const
+  { return geometryComponent(j*SpaceDim + i); }
+
+  Real const* cellDetJacobians() const
+  { return geometryComponent(cell_dim*SpaceDim); }
+
+  Real const* cellVolumes() const
+  { return geometryComponent(cell_dim*SpaceDim + 1); }
+
+  /// component i of the outward unit normal of the facet f of every cell
+  Real const* cellFacetNormals(int f, int i) const
+  { return geometryComponent(cell_dim*SpaceDim + 2 + f*SpaceDim + i); }
+
+  Real const* cellFacetAreas(int f) const
+  { return geometryComponent(cell_dim*SpaceDim + 2 + facets_per_cell*SpaceDim + f); }
+
+  /// Recomputes the geometry of the cells changed since the last update (all cells the first
+  /// time), in parallel.
+  /// @return the number of cells recomputed.
+  index_t updateGeometryCache()
+  {
+    ALELIB_CHECK(m_geo_enabled, "the geometry cache is not enabled", std::runtime_error);
+    index_t const n = numCellsTotal();
+
+    m_geo_data.resize(numGeometryComponents());
+    for (int k = 0; k < (int)m_geo_data.size(); ++k)
+      m_geo_data[k].resize(n);
+
+    m_geo_list.clear();
+    if (!m_geo_valid)
+    {
+      for (index_t i = 0; i < n; ++i)
+        if (!CellH(i).isDisabled(this))
+          m_geo_list.push_back(i);
+    }
+    else
+    {
+      // the added cells and the stars of the moved vertices, each cell once
+      m_geo_mark.assign(n, 0);
+      for (std::size_t k = 0; k < m_geo_added.size(); ++k)
+      {
+        index_t const c = m_geo_added[k];
+        if (!m_geo_mark[c] && !CellH(c).isDisabled(this))
+        {
+          m_geo_mark[c] = 1;
+          m_geo_list.push_back(c);
+        }
+      }
+      for (std::size_t k = 0; k < m_geo_moved.size(); ++k)
+      {
+        VertexT const& v = m_verts[m_geo_moved[k]];
+        for (typename SetVector<index_t>::const_iterator it = v.icells.begin(); it != v.icells.end(); ++it)
+          if (!m_geo_mark[*it])
+          {
+            m_geo_mark[*it] = 1;
+            m_geo_list.push_back(*it);
+          }
+      }
+    }
+
+    index_t const nl = m_geo_list.size();
+    ALE_PRAGMA_OMP(parallel for)
+    for (index_t k = 0; k < nl; ++k)
+      computeCellGeometry(m_geo_list[k]);
+
+    m_geo_moved.clear();
+    m_geo_added.clear();
+    m_geo_valid = true;
+    return nl;
+  }
+
+  /// Degree of the Lagrange map of the cells. With degree 1 (the default) the map is given by
+  /// the vertices. With a higher degree the mesh also keeps the nodes of the map that are not
+  /// vertices, once per edge, face and cell interior, so neighbor cells share them. The local
+  /// order of the nodes of a cell is the one of the "Lagrange" ("Lagrange_hcube" for quadrangles
+  /// and hexahedra) functions of that degree, which is the order of gmsh. A mesh that does not
+  /// store coordinates keeps its vertices along with the nodes (see addVertex()).
+  ///
+  /// The nodes follow the changes of the mesh:
+  ///   - setting the degree, and addCell for the edges, faces and interior it creates, put the
+  ///     nodes on the straight cell (setCellGeometryNodes() curves it);
+  ///   - removeCell drops the nodes only the cell had;
+  ///   - VertexH::setCoord displaces the nodes of the entities around the vertex by the
+  ///     displacement of the vertex times its P1 weight at the node, so straight cells stay straight.
+  /// Quadrangles and hexahedra go up to degree 2.
+  void setGeometryDegree(int degree)
+  {
+    ALELIB_ASSERT(degree >= 1, "invalid degree", std::invalid_argument);
+    ALELIB_ASSERT(degree <= 2 || CellType == EDGE || CellType == TRIANGLE || CellType == TETRAHEDRON,
+                  "quadrangles and hexahedra go up to degree 2", std::invalid_argument);
+    int const m = degree - 1;
+    m_ho_degree = degree;
+    m_ho_ne = geo_edges > 0 ? m : 0;
+    m_ho_nf = geo_faces == 0 ? 0 : (verts_per_facet == 3 ? m*(m - 1)/2 : m*m);
+    m_ho_ni = numGeometryNodes(degree) - verts_per_cell - geo_edges*m_ho_ne - geo_faces*m_ho_nf;
+    m_ho_edge.clear();
+    m_ho_face.clear();
+    m_ho_cell.clear();
+    computeGeometryNodeWeights();
+    if (degree == 1)
+      return;
+    resizeGeometryNodes();
+    for (index_t c = 0; c < (index_t)numCellsTotal(); ++c)
+      if (!CellH(c).isDisabled(this))
+        initGeometryNodes(c, geo_all & ~geo_vertices);
+  }
+
+  int geometryDegree() const
+  { return m_ho_degree; }
+
+  /// number of the nodes of the Lagrange map of degree `degree` of a cell, vertices included
+  static int numGeometryNodes(int degree)
+  {
+    int const n = degree;
+    switch (CellType)
+    {
+      case EDGE:        return n + 1;
+      case TRIANGLE:    return (n + 1)*(n + 2)/2;
+      case QUADRANGLE:  return (n + 1)*(n + 1);
+      case TETRAHEDRON: return (n + 1)*(n + 2)*(n + 3)/6;
+      case HEXAHEDRON:  return (n + 1)*(n + 1)*(n + 1);
+      default:          return verts_per_cell;
+    }
+  }
+
+  /// Sets the nodes of the edges, faces and interior of the cell, and its vertices if the mesh
+  /// does not store coordinates (otherwise they are the vertex coordinates, and are ignored).
+  /// The nodes of an entity shared with other cells change for them too.
+  /// @param X the coordinates of the nodes of the cell, as cellGeometryNodes() gives them.
+  void setCellGeometryNodes(CellH c, Real const* X)
+  {
+    index_t const id = c.id(this);
+    m_ho_buf.assign(X, X + numGeometryNodes(m_ho_degree)*SpaceDim);
+    reorderGeometryNodes(id, &m_ho_buf[0]);
+    storeGeometryNodes(id, &m_ho_buf[0], geo_all);
+  }
+
+  /// The coordinates of all nodes of the map of the cell, numGeometryNodes(geometryDegree())*SpaceDim
+  /// Reals: the vertices, then the high-order nodes. X is the `nodes' argument of
+  /// CellGeometry::compute for one cell.
+  void cellGeometryNodes(CellH c, Real* X) const
+  {
+    index_t const id = c.id(this);
+    CellT const& cell = m_cells[id];
+    int const sd = SpaceDim;
+    for (int j = 0; j < verts_per_cell; ++j)
+    {
+      if (StoreCoords)
+        m_points[cell.verts[j]].coord(X + j*sd);
+      else
+      {
+        ALELIB_CHECK(std::size_t(cell.verts[j] + 1)*sd <= m_ho_vert.size(), "the vertices of the cell have no coordinates", std::invalid_argument);
+        std::copy(&m_ho_vert[cell.verts[j]*sd], &m_ho_vert[cell.verts[j]*sd] + sd, X + j*sd);
+      }
+    }
+    loadGeometryNodes(id, X);
+    reorderGeometryNodes(id, X);
+  }
+
   // DEBUG purposes
   static void printElementsSize()
   {
@@ -815,29 +1157,385 @@ public:
 
 private:
 
+  Real const* geometryComponent(int k) const
+  {
+    ALELIB_CHECK(geometryCacheUpToDate(), "the geometry cache is stale: call updateGeometryCache()", std::runtime_error);
+    return m_geo_data[k].empty() ? NULL : &m_geo_data[k][0];
+  }
+
+  void computeCellGeometry(index_t id)
+  {
+    int const dim = cell_dim, sd = SpaceDim;
+    CellT const& c = m_cells[id];
+
+    // J_ij = dx_i/dxi_j
+    Real J[3][3], Ji[3][3], det;
+    for (int i = 0; i < sd; ++i)
+      for (int j = 0; j < dim; ++j)
+        J[i][j] = m_points[c.verts[j+1]].coord(i) - m_points[c.verts[0]].coord(i);
+    if (dim == 1)
+      for (int i = 0; i < sd; ++i)
+        J[i][0] /= 2.;
+
+    // G = J^T J, then J^-1 = G^-1 J^T (= J^-1 when sd == dim)
+    Real G[3][3], Gi[3][3];
+    for (int j = 0; j < dim; ++j)
+      for (int l = 0; l < dim; ++l)
+      {
+        G[j][l] = 0;
+        for (int i = 0; i < sd; ++i)
+          G[j][l] += J[i][j]*J[i][l];
+      }
+    Real const g = invert(dim, G, Gi);
+    for (int j = 0; j < dim; ++j)
+      for (int i = 0; i < sd; ++i)
+      {
+        Ji[j][i] = 0;
+        for (int l = 0; l < dim; ++l)
+          Ji[j][i] += Gi[j][l]*J[i][l];
+      }
+    if (sd == dim)
+    {
+      Real Jc[3][3], Jinv[3][3];
+      for (int i = 0; i < dim; ++i)
+        for (int j = 0; j < dim; ++j)
+          Jc[i][j] = J[i][j];
+      det = invert(dim, Jc, Jinv);
+    }
+    else
+      det = std::sqrt(g);
+
+    Real const ref_vol = dim == 1 ? 2. : (dim == 2 ? 0.5 : 1./6.);
+    Real const vol = std::fabs(det)*ref_vol;
+
+    int k = 0;
+    for (int j = 0; j < dim; ++j)
+      for (int i = 0; i < sd; ++i)
+        m_geo_data[k++][id] = Ji[j][i];
+    m_geo_data[k++][id] = det;
+    m_geo_data[k++][id] = vol;
+
+    // the normal of a facet is minus the gradient of the barycentric coordinate of the opposite
+    // vertex, whose length is area/(dim*volume)
+    Real gradL[4][3];
+    for (int i = 0; i < sd; ++i)
+    {
+      gradL[0][i] = 0;
+      for (int j = 0; j < dim; ++j)
+      {
+        gradL[j+1][i] = dim == 1 ? Ji[j][i]/2. : Ji[j][i];
+        gradL[0][i] -= gradL[j+1][i];
+      }
+    }
+    Real areas[4];
+    for (int f = 0; f < facets_per_cell; ++f)
+    {
+      int opp = 0;
+      while (isFacetVertex(f, opp))
+        ++opp;
+      Real len = 0;
+      for (int i = 0; i < sd; ++i)
+        len += gradL[opp][i]*gradL[opp][i];
+      len = std::sqrt(len);
+      for (int i = 0; i < sd; ++i)
+        m_geo_data[k++][id] = -gradL[opp][i]/len;
+      areas[f] = dim*vol*len;
+    }
+    for (int f = 0; f < facets_per_cell; ++f)
+      m_geo_data[k++][id] = areas[f];
+  }
+
+  bool isFacetVertex(int f, int v) const
+  {
+    for (int j = 0; j < verts_per_facet; ++j)
+      if (m_table_fC_x_vC(f, j) == v)
+        return true;
+    return false;
+  }
+
+  // inverse of the n x n matrix A; returns det A
+  static Real invert(int n, Real const A[3][3], Real B[3][3])
+  {
+    Real det;
+    if (n == 1)
+    {
+      det = A[0][0];
+      B[0][0] = 1./det;
+    }
+    else if (n == 2)
+    {
+      det = A[0][0]*A[1][1] - A[0][1]*A[1][0];
+      B[0][0] =  A[1][1]/det;  B[0][1] = -A[0][1]/det;
+      B[1][0] = -A[1][0]/det;  B[1][1] =  A[0][0]/det;
+    }
+    else
+    {
+      B[0][0] = A[1][1]*A[2][2] - A[1][2]*A[2][1];
+      B[1][0] = A[1][2]*A[2][0] - A[1][0]*A[2][2];
+      B[2][0] = A[1][0]*A[2][1] - A[1][1]*A[2][0];
+      det = A[0][0]*B[0][0] + A[0][1]*B[1][0] + A[0][2]*B[2][0];
+      B[0][1] = A[0][2]*A[2][1] - A[0][1]*A[2][2];
+      B[0][2] = A[0][1]*A[1][2] - A[0][2]*A[1][1];
+      B[1][1] = A[0][0]*A[2][2] - A[0][2]*A[2][0];
+      B[1][2] = A[0][2]*A[1][0] - A[0][0]*A[1][2];
+      B[2][1] = A[0][1]*A[2][0] - A[0][0]*A[2][1];
+      B[2][2] = A[0][0]*A[1][1] - A[0][1]*A[1][0];
+      for (int i = 0; i < 3; ++i)
+        for (int j = 0; j < 3; ++j)
+          B[i][j] /= det;
+    }
+    return det;
+  }
+
+  void updateOrientationCode(index_t id)
+  {
+    if (id >= (index_t)m_orient_codes.size())
+      m_orient_codes.resize(numCellsTotal(), 0);
+    if (CellType == TRIANGLE || CellType == TETRAHEDRON)
+      m_orient_codes[id] = computeOrientationCode(CellH(id));
+  }
+
+  uint16_t computeOrientationCode(CellH c) const
+  {
+    uint16_t code = 0;
+    int anchor;
+
+    if (CellT::dim == 2)
+    {
+      for (int i = 0; i < (int)CellT::n_facets; ++i)
+      {
+        if (c.facet(this, i).icellSide0(this) == c)
+          continue;
+        c.adjSideAndAnchor(this, i, &anchor);
+        if (!anchor)
+          code |= 1 << i;
+      }
+    }
+    else if (CellT::dim == 3)
+    {
+      VertexH ridge_verts_my[2];
+      VertexH ridge_verts_other[2];
+      for (int i = 0; i < (int)CellT::n_ridges; ++i)
+      {
+        RidgeH const r = c.ridge(this, i);
+        if (r.icell(this) == c)
+          continue;
+        r.vertices(this, ridge_verts_other);
+        c.ridgeVertices(this, i, ridge_verts_my);
+        if (ridge_verts_other[0] != ridge_verts_my[0])
+          code |= 1 << i;
+      }
+      for (int i = 0; i < (int)CellT::n_facets; ++i)
+      {
+        if (c.facet(this, i).icellSide0(this) == c)
+          continue;
+        c.adjSideAndAnchor(this, i, &anchor);
+        code |= (anchor + 1) << (CellT::n_ridges + 2*i);
+      }
+    }
+    return code;
+  }
+
+  // the entities that hold geometry nodes, as bits of the masks of storeGeometryNodes()
+  static const int      geo_edges    = CellT::dim == 3 ? CellT::n_ridges : (CellT::dim == 2 ? CellT::n_facets : 0);
+  static const int      geo_faces    = CellT::dim == 3 ? CellT::n_facets : 0;
+  static const unsigned geo_interior = 1u << (geo_edges + geo_faces);
+  static const unsigned geo_vertices = geo_interior << 1;
+  static const unsigned geo_all      = (geo_vertices << 1) - 1;
+
+  // id of the edge i of a cell: a facet in 2D, a ridge in 3D
+  index_t cellEdge(CellT const& cell, int i) const
+  { return CellT::dim == 3 ? cell.ridges[i] : cell.facets[i]; }
+
+  index_t edgeOwner(index_t e) const
+  { return CellT::dim == 3 ? m_ridges[e].icell : m_facets[e].icell; }
+
+  void resizeGeometryNodes()
+  {
+    std::size_t const n_edges = CellT::dim == 3 ? numRidgesTotal() : (CellT::dim == 2 ? numFacetsTotal() : 0);
+    m_ho_edge.resize(n_edges*m_ho_ne*SpaceDim);
+    if (geo_faces > 0)
+      m_ho_face.resize(numFacetsTotal()*m_ho_nf*SpaceDim);
+    m_ho_cell.resize(numCellsTotal()*m_ho_ni*SpaceDim);
+  }
+
+  // P1 weights of the vertices at the nodes, from the integer parametric points
+  void computeGeometryNodeWeights()
+  {
+    int const n = m_ho_degree, nv = verts_per_cell, np = numGeometryNodes(n);
+    std::vector<int> pts;
+    switch (CellType)
+    {
+      case EDGE:        genLineParametricPtsINT(n, pts); break;
+      case TRIANGLE:    genTriParametricPtsINT(n, pts);  break;
+      case QUADRANGLE:  genQuadParametricPtsINT(n, pts); break;
+      case TETRAHEDRON: genTetParametricPtsINT(n, pts);  break;
+      case HEXAHEDRON:  genHexParametricPtsINT(n, pts);  break;
+      default: ALELIB_ASSERT(false, "invalid cell type", std::runtime_error);
+    }
+    m_ho_weights.resize(np*nv);
+    for (int k = 0; k < np; ++k)
+    {
+      int const* p = &pts[k*cell_dim];
+      Real* w = &m_ho_weights[k*nv];
+      if (CellType == EDGE)
+      {
+        w[0] = (n - p[0])/(2.*n);
+        w[1] = (n + p[0])/(2.*n);
+      }
+      else if (CellType == TRIANGLE || CellType == TETRAHEDRON)
+      {
+        w[0] = 1.;
+        for (int d = 0; d < cell_dim; ++d)
+        {
+          w[d + 1] = Real(p[d])/n;
+          w[0] -= w[d + 1];
+        }
+      }
+      else // the vertices of quadrangles and hexahedra are the corners of [-n,n]^dim
+        for (int j = 0; j < nv; ++j)
+        {
+          int const sign[3] = {(j%4 == 1 || j%4 == 2) ? 1 : -1, j%4 >= 2 ? 1 : -1, j >= 4 ? 1 : -1};
+          w[j] = 1.;
+          for (int d = 0; d < cell_dim; ++d)
+            w[j] *= (n + sign[d]*p[d])/(2.*n);
+        }
+    }
+  }
+
+  // from the local order of the nodes of a cell to the order of the owners of its entities, and
+  // back: the swaps of the dofs (see reorderDofsLagrange()), which undo themselves
+  void reorderGeometryNodes(index_t cid, Real* X) const
+  {
+    if (m_ho_degree < 3 || !(CellType == TRIANGLE || CellType == TETRAHEDRON))
+      return;
+    unsigned const code = m_orient_codes[cid];
+    if (!code)
+      return;
+    typedef internal::LagrangeReorderTable<CellType == TRIANGLE ? TRIANGLE : TETRAHEDRON> TableT;
+    if (m_ho_degree <= TableT::max_cached_degree)
+      TableT::get(m_ho_degree).apply(code, SpaceDim, X);
+    else
+      TableT(m_ho_degree).apply(code, SpaceDim, X);
+  }
+
+  // copies the nodes of the entities of the cell to X, after the vertices, in the order of the owners
+  void loadGeometryNodes(index_t cid, Real* X) const
+  {
+    CellT const& cell = m_cells[cid];
+    int const sd = SpaceDim;
+    X += verts_per_cell*sd;
+    for (int i = 0; i < geo_edges; ++i, X += m_ho_ne*sd)
+      std::copy(m_ho_edge.data() + cellEdge(cell, i)*m_ho_ne*sd, m_ho_edge.data() + (cellEdge(cell, i) + 1)*m_ho_ne*sd, X);
+    for (int i = 0; i < geo_faces; ++i, X += m_ho_nf*sd)
+      std::copy(m_ho_face.data() + cell.facets[i]*m_ho_nf*sd, m_ho_face.data() + (cell.facets[i] + 1)*m_ho_nf*sd, X);
+    std::copy(m_ho_cell.data() + cid*m_ho_ni*sd, m_ho_cell.data() + (cid + 1)*m_ho_ni*sd, X);
+  }
+
+  // copies the nodes in X, in the order of the owners, to the entities of the cell in the mask:
+  // bit i for the edge i, bit geo_edges + i for the face i, geo_interior and geo_vertices
+  void storeGeometryNodes(index_t cid, Real const* X, unsigned mask)
+  {
+    CellT const& cell = m_cells[cid];
+    int const sd = SpaceDim;
+    if (!StoreCoords && (mask & geo_vertices))
+    {
+      m_ho_vert.resize(std::max<std::size_t>(m_ho_vert.size(), numVerticesTotal()*sd));
+      for (int j = 0; j < verts_per_cell; ++j)
+        std::copy(X + j*sd, X + (j + 1)*sd, m_ho_vert.begin() + cell.verts[j]*sd);
+    }
+    X += verts_per_cell*sd;
+    for (int i = 0; i < geo_edges; ++i, X += m_ho_ne*sd)
+      if (mask & (1u << i))
+        std::copy(X, X + m_ho_ne*sd, m_ho_edge.begin() + cellEdge(cell, i)*m_ho_ne*sd);
+    for (int i = 0; i < geo_faces; ++i, X += m_ho_nf*sd)
+      if (mask & (1u << (geo_edges + i)))
+        std::copy(X, X + m_ho_nf*sd, m_ho_face.begin() + cell.facets[i]*m_ho_nf*sd);
+    if (mask & geo_interior)
+      std::copy(X, X + m_ho_ni*sd, m_ho_cell.begin() + cid*m_ho_ni*sd);
+  }
+
+  // puts the nodes of the entities in the mask on the straight cell
+  void initGeometryNodes(index_t cid, unsigned mask)
+  {
+    CellT const& cell = m_cells[cid];
+    int const nv = verts_per_cell, sd = SpaceDim, np = numGeometryNodes(m_ho_degree);
+    Real V[8*3];
+    for (int j = 0; j < nv; ++j)
+    {
+      if (StoreCoords)
+        m_points[cell.verts[j]].coord(V + j*sd);
+      else if (std::size_t(cell.verts[j] + 1)*sd <= m_ho_vert.size())
+        std::copy(&m_ho_vert[cell.verts[j]*sd], &m_ho_vert[cell.verts[j]*sd] + sd, V + j*sd);
+      else
+        std::fill(V + j*sd, V + (j + 1)*sd, Real(0));
+    }
+    m_ho_buf.assign(np*sd, 0.);
+    for (int k = 0; k < np; ++k)
+      for (int j = 0; j < nv; ++j)
+        for (int i = 0; i < sd; ++i)
+          m_ho_buf[k*sd + i] += m_ho_weights[k*nv + j]*V[j*sd + i];
+    reorderGeometryNodes(cid, &m_ho_buf[0]);
+    storeGeometryNodes(cid, &m_ho_buf[0], mask & ~geo_vertices);
+  }
+
+  // the nodes of the entities around the vertex follow its displacement d, each entity through its owner
+  void moveGeometryNodes(index_t vtx, Real const* d)
+  {
+    int const nv = verts_per_cell, sd = SpaceDim;
+    SetVector<index_t> const& star = m_verts[vtx].icells;
+    for (typename SetVector<index_t>::const_iterator it = star.begin(); it != star.end(); ++it)
+    {
+      index_t const cid = *it;
+      CellT const& cell = m_cells[cid];
+      int j = 0;
+      while (cell.verts[j] != vtx)
+        ++j;
+      // an owned entity is stored in the local order of the cell
+      int node = nv;
+      for (int i = 0; i < geo_edges; ++i, node += m_ho_ne)
+        if (edgeOwner(cellEdge(cell, i)) == cid)
+          displaceGeometryNodes(m_ho_edge.data() + cellEdge(cell, i)*m_ho_ne*sd, node, m_ho_ne, j, d);
+      for (int i = 0; i < geo_faces; ++i, node += m_ho_nf)
+        if (m_facets[cell.facets[i]].icell == cid)
+          displaceGeometryNodes(m_ho_face.data() + cell.facets[i]*m_ho_nf*sd, node, m_ho_nf, j, d);
+      displaceGeometryNodes(m_ho_cell.data() + cid*m_ho_ni*sd, node, m_ho_ni, j, d);
+    }
+  }
+
+  void displaceGeometryNodes(Real* x, int first_node, int n, int j, Real const* d)
+  {
+    for (int k = 0; k < n; ++k)
+    {
+      Real const w = m_ho_weights[(first_node + k)*verts_per_cell + j];
+      for (int i = 0; i < SpaceDim; ++i)
+        x[k*SpaceDim + i] += w*d[i];
+    }
+  }
+
   // return id of the cell
   index_t pushCell()
-  { return m_cells.insert(); }
+  { return logAdded(m_changes ? &m_changes->added_cells : NULL, m_cells.insert()); }
 
   // return id of the cell
   index_t pushCell(CellT const& a)
-  { return m_cells.insert(a); }
+  { return logAdded(m_changes ? &m_changes->added_cells : NULL, m_cells.insert(a)); }
 
   index_t pushFacet()
-  { return m_facets.insert(); }
+  { return logAdded(m_changes ? &m_changes->added_facets : NULL, m_facets.insert()); }
 
   index_t pushFacet(FacetT const& a)
-  { return m_facets.insert(a); }
+  { return logAdded(m_changes ? &m_changes->added_facets : NULL, m_facets.insert(a)); }
 
   index_t pushRidge()
-  { return m_ridges.insert(); }
+  { return logAdded(m_changes ? &m_changes->added_ridges : NULL, m_ridges.insert()); }
 
   index_t pushRidge(RidgeT const& a)
-  { return m_ridges.insert(a); }
+  { return logAdded(m_changes ? &m_changes->added_ridges : NULL, m_ridges.insert(a)); }
 
   index_t pushVertex()
   {
-    index_t const id = m_verts.insert();
+    index_t const id = logAdded(m_changes ? &m_changes->added_verts : NULL, m_verts.insert());
     if (StoreCoords)
       if (id == (index_t)m_points.size())
         m_points.push_back(PointT());
@@ -846,7 +1544,7 @@ private:
 
   index_t pushVertex(VertexT const& a, Real const* b)
   {
-    index_t const id = m_verts.insert(a);
+    index_t const id = logAdded(m_changes ? &m_changes->added_verts : NULL, m_verts.insert(a));
     if (StoreCoords)
     {
       if (id == (index_t)m_points.size())
@@ -857,7 +1555,12 @@ private:
     return id;
   }
 
-
+  static index_t logAdded(std::vector<index_t>* log, index_t id)
+  {
+    if (log)
+      log->push_back(id);
+    return id;
+  }
 
 }; // end Mesh class
 
@@ -0,0 +1,66 @@
+// This file is part of Alelib, a toolbox for finite element codes.
+//
+// Alelib is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// Alelib is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// Alelib. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALELIB_MESH_CHANGES_HPP
+#define ALELIB_MESH_CHANGES_HPP
+
+#include <vector>
+#include "conf/directives.hpp"
+
+namespace alelib
+{
+
+/// Log of the entities added to and removed from a mesh.
+/// It is filled by a Mesh when passed to Mesh::trackChanges and consumed by
+/// DofMapper::updateDofs. An id may appear in both lists of the same kind, e.g.,
+/// when an entity is removed and its id is reused by a new entity.
+struct MeshChanges
+{
+  std::vector<index_t> added_cells;
+  std::vector<index_t> removed_cells;
+  std::vector<index_t> added_facets;
+  std::vector<index_t> removed_facets;
+  std::vector<index_t> added_ridges;
+  std::vector<index_t> removed_ridges;
+  std::vector<index_t> added_verts;
+  std::vector<index_t> removed_verts;
+
+  void clear()
+  {
+    added_cells.clear();  removed_cells.clear();
+    added_facets.clear(); removed_facets.clear();
+    added_ridges.clear(); removed_ridges.clear();
+    added_verts.clear();  removed_verts.clear();
+  }
+
+  bool empty() const
+  {
+    return added_cells.empty()  && removed_cells.empty()  &&
+           added_facets.empty() && removed_facets.empty() &&
+           added_ridges.empty() && removed_ridges.empty() &&
+           added_verts.empty()  && removed_verts.empty();
+  }
+};
+
+} // end namespace alelib
+
+
+#endif
@@ -0,0 +1,224 @@
+#include "facet_quadrature.hpp"
+#include "../util/assert.hpp"
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace alelib
+{
+
+namespace
+{
+  // same numbering as Mesh::m_table_fC_x_vC
+  int const edge_fC_x_vC[2][1] = {{0}, {1}};
+  int const tri_fC_x_vC [3][2] = {{0,1}, {1,2}, {2,0}};
+  int const quad_fC_x_vC[4][2] = {{0,1}, {1,2}, {2,3}, {3,0}};
+  int const tet_fC_x_vC [4][3] = {{1,0,2}, {0,1,3}, {3,2,0}, {2,3,1}};
+  int const hex_fC_x_vC [6][4] = {{0,3,2,1}, {0,1,5,4}, {0,4,7,3}, {1,2,6,5}, {2,3,7,6}, {4,5,6,7}};
+
+  Real const edge_vtx[2][3] = {{-1,0,0}, {1,0,0}};
+  Real const tri_vtx [3][3] = {{0,0,0}, {1,0,0}, {0,1,0}};
+  Real const quad_vtx[4][3] = {{-1,-1,0}, {1,-1,0}, {1,1,0}, {-1,1,0}};
+  Real const tet_vtx [4][3] = {{0,0,0}, {1,0,0}, {0,1,0}, {0,0,1}};
+  Real const hex_vtx [8][3] = {{-1,-1,-1}, {1,-1,-1}, {1,1,-1}, {-1,1,-1},
+                               {-1,-1, 1}, {1,-1, 1}, {1,1, 1}, {-1,1, 1}};
+
+  struct RefCell
+  {
+    int dim, nverts, nfacets, nvpf;
+    ECellType facet_type;
+    Real const (*vtx)[3];
+    int const* fC_x_vC;    // nfacets x nvpf
+  };
+
+  RefCell refCell(ECellType ct)
+  {
+    RefCell r = {0, 0, 0, 0, UNDEFINED_CELLT, NULL, NULL};
+    switch (ct)
+    {
+      case EDGE:
+      { RefCell c = {1, 2, 2, 1, POINT,      edge_vtx, &edge_fC_x_vC[0][0]}; r = c; }
+      break;
+      case TRIANGLE:
+      { RefCell c = {2, 3, 3, 2, EDGE,       tri_vtx,  &tri_fC_x_vC[0][0]};  r = c; }
+      break;
+      case QUADRANGLE:
+      { RefCell c = {2, 4, 4, 2, EDGE,       quad_vtx, &quad_fC_x_vC[0][0]}; r = c; }
+      break;
+      case TETRAHEDRON:
+      { RefCell c = {3, 4, 4, 3, TRIANGLE,   tet_vtx,  &tet_fC_x_vC[0][0]};  r = c; }
+      break;
+      case HEXAHEDRON:
+      { RefCell c = {3, 8, 6, 4, QUADRANGLE, hex_vtx,  &hex_fC_x_vC[0][0]};  r = c; }
+      break;
+      default:
+        ALELIB_ASSERT(false, "FacetQuadrature: invalid cell type", std::invalid_argument);
+    }
+    return r;
+  }
+
+  // values of the vertex functions of the reference facet at x
+  void facetVertexFunctions(ECellType ft, Real const* x, Real* phi)
+  {
+    switch (ft)
+    {
+      case POINT:
+        phi[0] = 1.;
+      break;
+      case EDGE:
+        phi[0] = (1. - x[0])/2.;
+        phi[1] = (1. + x[0])/2.;
+      break;
+      case TRIANGLE:
+        phi[0] = 1. - x[0] - x[1];
+        phi[1] = x[0];
+        phi[2] = x[1];
+      break;
+      default: // QUADRANGLE
+        phi[0] = (1. - x[0])*(1. - x[1])/4.;
+        phi[1] = (1. + x[0])*(1. - x[1])/4.;
+        phi[2] = (1. + x[0])*(1. + x[1])/4.;
+        phi[3] = (1. - x[0])*(1. + x[1])/4.;
+    }
+  }
+
+  // measure of the reference facet
+  Real facetRefMeasure(ECellType ft)
+  {
+    switch (ft)
+    {
+      case EDGE:       return 2.;
+      case TRIANGLE:   return 0.5;
+      case QUADRANGLE: return 4.;
+      default:         return 1.;
+    }
+  }
+
+  // owns the facet quadratures computed so far
+  struct FacetQuadrStore
+  {
+    typedef std::map<std::pair<int, std::pair<int,int> >, FacetQuadrature*> MapT;
+    MapT       table;
+    std::mutex lock;
+
+    ~FacetQuadrStore()
+    {
+      for (MapT::iterator it = table.begin(); it != table.end(); ++it)
+        delete it->second;
+    }
+  };
+
+  FacetQuadrStore& facetQuadrStore()
+  {
+    static FacetQuadrStore store;
+    return store;
+  }
+}
+
+
+FacetQuadrature const& FacetQuadrature::get(ECellType ct, int degree, EQuadrRule rule)
+{
+  FacetQuadrStore& store = facetQuadrStore();
+  std::lock_guard<std::mutex> guard(store.lock);
+
+  std::pair<int, std::pair<int,int> > const key(ct, std::make_pair(degree, int(rule)));
+  FacetQuadrStore::MapT::iterator it = store.table.find(key);
+  if (it == store.table.end())
+    it = store.table.insert(std::make_pair(key, new FacetQuadrature(ct, degree, rule))).first;
+
+  return *it->second;
+}
+
+FacetQuadrature::FacetQuadrature(ECellType ct, int degree, EQuadrRule rule)
+  : m_cell_type(ct)
+{
+  RefCell const ref = refCell(ct);
+  int const n = ref.nvpf;
+
+  m_dim      = ref.dim;
+  m_nfacets  = ref.nfacets;
+  m_norients = 1 + n;
+  m_facet_rule.setType(ref.facet_type, degree, rule);
+  m_npts     = m_facet_rule.numPoints();
+
+  m_points.resize(m_nfacets*m_norients*m_npts*m_dim);
+  m_weights.resize(m_nfacets*m_npts);
+  m_normals.resize(m_nfacets*m_dim);
+  m_measures.resize(m_nfacets);
+
+  Real centroid[3] = {0,0,0};
+  for (int v = 0; v < ref.nverts; ++v)
+    for (int c = 0; c < m_dim; ++c)
+      centroid[c] += ref.vtx[v][c]/ref.nverts;
+
+  for (int f = 0; f < m_nfacets; ++f)
+  {
+    int const* V = ref.fC_x_vC + f*n;
+    Real const* x0 = ref.vtx[V[0]];
+
+    // measure and normal
+    Real nrm[3] = {0,0,0};
+    Real meas = 1.;
+    if (m_dim == 1)
+      nrm[0] = 1.;
+    else if (m_dim == 2)
+    {
+      Real const* x1 = ref.vtx[V[1]];
+      nrm[0] =   x1[1] - x0[1];
+      nrm[1] = -(x1[0] - x0[0]);
+      meas = std::sqrt(nrm[0]*nrm[0] + nrm[1]*nrm[1]);
+    }
+    else
+    {
+      // the cross product of the diagonals is twice the area of a planar quadrangle
+      Real const* a = ref.vtx[V[n == 4 ? 2 : 1]];
+      Real const* b = ref.vtx[V[n == 4 ? 3 : 2]];
+      Real const* o = ref.vtx[V[n == 4 ? 1 : 0]];
+      Real const u[3] = {a[0]-x0[0], a[1]-x0[1], a[2]-x0[2]};
+      Real const w[3] = {b[0]- o[0], b[1]- o[1], b[2]- o[2]};
+      nrm[0] = u[1]*w[2] - u[2]*w[1];
+      nrm[1] = u[2]*w[0] - u[0]*w[2];
+      nrm[2] = u[0]*w[1] - u[1]*w[0];
+      meas = std::sqrt(nrm[0]*nrm[0] + nrm[1]*nrm[1] + nrm[2]*nrm[2])/2.;
+    }
+
+    Real out = 0, len = 0;
+    for (int c = 0; c < m_dim; ++c)
+    {
+      out += nrm[c]*(x0[c] - centroid[c]);
+      len += nrm[c]*nrm[c];
+    }
+    len = std::sqrt(len);
+    for (int c = 0; c < m_dim; ++c)
+      m_normals[f*m_dim + c] = (out < 0 ? -nrm[c] : nrm[c])/len;
+    m_measures[f] = meas;
+
+    Real const scale = meas/facetRefMeasure(ref.facet_type);
+    for (int qp = 0; qp < m_npts; ++qp)
+      m_weights[f*m_npts + qp] = m_facet_rule.weight(qp)*scale;
+
+    // points
+    for (int o = 0; o < m_norients; ++o)
+    {
+      int vts[4];
+      for (int k = 0; k < n; ++k)
+        vts[k] = o == 0 ? V[k] : V[((n - o - k) % n + n) % n]; // anchor a = o-1: V[(n-1-a-k) mod n]
+
+      for (int qp = 0; qp < m_npts; ++qp)
+      {
+        Real phi[4];
+        facetVertexFunctions(ref.facet_type, m_facet_rule.point(qp), phi);
+        Real* X = &m_points[((f*m_norients + o)*m_npts + qp)*m_dim];
+        for (int c = 0; c < m_dim; ++c)
+        {
+          X[c] = 0;
+          for (int k = 0; k < n; ++k)
+            X[c] += phi[k]*ref.vtx[vts[k]][c];
+        }
+      }
+    }
+  }
+}
+
+} // end namespace alelib
@@ -0,0 +1,119 @@
+// This file is part of Alelib, a toolbox for finite element codes.
+//
+// Alelib is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// Alelib is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// Alelib. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALELIB_FACET_QUADRATURE_HPP
+#define ALELIB_FACET_QUADRATURE_HPP
+
+#include "quadrature.hpp"
+
+namespace alelib {
+
+/** @brief Quadrature on the facets of a reference cell, written in the coordinates of the cell.
+ *
+ *  The rule of degree \c degree of the facet type is mapped into every local facet (numbered
+ *  like the facets of the Mesh) in every relative orientation the facet can have:
+ *
+ *  - orientation 0 maps the k-th vertex of the reference facet to the k-th vertex of the local facet;
+ *  - orientation 1+a is the one seen from the neighbour, when the facet is reached with
+ *    <tt>adjCellSideAndAnchor(mesh, side, &adj_side, &a)</tt>: the points of
+ *    <tt>(side, 0)</tt> in the cell and of <tt>(adj_side, 1+a)</tt> in the neighbour are the same
+ *    physical points, in the same order.
+ *
+ *  The points of each (facet, orientation) pair are contiguous, <tt>numPoints()*dim()</tt> Reals,
+ *  so they can be passed directly to ShapeFunction::tabulate.
+ *  Instances are computed once per (cell type, degree, rule) by get() and live until the end of the program.
+ */
+class FacetQuadrature
+{
+public:
+
+  /** @brief the facet quadrature of the reference cell \c ct exact for polynomials of degree \c degree.
+   *  @param rule used when the facets are EDGE or QUADRANGLE. */
+  static FacetQuadrature const& get(ECellType ct, int degree, EQuadrRule rule = GAUSS_LEGENDRE);
+
+  /// orientation of the points seen from the neighbour reached with the anchor \c anchor.
+  static int orientationFromAnchor(int anchor)
+  { return 1 + anchor; }
+
+  /** @brief <tt>points(f,o)[qp*dim() + c]</tt> is the c-th coordinate of the point qp of the facet f
+   *         with orientation o. */
+  Real const* points(int facet, int orient) const
+  { return &m_points[((facet*m_norients + orient)*m_npts)*m_dim]; }
+
+  Real const* point(int facet, int orient, int qp) const
+  { return &m_points[((facet*m_norients + orient)*m_npts + qp)*m_dim]; }
+
+  /** @brief weights of the facet rule scaled by the measure of the facet in the reference cell:
+   *  they add up to that measure. They don't depend on the orientation. */
+  Real weight(int facet, int qp) const
+  { return m_weights[facet*m_npts + qp]; }
+
+  /// outward unit normal of the facet in the reference cell, dim() components.
+  Real const* normal(int facet) const
+  { return &m_normals[facet*m_dim]; }
+
+  /// measure of the facet in the reference cell.
+  Real measure(int facet) const
+  { return m_measures[facet]; }
+
+  /// the rule on the reference facet.
+  Quadrature const& facetRule() const
+  { return m_facet_rule; }
+
+  int numPoints() const
+  { return m_npts; }
+
+  int numFacets() const
+  { return m_nfacets; }
+
+  int numOrientations() const
+  { return m_norients; }
+
+  /// dimension of the cell
+  int dim() const
+  { return m_dim; }
+
+  ECellType cellType() const
+  { return m_cell_type; }
+
+  int degree() const
+  { return m_facet_rule.degree(); }
+
+  FacetQuadrature(ECellType ct, int degree, EQuadrRule rule);
+
+private:
+
+  ECellType  m_cell_type;
+  int        m_dim;
+  int        m_nfacets;
+  int        m_norients;
+  int        m_npts;
+  Quadrature m_facet_rule;
+
+  std::vector<Real> m_points;   // [facet][orientation][qp][dim]
+  std::vector<Real> m_weights;  // [facet][qp]
+  std::vector<Real> m_normals;  // [facet][dim]
+  std::vector<Real> m_measures; // [facet]
+};
+
+} // end namespace alelib
+
+#endif
@@ -3,75 +3,288 @@
 #include <cstdio>
 #include "../util/assert.hpp"
 #include <cmath>
+#include <limits>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <stdint.h>
 
 namespace alelib
 {
 
 
-Quadrature::Quadrature(ECellType ct, int degree)
+namespace
 {
-  setType(ct,degree);
-}
+  // Newton on a root in [-1,1] stops when the step is within a few ulps of the root
+  inline bool newtonConverged(long double dx, long double x)
+  { return std::fabs(dx) <= 4*std::numeric_limits<long double>::epsilon()*std::max(std::fabs(x), 1.L); }
 
-/// 
-/// @param n order.
-/// @param dim hypercube's dimension.
-/// @param[out] points qdrts points.
-/// @param[out] weights qdrts weights.
-/// @param[out] nm_qpoints num of points.
-/// 
-void Quadrature::igetQuadrPtsHypercube(int n, int dim, std::vector<Vec3>& points, std::vector<Real>& weights)
-{
+  // Legendre polynomial P_n and P_{n-1} at x
+  void legendre(int n, long double x, long double& p, long double& pm1)
+  {
+    p   = 1.L;
+    pm1 = 0.L;
+    for (int k = 1; k <= n; ++k)
+    {
+      long double const pm2 = pm1;
+      pm1 = p;
+      p = ((2*k-1)*x*pm1 - (k-1)*pm2)/k;
+    }
+  }
 
-  std::vector<Real> points_1d(n/2 + 1);
-  std::vector<Real> weights_1d(n/2 + 1);
+  void computeGaussLegendre(int n, std::vector<Real>& points, std::vector<Real>& weights)
+  {
+    long double const pi = 3.14159265358979323846264338327950288L;
+    points.resize(n);
+    weights.resize(n);
+    for (int i = 0; i < (n+1)/2; ++i)
+    {
+      // the roots are symmetric; start from the asymptotic guess of the i-th largest one
+      long double x = std::cos(pi*(i + 0.75L)/(n + 0.5L));
+      long double p, pm1, dp;
+      for (int it = 0; it < 100; ++it)
+      {
+        legendre(n, x, p, pm1);
+        dp = n*(x*p - pm1)/(x*x - 1.L);
+        long double const dx = p/dp;
+        x -= dx;
+        if (newtonConverged(dx, x))
+          break;
+      }
+      legendre(n, x, p, pm1);
+      dp = n*(x*p - pm1)/(x*x - 1.L);
+      long double const w = 2.L/((1.L - x*x)*dp*dp);
+      points[i]      = -x;  weights[i]      = w;
+      points[n-1-i]  =  x;  weights[n-1-i]  = w;
+    }
+    if (n % 2 == 1)
+      points[n/2] = 0.;
+  }
 
-  // integra exatamente polinomios de grau (num_pts*2 - 1)
-  if ( (n >= 0) && (n <= 1) )
+  // the interior points are the roots of P'_{n-1}
+  void computeGaussLobatto(int n, std::vector<Real>& points, std::vector<Real>& weights)
   {
-    points_1d[0] = 0.0L; weights_1d[0] = 2.000000000000000000L;
+    long double const pi = 3.14159265358979323846264338327950288L;
+    int const N = n-1;
+    points.resize(n);
+    weights.resize(n);
+    for (int i = 0; i < (n+1)/2; ++i)
+    {
+      long double x = std::cos(pi*i/N); // Chebyshev-Gauss-Lobatto guess
+      long double p, pm1;
+      for (int it = 0; it < 100 && i > 0; ++it)
+      {
+        legendre(N, x, p, pm1);
+        // Newton on (1-x^2) P'_N, written with the recurrence
+        long double const dx = (x*p - pm1)/(n*p);
+        x -= dx;
+        if (newtonConverged(dx, x))
+          break;
+      }
+      legendre(N, x, p, pm1);
+      long double const w = 2.L/(N*n*p*p);
+      points[i]      = -x;  weights[i]      = w;
+      points[n-1-i]  =  x;  weights[n-1-i]  = w;
+    }
+    if (n % 2 == 1)
+      points[n/2] = 0.;
   }
-  else
 
-  if ( (n >= 2) && (n <= 3) )
+  // Jacobi polynomial P_n^(a,b) at x
+  long double jacobi(int n, int a, int b, long double x)
   {
-    points_1d[0] = -5.773502691896258e-1L; weights_1d[0] = 1.000000000000000000L;
-    points_1d[1] = +5.773502691896258e-1L; weights_1d[1] = 1.000000000000000000L;
+    if (n == 0)
+      return 1.L;
+    long double pm1 = 1.L;
+    long double p   = 0.5L*((a+b+2)*x + (a-b));
+    for (int k = 2; k <= n; ++k)
+    {
+      long double const pm2 = pm1;
+      int const c = 2*k + a + b;
+      pm1 = p;
+      p = ((c-1)*((long double)c*(c-2)*x + a*a - b*b)*pm1 - 2.L*(k+a-1)*(k+b-1)*c*pm2)/(2.L*k*(k+a+b)*(c-2));
+    }
+    return p;
   }
-  else
 
-  if ( (n >= 4) && (n <= 5) )
+  // Gauss-Jacobi rule for the weight (1-x)^a, a = 0,1,2,...: the roots of P_n^(a,0) are found in
+  // increasing order by Newton iteration, deflating the ones already found
+  void computeGaussJacobi(int n, int a, std::vector<Real>& points, std::vector<Real>& weights)
   {
-    points_1d[0] = 0.000000000000000000L; weights_1d[0] = 8.888888888888889e-1L;
-    points_1d[1] = +7.745966692414834e-1; weights_1d[1] = 5.555555555555556e-1L;
-    points_1d[2] = -7.745966692414834e-1; weights_1d[2] = 5.555555555555556e-1L;
+    long double const pi = 3.14159265358979323846264338327950288L;
+    std::vector<long double> x(n);
+    for (int k = 0; k < n; ++k)
+    {
+      long double r = -std::cos((2*k+1)*pi/(2*n));
+      if (k > 0)
+        r = 0.5L*(r + x[k-1]);
+      for (int it = 0; it < 100; ++it)
+      {
+        long double s = 0.L;
+        for (int i = 0; i < k; ++i)
+          s += 1.L/(r - x[i]);
+        long double const p  = jacobi(n, a, 0, r);
+        long double const dp = 0.5L*(n + a + 1)*jacobi(n-1, a+1, 1, r);
+        long double const delta = -p/(dp - s*p);
+        r += delta;
+        if (newtonConverged(delta, r))
+          break;
+      }
+      x[k] = r;
+    }
+
+    points.resize(n);
+    weights.resize(n);
+    for (int k = 0; k < n; ++k)
+    {
+      long double const dp = 0.5L*(n + a + 1)*jacobi(n-1, a+1, 1, x[k]);
+      points[k]  = x[k];
+      weights[k] = std::pow(2.L, a+1)/((1.L - x[k]*x[k])*dp*dp);
+    }
   }
-  else
 
-  if ( (n >= 6) && (n <= 7) )
+  // owns the collapsed simplex rules computed so far
+  struct CollapsedStore
   {
-    points_1d[0] = +3.399810435848563e-1L; weights_1d[0] = 6.521451548625462e-1L;
-    points_1d[1] = -3.399810435848563e-1L; weights_1d[1] = 6.521451548625462e-1L;
-    points_1d[2] = +8.611363115940526e-1L; weights_1d[2] = 3.478548451374539e-1L;
-    points_1d[3] = -8.611363115940526e-1L; weights_1d[3] = 3.478548451374539e-1L;
+    typedef std::map<std::pair<int,int>, std::pair<std::vector<Quadrature::Vec3>, std::vector<Real> > > MapT;
+    MapT       table;
+    std::mutex lock;
+  };
+
+  CollapsedStore& collapsedStore()
+  {
+    static CollapsedStore store;
+    return store;
   }
-  else
 
-  if ( (n >= 8) && (n <= 9) )
+  // owns the 1d rules computed so far
+  struct RuleStore
   {
-    points_1d[0] = +0.000000000000000000L; weights_1d[0] = 5.688888888888889e-1L;
-    points_1d[1] = +5.384693101056831e-1L; weights_1d[1] = 4.786286704993665e-1L;
-    points_1d[2] = -5.384693101056831e-1L; weights_1d[2] = 4.786286704993665e-1L;
-    points_1d[3] = +9.06179845938664e-1L;  weights_1d[3] = 2.369268850561891e-1L;
-    points_1d[4] = -9.06179845938664e-1L;  weights_1d[4] = 2.369268850561891e-1L;
+    typedef std::map<std::pair<int,int>, std::pair<std::vector<Real>, std::vector<Real> > > MapT;
+    MapT       table;
+    std::mutex lock;
+  };
+
+  RuleStore& ruleStore()
+  {
+    static RuleStore store;
+    return store;
   }
-  else
+}
+
+
+Quadrature::Quadrature(ECellType ct, int degree, EQuadrRule rule)
+{
+  setType(ct,degree,rule);
+}
+
+Quadrature::Quadrature(Quadrature const& q)
+  : m_cell_type(q.m_cell_type), m_degree(q.m_degree), m_rule(q.m_rule),
+    m_qpoints(q.m_qpoints), m_weights(q.m_weights)
+{
+  buildSoA();
+}
+
+Quadrature& Quadrature::operator=(Quadrature const& q)
+{
+  if (this != &q)
   {
-    ALELIB_CHECK(false, "invalid or not supported quadrature order", std::invalid_argument);
+    m_cell_type = q.m_cell_type;
+    m_degree    = q.m_degree;
+    m_rule      = q.m_rule;
+    m_qpoints   = q.m_qpoints;
+    m_weights   = q.m_weights;
+    buildSoA();
   }
+  return *this;
+}
+
+// the SoA arrays are rebuilt rather than copied: the alignment of the storage differs between copies
+void Quadrature::buildSoA()
+{
+  int const width = ALELIB_QUADRATURE_ALIGN/sizeof(Real);
+  int const npts  = m_qpoints.size();
+  int const dim   = m_cell_type == POINT ? 0 :
+                    m_cell_type == EDGE  ? 1 :
+                   (m_cell_type == TRIANGLE || m_cell_type == QUADRANGLE) ? 2 : 3;
 
-  points.resize (pow(points_1d.size(),dim));
-  weights.resize(pow(points_1d.size(),dim));
+  m_npts_padded = (npts + width - 1)/width*width;
+  m_soa_storage.assign(4*m_npts_padded + width, 0.);
+
+  Real* base = m_soa_storage.empty() ? NULL : &m_soa_storage[0];
+  uintptr_t const mis = reinterpret_cast<uintptr_t>(base) % ALELIB_QUADRATURE_ALIGN;
+  if (mis)
+    base += (ALELIB_QUADRATURE_ALIGN - mis)/sizeof(Real);
+
+  for (int c = 0; c < 4; ++c)
+  {
+    Real* a = base + c*m_npts_padded;
+    for (int qp = 0; qp < m_npts_padded; ++qp)
+    {
+      int const q = qp < npts ? qp : 0;
+      if (c == 3)
+        a[qp] = qp < npts ? m_weights[q] : 0.;
+      else
+        a[qp] = c < dim ? m_qpoints[q][c] : 0.;
+    }
+    m_soa_ptr[c] = a;
+  }
+}
+
+void Quadrature::gaussRule1d(int npts, std::vector<Real>& points, std::vector<Real>& weights, EQuadrRule rule)
+{
+  ALELIB_CHECK(npts >= (rule == GAUSS_LOBATTO ? 2 : 1), "invalid number of quadrature points", std::invalid_argument);
+
+  RuleStore& store = ruleStore();
+  std::lock_guard<std::mutex> guard(store.lock);
+
+  std::pair<int,int> const key(rule, npts);
+  RuleStore::MapT::iterator it = store.table.find(key);
+  if (it == store.table.end())
+  {
+    it = store.table.insert(std::make_pair(key, RuleStore::MapT::mapped_type())).first;
+    if (rule == GAUSS_LOBATTO)
+      computeGaussLobatto(npts, it->second.first, it->second.second);
+    else
+      computeGaussLegendre(npts, it->second.first, it->second.second);
+  }
+
+  points  = it->second.first;
+  weights = it->second.second;
+}
+
+void Quadrature::gaussJacobiRule1d(int npts, int alpha, std::vector<Real>& points, std::vector<Real>& weights)
+{
+  ALELIB_CHECK(npts >= 1 && alpha >= 0, "invalid Gauss-Jacobi rule", std::invalid_argument);
+  computeGaussJacobi(npts, alpha, points, weights);
+}
+
+/// 
+/// @param n order.
+/// @param dim hypercube's dimension.
+/// @param[out] points qdrts points.
+/// @param[out] weights qdrts weights.
+/// @param rule the 1d rule.
+/// 
+void Quadrature::igetQuadrPtsHypercube(int n, int dim, std::vector<Vec3>& points, std::vector<Real>& weights, EQuadrRule rule)
+{
+  ALELIB_CHECK(n >= 0, "invalid or not supported quadrature order", std::invalid_argument);
+
+  std::vector<Real> points_1d;
+  std::vector<Real> weights_1d;
+
+  // Gauss-Legendre: num_pts*2 - 1 >= n; Gauss-Lobatto: num_pts*2 - 3 >= n
+  if (rule == GAUSS_LOBATTO)
+    gaussRule1d(n/2 + 2, points_1d, weights_1d, GAUSS_LOBATTO);
+  else
+    gaussRule1d(n/2 + 1, points_1d, weights_1d, GAUSS_LEGENDRE);
+
+  int npts = 1;
+  for (int c = 0; c < dim; ++c)
+    npts *= points_1d.size();
+
+  points.resize (npts);
+  weights.resize(npts);
 
   int I[3] = {0,0,0}; // max dim = 3
 
@@ -100,9 +313,71 @@ void Quadrature::igetQuadrPtsHypercube(int n, int dim, std::vector<Vec3>& points
 }
 
 
-void Quadrature::setType(ECellType ct, int degree)
+/// Collapsed-coordinate (Duffy) rule for the reference triangle or tetrahedron: the cube
+/// [-1,1]^dim is mapped onto the simplex by
+///
+///   x = (1+a)(1-b)(1-c)/8,  y = (1+b)(1-c)/4,  z = (1+c)/2       (in 2d, c = -1),
+///
+/// and the factors (1-b), (1-c)^2 of its Jacobian are absorbed by Gauss-Jacobi rules in b and c.
+/// It has (n/2+1)^dim points, so it is only used above the symmetric tables.
+/// 
+/// @param n order.
+/// @param dim simplex's dimension, 2 or 3.
+/// @param[out] points qdrts points.
+/// @param[out] weights qdrts weights, summing to 1 (like the tables, before the scaling by the measure).
+/// 
+void Quadrature::igetQuadrPtsCollapsed(int n, int dim, std::vector<Vec3>& points, std::vector<Real>& weights)
+{
+  ALELIB_CHECK(n >= 0, "invalid or not supported quadrature order", std::invalid_argument);
+  ALELIB_CHECK(dim == 2 || dim == 3, "invalid dimension", std::invalid_argument);
+
+  CollapsedStore& store = collapsedStore();
+  std::lock_guard<std::mutex> guard(store.lock);
+
+  std::pair<int,int> const key(dim, n);
+  CollapsedStore::MapT::iterator it = store.table.find(key);
+  if (it == store.table.end())
+  {
+    int const q = n/2 + 1; // 2q-1 >= n in each direction
+    std::vector<Real> xa, wa, xb, wb, xc, wc;
+    computeGaussJacobi(q, 0, xa, wa);
+    computeGaussJacobi(q, 1, xb, wb);
+    computeGaussJacobi(q, 2, xc, wc);
+    if (dim == 2)
+    {
+      xc.assign(1, -1.);
+      wc.assign(1, 1.);
+    }
+
+    it = store.table.insert(std::make_pair(key, CollapsedStore::MapT::mapped_type())).first;
+    std::vector<Vec3>& pts = it->second.first;
+    std::vector<Real>& wts = it->second.second;
+    Real const norm = dim == 2 ? 1./4. : 3./32.; // 1/(2^(2+dim) measure)
+
+    for (int k = 0; k < (int)xc.size(); ++k)
+      for (int j = 0; j < q; ++j)
+        for (int i = 0; i < q; ++i)
+        {
+          Vec3 X;
+          Real const c = xc[k];
+          X[0] = 0.125*(1.+xa[i])*(1.-xb[j])*(1.-c);
+          X[1] = 0.25*(1.+xb[j])*(1.-c);
+          X[2] = 0.5*(1.+c);
+          pts.push_back(X);
+          wts.push_back(wa[i]*wb[j]*wc[k]*norm);
+        }
+  }
+
+  points  = it->second.first;
+  weights = it->second.second;
+}
+
+
+void Quadrature::setType(ECellType ct, int degree, EQuadrRule rule)
 {
+  this->m_cell_type = ct;
   this->m_degree = degree;
+  this->m_rule = rule;
 
   switch (ct)
   {
@@ -116,15 +391,15 @@ void Quadrature::setType(ECellType ct, int degree)
     break;
 
     case EDGE:
-      igetQuadrPtsHypercube(degree, 1, m_qpoints, m_weights);
+      igetQuadrPtsHypercube(degree, 1, m_qpoints, m_weights, rule);
     break;
 
     case QUADRANGLE:
-      igetQuadrPtsHypercube(degree, 2, m_qpoints, m_weights);
+      igetQuadrPtsHypercube(degree, 2, m_qpoints, m_weights, rule);
     break;
 
     case HEXAHEDRON:
-      igetQuadrPtsHypercube(degree, 3, m_qpoints, m_weights);
+      igetQuadrPtsHypercube(degree, 3, m_qpoints, m_weights, rule);
     break;
 
     case TRIANGLE:
@@ -298,8 +573,10 @@ void Quadrature::setType(ECellType ct, int degree)
       }
       else
       {
-        ALELIB_CHECK(false, "invalid or not supported quadrature order", std::invalid_argument);
+        igetQuadrPtsCollapsed(n, 2, m_qpoints, m_weights);
       }
+      // a symmetric rule with less points, if there is one
+      igetQuadrPtsSymmetric(n, 2, m_qpoints, m_weights);
       for (int i = 0; i < (int)m_weights.size(); ++i)
         m_weights[i] /= 2.0L;      
     }
@@ -484,8 +761,10 @@ void Quadrature::setType(ECellType ct, int degree)
       }
       else
       {
-        ALELIB_CHECK(false, "invalid or not supported quadrature order", std::invalid_argument);
+        igetQuadrPtsCollapsed(n, 3, m_qpoints, m_weights);
       }
+      // a symmetric rule with less points, if there is one
+      igetQuadrPtsSymmetric(n, 3, m_qpoints, m_weights);
       for (int i = 0; i < (int)m_weights.size(); ++i)
         m_weights[i] /= 6.0L;      
     }
@@ -496,10 +775,7 @@ void Quadrature::setType(ECellType ct, int degree)
       throw;
   }
 
-
-
-
-
+  buildSoA();
 }
 
 
@@ -26,8 +26,19 @@
 #include "../mesh/enums.hpp"
 #include <vector>
 
+// alignment in bytes of the SoA arrays of Quadrature; the number of padded points is a multiple of
+// ALELIB_QUADRATURE_ALIGN/sizeof(Real), the widest vector of Reals
+#define ALELIB_QUADRATURE_ALIGN 64
+
 namespace alelib {
 
+/// family of the 1d rule used by the tensor-product (EDGE, QUADRANGLE, HEXAHEDRON) quadratures
+enum EQuadrRule
+{
+  GAUSS_LEGENDRE = 0, // n points, exact up to degree 2n-1
+  GAUSS_LOBATTO  = 1  // n points including the end points, exact up to degree 2n-3
+};
+
 class Quadrature
 {
 public:
@@ -40,13 +51,37 @@ public:
     operator Real const* () const {return z;}
   }; 
 
-  static void igetQuadrPtsHypercube(int n, int dim, std::vector<Vec3>& points, std::vector<Real>& weights);
+  static void igetQuadrPtsHypercube(int n, int dim, std::vector<Vec3>& points, std::vector<Real>& weights,
+                                    EQuadrRule rule = GAUSS_LEGENDRE);
+
+  static void igetQuadrPtsCollapsed(int n, int dim, std::vector<Vec3>& points, std::vector<Real>& weights);
+
+  static bool igetQuadrPtsSymmetric(int n, int dim, std::vector<Vec3>& points, std::vector<Real>& weights);
+
+  /** @brief Points (increasing) and weights of the 1d rule with \c npts points in [-1,1].
+   *  They are computed by Newton iteration the first time they are requested and cached
+   *  for the rest of the program, so any number of points is available. */
+  static void gaussRule1d(int npts, std::vector<Real>& points, std::vector<Real>& weights,
+                          EQuadrRule rule = GAUSS_LEGENDRE);
+
+  /** @brief Points (increasing) and weights of the Gauss-Jacobi rule with \c npts points for the weight
+   *  \f$ (1-x)^\alpha \f$ in [-1,1], the 1d factors of the collapsed simplex rules (igetQuadrPtsCollapsed). */
+  static void gaussJacobiRule1d(int npts, int alpha, std::vector<Real>& points, std::vector<Real>& weights);
   
-  Quadrature() {};
+  Quadrature() : m_cell_type(UNDEFINED_CELLT), m_degree(-1), m_rule(GAUSS_LEGENDRE), m_npts_padded(0)
+  { m_soa_ptr[0] = m_soa_ptr[1] = m_soa_ptr[2] = m_soa_ptr[3] = NULL; };
+
+  Quadrature(ECellType ct, int degree, EQuadrRule rule = GAUSS_LEGENDRE);
 
-  Quadrature(ECellType ct, int degree);
+  Quadrature(Quadrature const&);
 
-  void setType(ECellType ct, int degree);
+  Quadrature& operator=(Quadrature const&);
+
+  /** @brief Sets the rule that integrates exactly polynomials of degree \c degree on the reference cell.
+   *  @param rule only used by EDGE, QUADRANGLE and HEXAHEDRON.
+   *  Any degree is supported: TRIANGLE and TETRAHEDRON use the fully symmetric rule with the fewest
+   *  points among the ones available, and collapsed-coordinate (Gauss-Jacobi) rules above them. */
+  void setType(ECellType ct, int degree, EQuadrRule rule = GAUSS_LEGENDRE);
   
 
   Real const* point(int qp) const
@@ -61,11 +96,49 @@ public:
   int degree() const
   { return m_degree; }
 
+  ECellType cellType() const
+  { return m_cell_type; }
+
+  EQuadrRule rule() const
+  { return m_rule; }
+
+  /** @name SoA view
+   *  The points and weights are also stored as separate arrays aligned to ALELIB_QUADRATURE_ALIGN bytes,
+   *  with numPointsPadded() entries each. The padding points repeat the first point and have zero weight,
+   *  so vector kernels can run over whole vectors and sum the padded lanes without masking.
+   *  Coordinates beyond the dimension of the cell are zero.
+   */
+  ///@{
+
+  int numPointsPadded() const
+  { return m_npts_padded; }
+
+  /// <tt>pointsSoA()[c][qp]</tt> is the coordinate c of the point qp, c < 3; it can be passed to ShapeFunction::tabulateSoA.
+  Real const* const* pointsSoA() const
+  { return m_soa_ptr; }
+
+  Real const* pointsSoA(int c) const
+  { return m_soa_ptr[c]; }
+
+  Real const* weightsSoA() const
+  { return m_soa_ptr[3]; }
+
+  ///@}
+
 protected:
+
+  void buildSoA();
+
+  ECellType m_cell_type;
   int m_degree;
+  EQuadrRule m_rule;
   
   std::vector<Vec3> m_qpoints;
   std::vector<Real> m_weights;
+
+  int m_npts_padded;
+  std::vector<Real> m_soa_storage; // x, y, z and weights, with room for the alignment
+  Real const* m_soa_ptr[4];        // aligned arrays inside m_soa_storage
 };
 
 } // end namespace alelib
@@ -0,0 +1,299 @@
+#include "quadrature.hpp"
+#include "../util/assert.hpp"
+#include <algorithm>
+
+// Fully symmetric quadrature rules on the reference triangle and tetrahedron, with positive
+// weights and all points inside the cell. They are stored by orbits: each orbit is a
+// generator in barycentric coordinates, and its points are all the distinct permutations
+// of the generator. The rules were computed by solving the moment equations of the orthogonal
+// (Dubiner) basis for the orbit structures of Witherden and Vincent (2015), and each one has
+// been checked to integrate exactly all the monomials up to its degree.
+//
+// Only the rules with fewer points than the tables of quadrature.cpp (and than the
+// collapsed-coordinate rules) are kept here.
+
+namespace alelib
+{
+
+namespace
+{
+  // orbit types; the value is the number of points of the orbit
+  enum
+  {
+    S3 = 1, S21 = 3, S111 = 6,                   // triangle: (1/3,1/3,1/3), (a,a,b), (a,b,c)
+    S4 = 1, S31 = 4, S22 = 6, S211 = 12, S1111 = 24 // tetrahedron: (1/4,...), (a,a,a,b), (a,a,b,b), (a,a,b,c), (a,b,c,d)
+  };
+
+  struct SymOrbit
+  {
+    int         type;
+    long double weight; // weight of each point, normalized so that the weights of a rule sum to 1
+    long double gen[4]; // barycentric coordinates, dim+1 of them
+  };
+
+  struct SymRule
+  {
+    int             dim;
+    int             degree;
+    int             npts;
+    SymOrbit const* orbits;
+    int             norbits;
+  };
+
+  // degree 4, 6 points
+  SymOrbit const tri_4[] = {
+    {S21,  0.223381589678011466L, {0.108103018168070227L, 0.445948490915964886L, 0.445948490915964886L}},
+    {S21,  0.109951743655321868L, {0.091576213509770743L, 0.091576213509770743L, 0.816847572980458513L}},
+  };
+
+  // degree 11, 28 points
+  SymOrbit const tri_11[] = {
+    {S3,   0.086896428305291452L, {0.333333333333333333L, 0.333333333333333333L, 0.333333333333333333L}},
+    {S21,  0.017744679496325379L, {0.009527709576562459L, 0.495236145211718771L, 0.495236145211718771L}},
+    {S21,  0.071333891891841856L, {0.208806728092223002L, 0.208806728092223002L, 0.582386543815553996L}},
+    {S21,  0.068362235584313764L, {0.122537166273276175L, 0.438731416863361913L, 0.438731416863361913L}},
+    {S21,  0.038310380264937752L, {0.098681179681867744L, 0.098681179681867744L, 0.802637640636264512L}},
+    {S21,  0.009663157609785854L, {0.027391800581152126L, 0.027391800581152126L, 0.945216398837695748L}},
+    {S111, 0.008848979098430741L, {0.004089294218079821L, 0.145473981143464805L, 0.850436724638455374L}},
+    {S111, 0.040627777093751715L, {0.045443453078701431L, 0.283367852148374261L, 0.671188694772924307L}},
+  };
+
+  // degree 12, 33 points
+  SymOrbit const tri_12[] = {
+    {S21,  0.034796112930708943L, {0.127576145541585925L, 0.127576145541585925L, 0.744847708916828151L}},
+    {S21,  0.062858224217885100L, {0.271210385012115922L, 0.271210385012115922L, 0.457579229975768155L}},
+    {S21,  0.025731066440455335L, {0.023565220452390235L, 0.488217389773804883L, 0.488217389773804883L}},
+    {S21,  0.006166261051559017L, {0.021317350453210370L, 0.021317350453210370L, 0.957365299093579260L}},
+    {S21,  0.043692544538038402L, {0.120551215411079454L, 0.439724392294460273L, 0.439724392294460273L}},
+    {S111, 0.022356773202303446L, {0.022838332222257030L, 0.281325580989939548L, 0.695836086787803422L}},
+    {S111, 0.040371557766380930L, {0.115343494534697999L, 0.275713269685514194L, 0.608943235779787807L}},
+    {S111, 0.017316231108658892L, {0.025734050548330228L, 0.116251915907597141L, 0.858014033544072631L}},
+  };
+
+  // degree 13, 37 points
+  SymOrbit const tri_13[] = {
+    {S3,   0.052656327104857286L, {0.333333333333333333L, 0.333333333333333333L, 0.333333333333333333L}},
+    {S21,  0.011284374939407642L, {0.009926614729583106L, 0.495036692635208447L, 0.495036692635208447L}},
+    {S21,  0.047122014406752541L, {0.170776476674653500L, 0.414611761662673250L, 0.414611761662673250L}},
+    {S21,  0.031184764739624747L, {0.114484223607489079L, 0.114484223607489079L, 0.771031552785021842L}},
+    {S21,  0.031337039123631100L, {0.062460625200322016L, 0.468769687399838992L, 0.468769687399838992L}},
+    {S21,  0.047456271867526545L, {0.229310796819582935L, 0.229310796819582935L, 0.541378406360834129L}},
+    {S21,  0.007971861428963569L, {0.024805141646376026L, 0.024805141646376026L, 0.950389716707247948L}},
+    {S111, 0.036829605382702467L, {0.094664020904161983L, 0.268928246959323165L, 0.636407732136514852L}},
+    {S111, 0.017351934553267629L, {0.018039090081063556L, 0.291704836820400356L, 0.690256073098536088L}},
+    {S111, 0.015530908960267284L, {0.022251790688235462L, 0.126326415025979304L, 0.851421794285785235L}},
+  };
+
+  // degree 14, 42 points
+  SymOrbit const tri_14[] = {
+    {S21,  0.032788353544125351L, {0.164710561319092155L, 0.417644719340453922L, 0.417644719340453922L}},
+    {S21,  0.021883581369428891L, {0.022072179275642723L, 0.488963910362178639L, 0.488963910362178639L}},
+    {S21,  0.014433699669776668L, {0.061799883090872601L, 0.061799883090872601L, 0.876400233818254797L}},
+    {S21,  0.051774104507291586L, {0.273477528308838660L, 0.273477528308838660L, 0.453044943382322680L}},
+    {S21,  0.004923403602400082L, {0.019390961248701048L, 0.019390961248701048L, 0.961218077502597904L}},
+    {S21,  0.042162588736993018L, {0.177205532412543437L, 0.177205532412543437L, 0.645588935174913126L}},
+    {S111, 0.038571510787060683L, {0.092916249356971825L, 0.336861459796345002L, 0.570222290846683173L}},
+    {S111, 0.024665753212563674L, {0.057124757403647939L, 0.172266687821355578L, 0.770608554774996483L}},
+    {S111, 0.005010228838500672L, {0.001268330932872025L, 0.118974497696956845L, 0.879757171370171130L}},
+    {S111, 0.014436308113533840L, {0.014646950055654410L, 0.298372882136257753L, 0.686980167808087837L}},
+  };
+
+  // degree 15, 49 points
+  SymOrbit const tri_15[] = {
+    {S3,   0.047942076993036771L, {0.333333333333333333L, 0.333333333333333333L, 0.333333333333333333L}},
+    {S21,  0.018903775213789076L, {0.083044274425153967L, 0.083044274425153967L, 0.833911451149692065L}},
+    {S21,  0.004434213276475823L, {0.018627711004051980L, 0.018627711004051980L, 0.962744577991896039L}},
+    {S21,  0.012979340434054872L, {0.015321572868601147L, 0.492339213565699426L, 0.492339213565699426L}},
+    {S21,  0.033561745879884320L, {0.215608885829879893L, 0.215608885829879893L, 0.568782228340240215L}},
+    {S111, 0.011697354405305612L, {0.015509949445914893L, 0.332715114987842440L, 0.651774935566242666L}},
+    {S111, 0.029760380972924903L, {0.095432113719180652L, 0.206723098738451821L, 0.697844787542367527L}},
+    {S111, 0.007348728757128081L, {0.014650312758291987L, 0.092068865683641186L, 0.893280821558066827L}},
+    {S111, 0.030877118960984768L, {0.079234289245284803L, 0.370669168918287662L, 0.550096541836427535L}},
+    {S111, 0.031998374302738751L, {0.186720291135292108L, 0.344212999914539497L, 0.469066708950168395L}},
+    {S111, 0.012054825699976379L, {0.019895262758700787L, 0.200517949167649339L, 0.779586788073649873L}},
+  };
+
+  // degree 16, 55 points
+  SymOrbit const tri_16[] = {
+    {S3,   0.045036373230276210L, {0.333333333333333333L, 0.333333333333333333L, 0.333333333333333333L}},
+    {S21,  0.011643571873010174L, {0.032925201607375489L, 0.483537399196312256L, 0.483537399196312256L}},
+    {S21,  0.032119803685807887L, {0.180349167710010232L, 0.180349167710010232L, 0.639301664579979536L}},
+    {S21,  0.026687709972020102L, {0.090547240641741629L, 0.454726379679129186L, 0.454726379679129186L}},
+    {S21,  0.005259203299842580L, {0.007100873986708553L, 0.496449563006645723L, 0.496449563006645723L}},
+    {S21,  0.003351909664218951L, {0.015943019030472228L, 0.015943019030472228L, 0.968113961939055544L}},
+    {S21,  0.011426400401268347L, {0.067438331076150818L, 0.067438331076150818L, 0.865123337847698364L}},
+    {S111, 0.006208336193599230L, {0.012868792183828764L, 0.084542739684085474L, 0.902588468132085762L}},
+    {S111, 0.009668064909646464L, {0.014527514603772504L, 0.197871800714647064L, 0.787600684681580433L}},
+    {S111, 0.019455260552913101L, {0.073536275612025529L, 0.163929543188971519L, 0.762534181199002953L}},
+    {S111, 0.026977969000212063L, {0.080936679634333830L, 0.299279704159806410L, 0.619783616205859760L}},
+    {S111, 0.039478339447688049L, {0.192649573624934340L, 0.322874267157403160L, 0.484476159217662500L}},
+    {S111, 0.012128334909477704L, {0.015899636560186824L, 0.338763149868144884L, 0.645337213571668292L}},
+  };
+
+  // degree 17, 60 points
+  SymOrbit const tri_17[] = {
+    {S21,  0.003464415675543083L, {0.016334435918241322L, 0.016334435918241322L, 0.967331128163517356L}},
+    {S21,  0.028394566408062034L, {0.167044096464942951L, 0.416477951767528525L, 0.416477951767528525L}},
+    {S21,  0.011480206494049949L, {0.014452543347590832L, 0.492773728326204584L, 0.492773728326204584L}},
+    {S21,  0.023566281822092483L, {0.177859327985359087L, 0.177859327985359087L, 0.644281344029281827L}},
+    {S21,  0.024494392370479906L, {0.071723916336329411L, 0.464138041831835294L, 0.464138041831835294L}},
+    {S21,  0.037546261961775272L, {0.285690555430558769L, 0.285690555430558769L, 0.428618889138882462L}},
+    {S111, 0.009355315639169462L, {0.011888524470945623L, 0.338843686055806498L, 0.649267789473247878L}},
+    {S111, 0.027241341983802668L, {0.157337743983986517L, 0.292896380113056304L, 0.549765875902957179L}},
+    {S111, 0.007424670814634260L, {0.055150372947177965L, 0.083330614884897566L, 0.861519012167924469L}},
+    {S111, 0.010067847913992474L, {0.015201330712072612L, 0.195250198149905631L, 0.789548471138021757L}},
+    {S111, 0.020379723348345147L, {0.079119082652181104L, 0.171543654505411395L, 0.749337262842407501L}},
+    {S111, 0.022268562842721685L, {0.064762211710701884L, 0.311048523070039529L, 0.624189265219258587L}},
+    {S111, 0.005456141757999607L, {0.011639634723216770L, 0.083535678586386074L, 0.904824686690397156L}},
+  };
+
+  // degree 18, 67 points
+  SymOrbit const tri_18[] = {
+    {S3,   0.036355735301426666L, {0.333333333333333333L, 0.333333333333333333L, 0.333333333333333333L}},
+    {S21,  0.012046647633999710L, {0.024839396850260875L, 0.487580301574869562L, 0.487580301574869562L}},
+    {S21,  0.016559159952003249L, {0.091947742121643197L, 0.091947742121643197L, 0.816104515756713607L}},
+    {S21,  0.007129326019718971L, {0.038830256088685595L, 0.038830256088685595L, 0.922339487822628811L}},
+    {S21,  0.018949171506778866L, {0.076380987187101537L, 0.461809506406449231L, 0.461809506406449231L}},
+    {S21,  0.033304470033390135L, {0.200088743864847537L, 0.399955628067576232L, 0.399955628067576232L}},
+    {S21,  0.036475089408943637L, {0.242264702514271962L, 0.242264702514271962L, 0.515470594971456076L}},
+    {S111, 0.004530534502257065L, {0.003897611033473383L, 0.395683434332269703L, 0.600418954634256915L}},
+    {S111, 0.005010660874579722L, {0.005298335186609765L, 0.235772184958191741L, 0.758929479855198494L}},
+    {S111, 0.001222948126961090L, {0.000548360042042319L, 0.027090910995162014L, 0.972360728962795667L}},
+    {S111, 0.023781910900152830L, {0.122696757371927553L, 0.206349257433837933L, 0.670953985194234513L}},
+    {S111, 0.025482175311824439L, {0.120587695163924643L, 0.333493529449880757L, 0.545918775386194600L}},
+    {S111, 0.013759616234942205L, {0.045804915859860781L, 0.183822707925464006L, 0.770372376214675213L}},
+    {S111, 0.006840110119607181L, {0.013462016741444989L, 0.108195793791033293L, 0.878342189467521718L}},
+    {S111, 0.017747489102020405L, {0.040260283469908063L, 0.319751624525377342L, 0.639988092004714595L}},
+  };
+
+  // degree 19, 73 points
+  SymOrbit const tri_19[] = {
+    {S3,   0.029506440202056752L, {0.333333333333333333L, 0.333333333333333333L, 0.333333333333333333L}},
+    {S21,  0.021970064925616094L, {0.148921942043044595L, 0.148921942043044595L, 0.702156115913910810L}},
+    {S21,  0.005607610122239982L, {0.006941622961939705L, 0.496529188519030148L, 0.496529188519030148L}},
+    {S21,  0.006748228039155509L, {0.037808354995850906L, 0.037808354995850906L, 0.924383290008298188L}},
+    {S21,  0.028015936711361395L, {0.264451342294214265L, 0.264451342294214265L, 0.471097315411571470L}},
+    {S21,  0.030417955865156818L, {0.191816427661887575L, 0.404091786169056213L, 0.404091786169056213L}},
+    {S21,  0.012508353813424659L, {0.038275347001820956L, 0.480862326499089522L, 0.480862326499089522L}},
+    {S111, 0.008143781407526570L, {0.012894083019124854L, 0.208418767467377847L, 0.778687149513497299L}},
+    {S111, 0.004903647710389029L, {0.010227053246902019L, 0.099511204894763094L, 0.890261741858334887L}},
+    {S111, 0.001098377834866747L, {0.001108596755239829L, 0.024887118381076286L, 0.974004284863683885L}},
+    {S111, 0.012143253147919491L, {0.047917322812033201L, 0.346035891274141676L, 0.606046785913825123L}},
+    {S111, 0.017436761626907913L, {0.067080733568070925L, 0.231232962122877194L, 0.701686304309051881L}},
+    {S111, 0.025861331635514911L, {0.154264111877703206L, 0.267354612415123066L, 0.578381275707173728L}},
+    {S111, 0.018988832046469596L, {0.100958728315770561L, 0.384206460867434377L, 0.514834810816795063L}},
+    {S111, 0.007354846734811190L, {0.009983453517948220L, 0.343680448506608697L, 0.646336097975443083L}},
+    {S111, 0.013184019750107866L, {0.058577797339342418L, 0.120411168713230921L, 0.821011033947426661L}},
+  };
+
+  // degree 20, 79 points
+  SymOrbit const tri_20[] = {
+    {S3,   0.003999378899757368L, {0.333333333333333333L, 0.333333333333333333L, 0.333333333333333333L}},
+    {S21,  0.030968127829858796L, {0.248227055679714333L, 0.375886472160142833L, 0.375886472160142833L}},
+    {S21,  0.001328634727686760L, {0.009882834612180471L, 0.009882834612180471L, 0.980234330775639057L}},
+    {S21,  0.007034206938151184L, {0.017942534233695454L, 0.491028732883152273L, 0.491028732883152273L}},
+    {S21,  0.015494646021846832L, {0.171073052945030959L, 0.171073052945030959L, 0.657853894109938083L}},
+    {S21,  0.015501463166082704L, {0.112819298166309530L, 0.112819298166309530L, 0.774361403667380939L}},
+    {S21,  0.018327756024287447L, {0.066976270982344785L, 0.466511864508827607L, 0.466511864508827607L}},
+    {S21,  0.003804919632636888L, {0.033214661470459202L, 0.033214661470459202L, 0.933570677059081596L}},
+    {S21,  0.030244990858376944L, {0.243944474970649780L, 0.243944474970649780L, 0.512111050058700439L}},
+    {S111, 0.005034252746569524L, {0.009281943619584461L, 0.155641083776496520L, 0.835076972603919019L}},
+    {S111, 0.007240268159386619L, {0.011460512525311971L, 0.270605383087139479L, 0.717934104387548551L}},
+    {S111, 0.008543009794492732L, {0.040294623544508121L, 0.095798890536090947L, 0.863906485919400932L}},
+    {S111, 0.005612432903237225L, {0.008233865139941625L, 0.401003209285949910L, 0.590762925574108466L}},
+    {S111, 0.025827266552948193L, {0.142965060318857288L, 0.357398254334952481L, 0.499636685346190231L}},
+    {S111, 0.018579346881071933L, {0.119480048572880571L, 0.248884025352033364L, 0.631635926075086066L}},
+    {S111, 0.016941597931421779L, {0.052393822824160577L, 0.337764363055256535L, 0.609841814120582888L}},
+    {S111, 0.014660964863620186L, {0.055113038273260939L, 0.197791820189216506L, 0.747095141537522555L}},
+    {S111, 0.002208591084495137L, {0.004745868751311744L, 0.063361304259387682L, 0.931892826989300574L}},
+  };
+
+  // degree 7, 35 points
+  SymOrbit const tet_7[] = {
+    {S4,   0.095485289464130849L, {0.250000000000000000L, 0.250000000000000000L, 0.250000000000000000L, 0.250000000000000000L}},
+    {S31,  0.042329581209967029L, {0.052896550665391602L, 0.315701149778202799L, 0.315701149778202799L, 0.315701149778202799L}},
+    {S22,  0.031896927832857580L, {0.050489822598396369L, 0.050489822598396369L, 0.449510177401603631L, 0.449510177401603631L}},
+    {S211, 0.008110770829903342L, {0.021265472541483246L, 0.021265472541483246L, 0.146638813818484947L, 0.810830241098548561L}},
+    {S211, 0.037207130728334621L, {0.047160700360997881L, 0.188833831026001048L, 0.188833831026001048L, 0.575171637587000023L}},
+  };
+
+  // degree 9, 59 points
+  SymOrbit const tet_9[] = {
+    {S4,   0.056377008659722434L, {0.250000000000000000L, 0.250000000000000000L, 0.250000000000000000L, 0.250000000000000000L}},
+    {S31,  0.029951921128443205L, {0.033354235106873802L, 0.322215254964375399L, 0.322215254964375399L, 0.322215254964375399L}},
+    {S31,  0.023743960450946964L, {0.166969239850765775L, 0.166969239850765775L, 0.166969239850765775L, 0.499092280447702674L}},
+    {S31,  0.003347393255473700L, {0.058938738319904382L, 0.058938738319904382L, 0.058938738319904382L, 0.823183785040286853L}},
+    {S31,  0.005144813656803122L, {0.039048095106989591L, 0.039048095106989591L, 0.039048095106989591L, 0.882855714679031228L}},
+    {S22,  0.037187073803642249L, {0.109781651966361648L, 0.109781651966361648L, 0.390218348033638352L, 0.390218348033638352L}},
+    {S211, 0.021138358100179338L, {0.035474892868467921L, 0.182610598681107520L, 0.182610598681107520L, 0.599303909769317040L}},
+    {S211, 0.010033651176419941L, {0.033319699283563675L, 0.033319699283563675L, 0.214736102429761131L, 0.718624499003111519L}},
+    {S211, 0.008140340269380397L, {0.001615288498228457L, 0.079749616971514971L, 0.459317547265128286L, 0.459317547265128286L}},
+  };
+
+  SymRule const rules[] = {
+    {2,  4,  6, tri_4, sizeof(tri_4)/sizeof(SymOrbit)},
+    {2, 11, 28, tri_11, sizeof(tri_11)/sizeof(SymOrbit)},
+    {2, 12, 33, tri_12, sizeof(tri_12)/sizeof(SymOrbit)},
+    {2, 13, 37, tri_13, sizeof(tri_13)/sizeof(SymOrbit)},
+    {2, 14, 42, tri_14, sizeof(tri_14)/sizeof(SymOrbit)},
+    {2, 15, 49, tri_15, sizeof(tri_15)/sizeof(SymOrbit)},
+    {2, 16, 55, tri_16, sizeof(tri_16)/sizeof(SymOrbit)},
+    {2, 17, 60, tri_17, sizeof(tri_17)/sizeof(SymOrbit)},
+    {2, 18, 67, tri_18, sizeof(tri_18)/sizeof(SymOrbit)},
+    {2, 19, 73, tri_19, sizeof(tri_19)/sizeof(SymOrbit)},
+    {2, 20, 79, tri_20, sizeof(tri_20)/sizeof(SymOrbit)},
+    {3,  7, 35, tet_7, sizeof(tet_7)/sizeof(SymOrbit)},
+    {3,  9, 59, tet_9, sizeof(tet_9)/sizeof(SymOrbit)},
+  };
+
+  int const num_rules = sizeof(rules)/sizeof(SymRule);
+
+} // end anonymous namespace
+
+
+///
+/// @param n order.
+/// @param dim simplex's dimension, 2 or 3.
+/// @param[in,out] points qdrts points: replaced only if the library has a rule of order \c n or
+///                higher with less points than the ones given.
+/// @param[in,out] weights qdrts weights, summing to 1 (like the tables, before the scaling by the measure).
+/// @return \c true if the points were replaced.
+///
+bool Quadrature::igetQuadrPtsSymmetric(int n, int dim, std::vector<Vec3>& points, std::vector<Real>& weights)
+{
+  SymRule const* best = NULL;
+  for (int r = 0; r < num_rules; ++r)
+    if (rules[r].dim == dim && rules[r].degree >= n && rules[r].npts < (int)points.size())
+      if (!best || rules[r].npts < best->npts)
+        best = &rules[r];
+
+  if (!best)
+    return false;
+
+  points.clear();
+  weights.clear();
+  for (int o = 0; o < best->norbits; ++o)
+  {
+    SymOrbit const& orb = best->orbits[o];
+    long double L[4];
+    std::copy(orb.gen, orb.gen + dim+1, L);
+    std::sort(L, L + dim+1);
+    int const first = points.size();
+    do
+    {
+      Vec3 X;
+      X[0] = L[1];
+      X[1] = L[2];
+      X[2] = dim == 3 ? L[3] : 0.;
+      points.push_back(X);
+      weights.push_back(orb.weight);
+    }
+    while (std::next_permutation(L, L + dim+1));
+    ALELIB_ASSERT((int)points.size() - first == orb.type, "wrong orbit generator", std::logic_error);
+  }
+  ALELIB_ASSERT((int)points.size() == best->npts, "wrong number of points", std::logic_error);
+
+  return true;
+}
+
+} // end namespace alelib
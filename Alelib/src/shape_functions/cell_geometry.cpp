@@ -0,0 +1,539 @@
+#include "cell_geometry.hpp"
+#include "parametric_pts.hpp"
+#include <cmath>
+#include <stdint.h>
+#include <algorithm>
+
+namespace alelib
+{
+
+namespace
+{
+  int cellDim(ECellType ct)
+  {
+    switch (ct)
+    {
+      case EDGE:        return 1;
+      case TRIANGLE:
+      case QUADRANGLE:  return 2;
+      case TETRAHEDRON:
+      case HEXAHEDRON:  return 3;
+      default:          return 0;
+    }
+  }
+
+  // signs of the reference coordinates of the vertices of the quadrangle and the hexahedron
+  int const hcube_sign[8][3] = {{-1,-1,-1}, {1,-1,-1}, {1,1,-1}, {-1,1,-1},
+                                {-1,-1, 1}, {1,-1, 1}, {1,1, 1}, {-1,1, 1}};
+
+  Real* alignedBase(std::vector<Real>& storage)
+  {
+    Real* base = &storage[0];
+    uintptr_t const mis = reinterpret_cast<uintptr_t>(base) % ALELIB_QUADRATURE_ALIGN;
+    if (mis)
+      base += (ALELIB_QUADRATURE_ALIGN - mis)/sizeof(Real);
+    return base;
+  }
+
+  // inverse and determinant of a DxD matrix
+  template<int D>
+  inline void invertSquare(Real const* a, Real* inv, Real& det);
+
+  template<>
+  inline void invertSquare<1>(Real const* a, Real* inv, Real& det)
+  {
+    det = a[0];
+    inv[0] = 1./det;
+  }
+
+  template<>
+  inline void invertSquare<2>(Real const* a, Real* inv, Real& det)
+  {
+    det = a[0]*a[3] - a[1]*a[2];
+    Real const r = 1./det;
+    inv[0] =  a[3]*r;  inv[1] = -a[1]*r;
+    inv[2] = -a[2]*r;  inv[3] =  a[0]*r;
+  }
+
+  template<>
+  inline void invertSquare<3>(Real const* a, Real* inv, Real& det)
+  {
+    Real const c0 = a[4]*a[8] - a[5]*a[7];
+    Real const c1 = a[5]*a[6] - a[3]*a[8];
+    Real const c2 = a[3]*a[7] - a[4]*a[6];
+    det = a[0]*c0 + a[1]*c1 + a[2]*c2;
+    Real const r = 1./det;
+    inv[0] = c0*r;  inv[1] = (a[2]*a[7] - a[1]*a[8])*r;  inv[2] = (a[1]*a[5] - a[2]*a[4])*r;
+    inv[3] = c1*r;  inv[4] = (a[0]*a[8] - a[2]*a[6])*r;  inv[5] = (a[2]*a[3] - a[0]*a[5])*r;
+    inv[6] = c2*r;  inv[7] = (a[1]*a[6] - a[0]*a[7])*r;  inv[8] = (a[0]*a[4] - a[1]*a[3])*r;
+  }
+
+  // J[(i*D + j)*npad + qp] -> invJ[(j*SD + i)*npad + qp], det[qp], for qp < np.
+  // The sizes are template parameters so the loop body is straight-line code the compiler can vectorize.
+  template<int SD, int D>
+  void invertJacobians(int np, int npad, Real const* J, Real* invJ, Real* det)
+  {
+    for (int qp = 0; qp < np; ++qp)
+    {
+      Real a[SD*D], b[D*SD];
+      for (int k = 0; k < SD*D; ++k)
+        a[k] = J[k*npad + qp];
+
+      if (SD == D)
+      {
+        Real inv[D*D];
+        invertSquare<D>(a, inv, det[qp]);
+        for (int k = 0; k < D*D; ++k)
+          b[k] = inv[k];
+      }
+      else
+      {
+        // (J^T J)^{-1} J^T
+        Real G[D*D], Gi[D*D], g;
+        for (int j = 0; j < D; ++j)
+          for (int l = 0; l < D; ++l)
+          {
+            G[j*D + l] = 0;
+            for (int i = 0; i < SD; ++i)
+              G[j*D + l] += a[i*D + j]*a[i*D + l];
+          }
+        invertSquare<D>(G, Gi, g);
+        det[qp] = std::sqrt(g);
+        for (int j = 0; j < D; ++j)
+          for (int i = 0; i < SD; ++i)
+          {
+            b[j*SD + i] = 0;
+            for (int l = 0; l < D; ++l)
+              b[j*SD + i] += Gi[j*D + l]*a[i*D + l];
+          }
+      }
+
+      for (int k = 0; k < D*SD; ++k)
+        invJ[k*npad + qp] = b[k];
+    }
+  }
+
+  void invertJacobians(int sdim, int dim, int np, int npad, Real const* J, Real* invJ, Real* det)
+  {
+    switch (sdim*4 + dim)
+    {
+      case 1*4 + 1: invertJacobians<1,1>(np, npad, J, invJ, det); break;
+      case 2*4 + 1: invertJacobians<2,1>(np, npad, J, invJ, det); break;
+      case 3*4 + 1: invertJacobians<3,1>(np, npad, J, invJ, det); break;
+      case 2*4 + 2: invertJacobians<2,2>(np, npad, J, invJ, det); break;
+      case 3*4 + 2: invertJacobians<3,2>(np, npad, J, invJ, det); break;
+      case 3*4 + 3: invertJacobians<3,3>(np, npad, J, invJ, det); break;
+      default:
+        ALELIB_ASSERT(false, "invalid dimensions", std::invalid_argument);
+    }
+  }
+}
+
+
+CellGeometry::CellGeometry()
+  : m_cell_type(UNDEFINED_CELLT), m_dim(0), m_sdim(0), m_degree(0), m_nnodes(0), m_nverts(0),
+    m_inside_tol(1e-10), m_newton_tol(1e-12), m_newton_its(20),
+    m_npts(0), m_npad(0), m_has_normal(false), m_phi(NULL), m_dphi(NULL), m_weights(NULL),
+    m_nblocks(0), m_off_x(0), m_off_J(0), m_off_invJ(0), m_off_det(0), m_off_JxW(0), m_off_n(0),
+    m_ncells(0), m_base(NULL)
+{ }
+
+CellGeometry::CellGeometry(ECellType ct, int sdim, int degree)
+  : m_inside_tol(1e-10), m_newton_tol(1e-12), m_newton_its(20),
+    m_npts(0), m_npad(0), m_has_normal(false), m_phi(NULL), m_dphi(NULL), m_weights(NULL),
+    m_ncells(0), m_base(NULL)
+{
+  setType(ct, sdim, degree);
+}
+
+void CellGeometry::setType(ECellType ct, int sdim, int degree)
+{
+  int const dim = cellDim(ct);
+  ALELIB_ASSERT(dim > 0, "invalid cell type", std::invalid_argument);
+  ALELIB_ASSERT(sdim >= dim && sdim <= 3, "invalid space dimension", std::invalid_argument);
+  ALELIB_ASSERT(degree >= 1, "invalid degree", std::invalid_argument);
+
+  m_cell_type = ct;
+  m_dim    = dim;
+  m_sdim   = sdim;
+  m_degree = degree;
+  char const* family = (ct == QUADRANGLE || ct == HEXAHEDRON) ? "Lagrange_hcube" : "Lagrange";
+  m_map.setType(family, dim, degree);
+  m_nnodes = m_map.numDofs();
+
+  // the vertex functions at the reference nodes, to detect straight high-order cells
+  ShapeFunction p1;
+  p1.setType(family, dim, 1);
+  m_nverts = p1.numDofs();
+  m_node_p1.clear();
+  if (degree > 1)
+  {
+    std::vector<double> xi;
+    switch (ct)
+    {
+      case EDGE:        genLineParametricPts(degree, xi); break;
+      case TRIANGLE:    genTriParametricPts (degree, xi); break;
+      case QUADRANGLE:  genQuadParametricPts(degree, xi); break;
+      case TETRAHEDRON: genTetParametricPts (degree, xi); break;
+      default:          genHexParametricPts (degree, xi); break;
+    }
+    ALELIB_ASSERT((int)xi.size() == m_nnodes*dim, "invalid reference nodes", std::runtime_error);
+    m_node_p1.resize(p1.tabulateSize(m_nnodes, 0));
+    p1.tabulate(m_nnodes, &xi[0], 0, &m_node_p1[0]);
+  }
+
+  // the map at the centroid of the reference cell, where the inverse map starts
+  bool const simplex = ct == TRIANGLE || ct == TETRAHEDRON;
+  for (int j = 0; j < 3; ++j)
+    m_centroid[j] = (simplex && j < dim) ? 1./(dim + 1) : 0.;
+  m_cen_phi.resize(m_map.tabulateSize(1, 0));
+  m_cen_dphi.resize(m_map.tabulateSize(1, 1));
+  m_map.tabulate(1, m_centroid, 0, &m_cen_phi[0]);
+  m_map.tabulate(1, m_centroid, 1, &m_cen_dphi[0]);
+
+  m_off_x    = 0;
+  m_off_J    = m_off_x    + m_sdim;
+  m_off_invJ = m_off_J    + m_sdim*m_dim;
+  m_off_det  = m_off_invJ + m_dim*m_sdim;
+  m_off_JxW  = m_off_det  + 1;
+  m_off_n    = m_off_JxW  + 1;
+  m_nblocks  = m_off_n    + m_sdim;
+
+  m_npts = m_npad = 0;
+  m_ncells = 0;
+  m_has_normal = false;
+}
+
+void CellGeometry::setPoints(Quadrature const& quadr)
+{
+  ALELIB_CHECK(quadr.cellType() == m_cell_type, "the quadrature is not of this cell", std::invalid_argument);
+  int const np = quadr.numPoints();
+  std::vector<Real> pts(np*m_dim + 1), w(np + 1);
+  for (int qp = 0; qp < np; ++qp)
+  {
+    for (int c = 0; c < m_dim; ++c)
+      pts[qp*m_dim + c] = quadr.point(qp)[c];
+    w[qp] = quadr.weight(qp);
+  }
+  setPoints(np, &pts[0], &w[0]);
+}
+
+void CellGeometry::setPoints(FacetQuadrature const& fquadr, int facet, int orient)
+{
+  ALELIB_CHECK(fquadr.cellType() == m_cell_type, "the quadrature is not of this cell", std::invalid_argument);
+  int const np = fquadr.numPoints();
+  std::vector<Real> w(np + 1);
+  for (int qp = 0; qp < np; ++qp)
+    w[qp] = fquadr.weight(facet, qp);
+  setPoints(np, fquadr.points(facet, orient), &w[0]);
+
+  m_has_normal = true;
+  for (int j = 0; j < m_dim; ++j)
+    m_ref_normal[j] = fquadr.normal(facet)[j];
+}
+
+void CellGeometry::setPoints(int npts, Real const* pts, Real const* weights)
+{
+  ALELIB_ASSERT(m_dim > 0, "the cell type has not been set", std::invalid_argument);
+  int const width = ALELIB_QUADRATURE_ALIGN/sizeof(Real);
+  int const nn = m_nnodes;
+
+  m_npts = npts;
+  m_npad = (npts + width - 1)/width*width;
+  m_has_normal = false;
+
+  // the padding points repeat the first one
+  std::vector<Real> x(std::max(m_npad, 1)*m_dim, 0.);
+  for (int qp = 0; qp < m_npad && npts > 0; ++qp)
+    for (int c = 0; c < m_dim; ++c)
+      x[qp*m_dim + c] = pts[(qp < npts ? qp : 0)*m_dim + c];
+
+  std::vector<Real> vals(m_map.tabulateSize(m_npad, 0) + 1), grads(m_map.tabulateSize(m_npad, 1) + 1);
+  m_map.tabulate(m_npad, &x[0], 0, &vals[0]);
+  m_map.tabulate(m_npad, &x[0], 1, &grads[0]);
+
+  m_ref_storage.assign((nn + nn*m_dim + 1)*m_npad + width, 0.);
+  Real* base = alignedBase(m_ref_storage);
+  Real* phi  = base;
+  Real* dphi = phi  + nn*m_npad;
+  Real* w    = dphi + nn*m_dim*m_npad;
+
+  for (int qp = 0; qp < m_npad; ++qp)
+  {
+    for (int n = 0; n < nn; ++n)
+    {
+      phi[n*m_npad + qp] = vals[qp*nn + n];
+      for (int j = 0; j < m_dim; ++j)
+        dphi[(n*m_dim + j)*m_npad + qp] = grads[(qp*nn + n)*m_dim + j];
+    }
+    w[qp] = qp < npts ? (weights ? weights[qp] : 1.) : 0.;
+  }
+
+  m_phi = phi;
+  m_dphi = dphi;
+  m_weights = w;
+  m_ncells = 0;
+}
+
+// degree 1 simplices are affine; quadrangles and hexahedra if the bilinear/trilinear terms vanish;
+// higher degrees if, besides, the high-order nodes are where the degree 1 map puts them
+bool CellGeometry::isAffineCell(Real const* X) const
+{
+  int const nv = m_nverts;
+  Real scale = 0;
+  for (int v = 1; v < nv; ++v)
+    for (int i = 0; i < m_sdim; ++i)
+      scale = std::max(scale, std::fabs(X[v*m_sdim + i] - X[i]));
+
+  for (int n = nv; n < m_nnodes; ++n)
+    for (int i = 0; i < m_sdim; ++i)
+    {
+      Real x = 0;
+      for (int v = 0; v < nv; ++v)
+        x += m_node_p1[n*nv + v]*X[v*m_sdim + i];
+      if (std::fabs(X[n*m_sdim + i] - x) > 1e-10*scale) // mesh files round the nodes
+        return false;
+    }
+
+  if (m_cell_type != QUADRANGLE && m_cell_type != HEXAHEDRON)
+    return true;
+
+  // the (sign) combinations of the vertices that multiply xi*eta, xi*zeta, eta*zeta and xi*eta*zeta
+  int const nmixed = m_dim == 2 ? 1 : 4;
+  int const mixed[4][2] = {{0,1}, {0,2}, {1,2}, {0,3}};
+
+  for (int m = 0; m < nmixed; ++m)
+    for (int i = 0; i < m_sdim; ++i)
+    {
+      Real s = 0;
+      for (int v = 0; v < nv; ++v)
+      {
+        int sg = hcube_sign[v][mixed[m][0]];
+        sg *= mixed[m][1] == 3 ? hcube_sign[v][1]*hcube_sign[v][2] : hcube_sign[v][mixed[m][1]];
+        s += sg*X[v*m_sdim + i];
+      }
+      if (std::fabs(s) > 1e-12*scale)
+        return false;
+    }
+  return true;
+}
+
+void CellGeometry::computeCell(Real const* X, Real* out, unsigned flags, char& affine) const
+{
+  int const np = m_npad;
+  int const nn = m_nnodes;
+
+  if (flags & GEOM_POINTS)
+    for (int i = 0; i < m_sdim; ++i)
+    {
+      Real* x = out + (m_off_x + i)*np;
+      std::fill(x, x + np, 0.);
+      for (int n = 0; n < nn; ++n)
+      {
+        Real const c = X[n*m_sdim + i];
+        Real const* phi = m_phi + n*np;
+        for (int qp = 0; qp < np; ++qp)
+          x[qp] += c*phi[qp];
+      }
+    }
+
+  affine = isAffineCell(X);
+  if (!(flags & ~GEOM_POINTS))
+    return;
+
+  // on affine cells the Jacobian is computed at the first point only and broadcast
+  int const nq = affine ? 1 : np;
+  Real* J    = out + m_off_J*np;
+  Real* invJ = out + m_off_invJ*np;
+  Real* det  = out + m_off_det*np;
+  for (int i = 0; i < m_sdim; ++i)
+    for (int j = 0; j < m_dim; ++j)
+    {
+      Real* Jij = J + (i*m_dim + j)*np;
+      std::fill(Jij, Jij + nq, 0.);
+      for (int n = 0; n < nn; ++n)
+      {
+        Real const c = X[n*m_sdim + i];
+        Real const* dphi = m_dphi + (n*m_dim + j)*np;
+        for (int qp = 0; qp < nq; ++qp)
+          Jij[qp] += c*dphi[qp];
+      }
+    }
+
+  if (flags & ~(GEOM_POINTS | GEOM_JACOBIAN))
+    invertJacobians(m_sdim, m_dim, nq, np, J, invJ, det);
+
+  if (affine)
+  {
+    for (int k = 0; k < m_sdim*m_dim; ++k)
+    {
+      std::fill(J    + k*np + 1, J    + (k+1)*np, J[k*np]);
+      std::fill(invJ + k*np + 1, invJ + (k+1)*np, invJ[k*np]);
+    }
+    std::fill(det + 1, det + np, det[0]);
+  }
+
+  if (!(flags & (GEOM_JxW | GEOM_NORMALS)))
+    return;
+
+  Real* JxW = out + m_off_JxW*np;
+  if (!m_has_normal)
+  {
+    for (int qp = 0; qp < np; ++qp)
+      JxW[qp] = m_weights[qp]*std::fabs(det[qp]);
+    return;
+  }
+
+  // Nanson's formula: n da = det(J) J^{-T} n_ref dA
+  Real* nrm = out + m_off_n*np;
+  for (int i = 0; i < m_sdim; ++i)
+  {
+    Real* ni = nrm + i*np;
+    std::fill(ni, ni + np, 0.);
+    for (int j = 0; j < m_dim; ++j)
+    {
+      Real const nj = m_ref_normal[j];
+      Real const* Kji = invJ + (j*m_sdim + i)*np;
+      for (int qp = 0; qp < np; ++qp)
+        ni[qp] += Kji[qp]*nj;
+    }
+  }
+  for (int qp = 0; qp < np; ++qp)
+  {
+    Real len = 0;
+    for (int i = 0; i < m_sdim; ++i)
+      len += nrm[i*np + qp]*nrm[i*np + qp];
+    len = std::sqrt(len);
+    for (int i = 0; i < m_sdim; ++i)
+      nrm[i*np + qp] /= len;
+    JxW[qp] = m_weights[qp]*std::fabs(det[qp])*len;
+  }
+}
+
+void CellGeometry::compute(int ncells, Real const* nodes, unsigned flags)
+{
+  ALELIB_CHECK(m_phi != NULL, "the points have not been set", std::invalid_argument);
+
+  int const width = ALELIB_QUADRATURE_ALIGN/sizeof(Real);
+  size_t const size = size_t(ncells)*m_nblocks*m_npad + width;
+  if (m_storage.size() < size)
+    m_storage.resize(size);
+  m_base = alignedBase(m_storage);
+  m_affine.resize(ncells);
+  m_ncells = ncells;
+
+  for (int c = 0; c < ncells; ++c)
+    computeCell(nodes + c*m_nnodes*m_sdim, m_base + c*m_nblocks*m_npad, flags, m_affine[c]);
+}
+
+// one (Gauss-)Newton step from xi, with the map functions tabulated at xi; returns the size of the step
+Real CellGeometry::newtonStep(Real const* X, Real const* phi, Real const* dphi, Real const* x, Real* xi) const
+{
+  int const D = m_dim, SD = m_sdim;
+  Real F[3], J[9], invJ[9], det;
+  for (int i = 0; i < SD; ++i)
+  {
+    F[i] = x[i];
+    for (int j = 0; j < D; ++j)
+      J[i*D + j] = 0;
+    for (int n = 0; n < m_nnodes; ++n)
+    {
+      Real const c = X[n*SD + i];
+      F[i] -= c*phi[n];
+      for (int j = 0; j < D; ++j)
+        J[i*D + j] += c*dphi[n*D + j];
+    }
+  }
+  invertJacobians(SD, D, 1, 1, J, invJ, &det);
+
+  Real step = 0;
+  for (int j = 0; j < D; ++j)
+  {
+    Real d = 0;
+    for (int i = 0; i < SD; ++i)
+      d += invJ[j*SD + i]*F[i];
+    xi[j] += d;
+    step = std::max(step, std::fabs(d));
+  }
+  return det != 0 ? step : Real(HUGE_VAL);
+}
+
+bool CellGeometry::isInside(Real const* xi) const
+{
+  Real const tol = m_inside_tol;
+  bool in = true;
+  if (m_cell_type == TRIANGLE || m_cell_type == TETRAHEDRON)
+  {
+    Real sum = 0;
+    for (int j = 0; j < m_dim; ++j)
+    {
+      in = in && xi[j] >= -tol;
+      sum += xi[j];
+    }
+    in = in && sum <= 1. + tol;
+  }
+  else
+    for (int j = 0; j < m_dim; ++j)
+      in = in && std::fabs(xi[j]) <= 1. + tol;
+  return in; // false for NaN
+}
+
+int CellGeometry::inverseMap(int npts, Real const* nodes, int const* cells, Real const* x, Real* xi, char* inside) const
+{
+  ALELIB_ASSERT(m_dim > 0, "the cell type has not been set", std::invalid_argument);
+  int const D = m_dim, SD = m_sdim, nn = m_nnodes;
+
+  // first step, from the centroid; it is exact on affine cells
+  std::vector<char> conv(npts, 1);
+  std::vector<int>  active;
+  for (int p = 0; p < npts; ++p)
+  {
+    Real const* X = nodes + (cells ? cells[p] : p)*nn*SD;
+    std::copy(m_centroid, m_centroid + D, xi + p*D);
+    newtonStep(X, &m_cen_phi[0], &m_cen_dphi[0], x + p*SD, xi + p*D);
+    if (!isAffineCell(X))
+    {
+      conv[p] = 0;
+      active.push_back(p);
+    }
+  }
+
+  // Newton on the curved and multilinear cells, all the active points at once
+  std::vector<Real> pts, vals, grads;
+  for (int it = 1; it < m_newton_its && !active.empty(); ++it)
+  {
+    int const na = active.size();
+    pts.resize(na*D);
+    for (int k = 0; k < na; ++k)
+      std::copy(xi + active[k]*D, xi + (active[k] + 1)*D, &pts[k*D]);
+    vals.resize(m_map.tabulateSize(na, 0));
+    grads.resize(m_map.tabulateSize(na, 1));
+    m_map.tabulate(na, &pts[0], 0, &vals[0]);
+    m_map.tabulate(na, &pts[0], 1, &grads[0]);
+
+    int keep = 0;
+    for (int k = 0; k < na; ++k)
+    {
+      int const p = active[k];
+      Real const* X = nodes + (cells ? cells[p] : p)*nn*SD;
+      Real const step = newtonStep(X, &vals[k*nn], &grads[k*nn*D], x + p*SD, xi + p*D);
+      if (step <= m_newton_tol)
+        conv[p] = 1;
+      else
+        active[keep++] = p;
+    }
+    active.resize(keep);
+  }
+
+  int count = 0;
+  for (int p = 0; p < npts; ++p)
+  {
+    bool const in = conv[p] && isInside(xi + p*D);
+    count += in;
+    if (inside)
+      inside[p] = in;
+  }
+  return count;
+}
+
+} // end namespace alelib
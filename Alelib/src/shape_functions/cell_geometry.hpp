@@ -0,0 +1,273 @@
+// This file is part of Alelib, a toolbox for finite element codes.
+//
+// Alelib is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// Alelib is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// Alelib. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALELIB_CELL_GEOMETRY_HPP
+#define ALELIB_CELL_GEOMETRY_HPP
+
+#include "shape_function.hpp"
+#include "../quadrature/quadrature.hpp"
+#include "../quadrature/facet_quadrature.hpp"
+#include "../util/assert.hpp"
+#include <vector>
+#include <algorithm>
+
+namespace alelib
+{
+
+/// what CellGeometry::compute computes; the quantities needed by the requested ones are computed too
+enum EGeometryFlags
+{
+  GEOM_POINTS       = 1 << 0,
+  GEOM_JACOBIAN     = 1 << 1,
+  GEOM_INV_JACOBIAN = 1 << 2,
+  GEOM_DET_JACOBIAN = 1 << 3,
+  GEOM_JxW          = 1 << 4,
+  GEOM_NORMALS      = 1 << 5,  // ignored unless the points were set from a FacetQuadrature
+  GEOM_ALL          = (1 << 6) - 1
+};
+
+/** @brief Batched geometric mapping of cells at a set of reference points.
+ *
+ *  The map of a cell is \f$ \bf{x}(\xi) = \sum_n \bf{x}_n \phi_n(\xi) \f$, where \f$ \phi_n \f$ are the
+ *  Lagrange functions of degree \c degree of the cell (degree 1: the vertices).
+ *  For a batch of cells, compute() gives at every reference point the mapped points, the Jacobians
+ *  \f$ J_{ij} = \partial x_i/\partial\xi_j \f$, their (pseudo-)inverses, the determinants and the
+ *  quadrature weights times the determinants; at facet points, also the unit outward normals.
+ *  When the space dimension is greater than the cell dimension (surfaces, curves), the inverse is
+ *  \f$ (J^TJ)^{-1}J^T \f$ and the determinant \f$ \sqrt{\det J^TJ} \f$.
+ *
+ *  The results are in SoA layout: every array returned by the accessors has numPointsPadded() entries,
+ *  one per point, starts at an address aligned to ALELIB_QUADRATURE_ALIGN bytes and the padding points
+ *  have zero weight. Affine cells (simplices, parallelograms and parallelepipeds whose high-order nodes,
+ *  if any, are where the vertices put them) take a fast path: J and its inverse are computed once and
+ *  broadcast, so kernels may read only the first entry when isAffine(cell) is true.
+ *
+ *  The values of the map functions at the reference points are tabulated once, in setPoints().
+ *  inverseMap() goes the other way, from physical points to reference coordinates.
+ */
+class CellGeometry
+{
+public:
+
+  CellGeometry();
+
+  CellGeometry(ECellType ct, int sdim, int degree = 1);
+
+  /** @brief Sets the cell and its map.
+   *  @param sdim space dimension, at least the cell dimension. */
+  void setType(ECellType ct, int sdim, int degree = 1);
+
+  /// the points and weights of a rule of the cell.
+  void setPoints(Quadrature const& quadr);
+
+  /// the points of a facet, with the weights of the facet and its reference normal.
+  void setPoints(FacetQuadrature const& fquadr, int facet, int orient);
+
+  /** @brief arbitrary points, \c dim() coordinates per point.
+   *  @param weights can be NULL, then the weights are 1. */
+  void setPoints(int npts, Real const* pts, Real const* weights = NULL);
+
+  /** @brief Computes the geometry of \c ncells cells.
+   *  @param nodes coordinates of the nodes of the map: <tt>nodes[(cell*numNodes() + n)*spaceDim() + i]</tt>.
+   *  @param flags combination of EGeometryFlags. */
+  void compute(int ncells, Real const* nodes, unsigned flags = GEOM_ALL);
+
+  /** @brief Same as above, taking the nodes from the cells of a mesh.
+   *  Degree 1 uses the vertices; a higher degree must be the geometry degree of the mesh
+   *  (Mesh::geometryDegree()), and then the map is isoparametric, through the high-order nodes
+   *  kept by the mesh. The mesh space dimension must be spaceDim(). */
+  template<class MeshT>
+  void compute(MeshT const* mp, typename MeshT::CellH const* cells, int ncells, unsigned flags = GEOM_ALL)
+  {
+    gatherNodes(mp, cells, ncells, m_gather);
+    compute(ncells, &m_gather[0], flags);
+  }
+
+  /** @brief Inverse of the map: the reference coordinates of physical points.
+   *
+   *  The point p, <tt>x[p*spaceDim() + i]</tt>, is searched in the cell <tt>cells[p]</tt> of \c nodes
+   *  (laid out as in compute(); the cell p if \c cells is NULL). Every point starts at the centroid of
+   *  the reference cell; on affine cells one step gives the answer. On the other ones Newton iterates
+   *  on the whole batch, the map functions being tabulated at the iterates of all the active points at
+   *  once. When spaceDim() > dim() the result is the least-squares (Gauss-Newton) projection.
+   *  @param xi the reference coordinates: <tt>xi[p*dim() + j]</tt>.
+   *  @param inside can be NULL; 1 if Newton converged and the point is in the reference cell, up to
+   *         insideTolerance(), 0 otherwise.
+   *  @return the number of points inside. */
+  int inverseMap(int npts, Real const* nodes, int const* cells, Real const* x, Real* xi, char* inside = NULL) const;
+
+  /// Same as above, the point p being searched in the mesh cell <tt>cells[p]</tt> (see compute()).
+  template<class MeshT>
+  int inverseMap(MeshT const* mp, typename MeshT::CellH const* cells, int npts, Real const* x, Real* xi,
+                 char* inside = NULL) const
+  {
+    std::vector<Real> nodes;
+    gatherNodes(mp, cells, npts, nodes);
+    return inverseMap(npts, &nodes[0], NULL, x, xi, inside);
+  }
+
+  /** @param inside_tol how far out of the reference cell, in reference coordinates, a point is inside.
+   *  @param newton_tol Newton stops when the step is smaller (max norm, reference coordinates).
+   *  @param max_iters Newton gives up after that many steps; the point is then outside. */
+  void setInverseMapTolerances(Real inside_tol, Real newton_tol = 1e-12, int max_iters = 20)
+  {
+    m_inside_tol = inside_tol;
+    m_newton_tol = newton_tol;
+    m_newton_its = max_iters;
+  }
+
+  Real insideTolerance() const
+  { return m_inside_tol; }
+
+  /// true if the reference point xi is in the reference cell, up to insideTolerance()
+  bool isInside(Real const* xi) const;
+
+  /// mapped points: <tt>points(cell, i)[qp]</tt>.
+  Real const* points(int cell, int i) const
+  { return block(cell, m_off_x + i); }
+
+  /// \f$ \partial x_i/\partial\xi_j \f$: <tt>jacobian(cell, i, j)[qp]</tt>.
+  Real const* jacobian(int cell, int i, int j) const
+  { return block(cell, m_off_J + i*m_dim + j); }
+
+  /// \f$ \partial\xi_j/\partial x_i \f$: <tt>invJacobian(cell, j, i)[qp]</tt>.
+  Real const* invJacobian(int cell, int j, int i) const
+  { return block(cell, m_off_invJ + j*m_sdim + i); }
+
+  Real const* detJacobian(int cell) const
+  { return block(cell, m_off_det); }
+
+  /// quadrature weights times the measure factor of the map (at facet points, the one of the facet).
+  Real const* JxW(int cell) const
+  { return block(cell, m_off_JxW); }
+
+  /// unit outward normals at facet points: <tt>normals(cell, i)[qp]</tt>.
+  Real const* normals(int cell, int i) const
+  { return block(cell, m_off_n + i); }
+
+  bool isAffine(int cell) const
+  { return m_affine[cell] != 0; }
+
+  int numCells() const
+  { return m_ncells; }
+
+  int numPoints() const
+  { return m_npts; }
+
+  int numPointsPadded() const
+  { return m_npad; }
+
+  /// number of nodes of the map per cell
+  int numNodes() const
+  { return m_nnodes; }
+
+  int dim() const
+  { return m_dim; }
+
+  int spaceDim() const
+  { return m_sdim; }
+
+  int degree() const
+  { return m_degree; }
+
+  ECellType cellType() const
+  { return m_cell_type; }
+
+  /// the functions of the map.
+  ShapeFunction const& mapFunctions() const
+  { return m_map; }
+
+private:
+
+  CellGeometry(CellGeometry const&);
+  CellGeometry& operator=(CellGeometry const&);
+
+  Real const* block(int cell, int k) const
+  { return m_base + (cell*m_nblocks + k)*m_npad; }
+
+  Real* block(int cell, int k)
+  { return m_base + (cell*m_nblocks + k)*m_npad; }
+
+  // nodes of the mesh cells, as compute() takes them; degree 1 takes the vertices
+  template<class MeshT>
+  void gatherNodes(MeshT const* mp, typename MeshT::CellH const* cells, int ncells, std::vector<Real>& nodes) const
+  {
+    ALELIB_CHECK(m_degree == 1 || m_degree == mp->geometryDegree(), "the mesh does not store the nodes of this degree", std::invalid_argument);
+    ALELIB_CHECK(mp->spaceDim() == m_sdim, "space dimension mismatch", std::invalid_argument);
+    int const nall = MeshT::numGeometryNodes(mp->geometryDegree());
+    nodes.resize((ncells*m_nnodes + nall)*m_sdim);
+    Real* X = &nodes[ncells*m_nnodes*m_sdim]; // all the nodes of a cell
+    for (int k = 0; k < ncells; ++k)
+    {
+      if (m_nnodes == nall)
+        mp->cellGeometryNodes(cells[k], &nodes[k*m_nnodes*m_sdim]);
+      else
+      {
+        mp->cellGeometryNodes(cells[k], X);
+        std::copy(X, X + m_nnodes*m_sdim, &nodes[k*m_nnodes*m_sdim]);
+      }
+    }
+  }
+
+  bool isAffineCell(Real const* X) const;
+  void computeCell(Real const* X, Real* out, unsigned flags, char& affine) const;
+  Real newtonStep(Real const* X, Real const* phi, Real const* dphi, Real const* x, Real* xi) const;
+
+  ECellType m_cell_type;
+  int m_dim;
+  int m_sdim;
+  int m_degree;
+  int m_nnodes;
+  int m_nverts;
+  ShapeFunction m_map;
+  std::vector<Real> m_node_p1;  // [node][vertex]: the vertex functions at the reference nodes
+
+  // inverse map
+  Real m_inside_tol;
+  Real m_newton_tol;
+  int  m_newton_its;
+  Real m_centroid[3];
+  std::vector<Real> m_cen_phi;   // [node]
+  std::vector<Real> m_cen_dphi;  // [node][j]
+
+  // reference data
+  int m_npts;
+  int m_npad;
+  bool m_has_normal;
+  Real m_ref_normal[3];
+  std::vector<Real> m_ref_storage;
+  Real const* m_phi;      // [node][qp]
+  Real const* m_dphi;     // [node][j][qp]
+  Real const* m_weights;  // [qp]
+
+  // results: per cell, m_nblocks arrays of m_npad Reals
+  int m_nblocks;
+  int m_off_x, m_off_J, m_off_invJ, m_off_det, m_off_JxW, m_off_n;
+  int m_ncells;
+  std::vector<Real> m_storage;
+  Real* m_base;
+  std::vector<char> m_affine;
+  std::vector<Real> m_gather;
+};
+
+} // end namespace alelib
+
+#endif // ALELIB_CELL_GEOMETRY_HPP
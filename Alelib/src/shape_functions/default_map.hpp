@@ -49,6 +49,12 @@ void genParametricPts<TRIANGLE>(int n, std::vector<double> & list) {return genTr
 template<> inline
 void genParametricPts<TETRAHEDRON>(int n, std::vector<double> & list) {return genTetParametricPts(n,list);}
 
+template<> inline
+void genParametricPts<QUADRANGLE>(int n, std::vector<double> & list) {return genQuadParametricPts(n,list);}
+
+template<> inline
+void genParametricPts<HEXAHEDRON>(int n, std::vector<double> & list) {return genHexParametricPts(n,list);}
+
 
 
 template<> inline
@@ -39,6 +39,12 @@ inline void genTriParametricPtsINT(int n, std::vector<int> &);
 inline void genTetParametricPts(int n, std::vector<double> &);
 inline void genTetParametricPtsINT(int n, std::vector<int> &);
 
+inline void genQuadParametricPts(int n, std::vector<double> &);
+inline void genQuadParametricPtsINT(int n, std::vector<int> &);
+
+inline void genHexParametricPts(int n, std::vector<double> &);
+inline void genHexParametricPtsINT(int n, std::vector<int> &);
+
 
 
 /*
@@ -567,6 +573,172 @@ inline void subCellsTet(int n, std::vector<int> &connectivity)
 
 
 
+/*
+     v
+     ^
+     |
+     3-----------2
+     |           |
+     |           |          nodes are numbered as: vertices, then the nodes inside the
+     |           |          edges 0-1, 1-2, 2-3, 3-0 (from the first to the second vertex),
+     |           |          then the interior nodes with u varying fastest.
+     0-----------1 --> u
+  (-1,-1)     (1,-1)
+
+*/
+/** Returns a vector with the parametric coordinates of the points of a
+ *  quadrangle of order n, in [-1,1]^2.
+ */
+inline void genQuadParametricPts(int n, std::vector<double> & list)
+{
+  list.clear();
+
+  if (n<0)
+    throw std::invalid_argument("FEPIC ERROR: Invalid order");
+
+  if (n==0)
+  {
+    list.assign(2, 0.);
+    return;
+  }
+
+  std::vector<int> temp;
+  genQuadParametricPtsINT(n, temp);
+
+  list.resize(temp.size());
+  for (unsigned i = 0; i < list.size(); ++i)
+    list[i] = static_cast<double>(temp[i])/n;
+}
+
+/// same as genQuadParametricPts, but the coordinates are multiplied by n
+inline void genQuadParametricPtsINT(int n, std::vector<int> & list) // list(2*i + j) = point i component j
+{
+  static int const verts[4][2] = { {-1,-1}, {1,-1}, {1,1}, {-1,1} };
+  static int const edges[4][2] = { {0,1}, {1,2}, {2,3}, {3,0} };
+
+  list.clear();
+
+  if (n<0)
+    throw std::invalid_argument("FEPIC ERROR: Invalid order");
+
+  if (n==0)
+  {
+    list.assign(2, 0);
+    return;
+  }
+
+  for (int v = 0; v < 4; ++v)
+    for (int c = 0; c < 2; ++c)
+      list.push_back(n*verts[v][c]);
+
+  for (int e = 0; e < 4; ++e)
+  {
+    int const* a = verts[edges[e][0]];
+    int const* b = verts[edges[e][1]];
+    for (int k = 1; k < n; ++k)
+      for (int c = 0; c < 2; ++c)
+        list.push_back(n*a[c] + k*(b[c]-a[c]));
+  }
+
+  for (int j = 1; j < n; ++j)
+    for (int i = 1; i < n; ++i)
+    {
+      list.push_back(-n + 2*i);
+      list.push_back(-n + 2*j);
+    }
+}
+
+/*
+        7-----------6
+       /|          /|        vertices, edges and faces follow the numbering of the mesh:
+      / |         / |        edges 0-1, 0-3, 0-4, 1-2, 1-5, 2-3, 2-6, 3-7, 4-5, 4-7, 5-6, 6-7;
+     4-----------5  |        faces 0321, 0154, 0473, 1265, 2376, 4567.
+     |  3--------|--2        Nodes inside a face are numbered from its first vertex, the first
+     | /         | /         local coordinate going to its second vertex and varying fastest,
+     |/          |/          the second going to its last vertex. Interior nodes have u varying
+     0-----------1           fastest, then v, then w.
+
+*/
+/** Returns a vector with the parametric coordinates of the points of a
+ *  hexahedron of order n, in [-1,1]^3.
+ */
+inline void genHexParametricPts(int n, std::vector<double> & list)
+{
+  list.clear();
+
+  if (n<0)
+    throw std::invalid_argument("FEPIC ERROR: Invalid order");
+
+  if (n==0)
+  {
+    list.assign(3, 0.);
+    return;
+  }
+
+  std::vector<int> temp;
+  genHexParametricPtsINT(n, temp);
+
+  list.resize(temp.size());
+  for (unsigned i = 0; i < list.size(); ++i)
+    list[i] = static_cast<double>(temp[i])/n;
+}
+
+/// same as genHexParametricPts, but the coordinates are multiplied by n
+inline void genHexParametricPtsINT(int n, std::vector<int> & list) // list(3*i + j) = point i component j
+{
+  static int const verts[8][3] = { {-1,-1,-1}, {1,-1,-1}, {1,1,-1}, {-1,1,-1},
+                                   {-1,-1, 1}, {1,-1, 1}, {1,1, 1}, {-1,1, 1} };
+  static int const edges[12][2] = { {0,1}, {0,3}, {0,4}, {1,2}, {1,5}, {2,3},
+                                    {2,6}, {3,7}, {4,5}, {4,7}, {5,6}, {6,7} };
+  static int const faces[6][4]  = { {0,3,2,1}, {0,1,5,4}, {0,4,7,3},
+                                    {1,2,6,5}, {2,3,7,6}, {4,5,6,7} };
+
+  list.clear();
+
+  if (n<0)
+    throw std::invalid_argument("FEPIC ERROR: Invalid order");
+
+  if (n==0)
+  {
+    list.assign(3, 0);
+    return;
+  }
+
+  for (int v = 0; v < 8; ++v)
+    for (int c = 0; c < 3; ++c)
+      list.push_back(n*verts[v][c]);
+
+  for (int e = 0; e < 12; ++e)
+  {
+    int const* a = verts[edges[e][0]];
+    int const* b = verts[edges[e][1]];
+    for (int k = 1; k < n; ++k)
+      for (int c = 0; c < 3; ++c)
+        list.push_back(n*a[c] + k*(b[c]-a[c]));
+  }
+
+  for (int f = 0; f < 6; ++f)
+  {
+    int const* o = verts[faces[f][0]];
+    int const* u = verts[faces[f][1]];
+    int const* w = verts[faces[f][3]];
+    for (int kv = 1; kv < n; ++kv)
+      for (int ku = 1; ku < n; ++ku)
+        for (int c = 0; c < 3; ++c)
+          list.push_back(n*o[c] + ku*(u[c]-o[c]) + kv*(w[c]-o[c]));
+  }
+
+  for (int k = 1; k < n; ++k)
+    for (int j = 1; j < n; ++j)
+      for (int i = 1; i < n; ++i)
+      {
+        list.push_back(-n + 2*i);
+        list.push_back(-n + 2*j);
+        list.push_back(-n + 2*k);
+      }
+}
+
+
 #ifdef PARAMETRIC_PTS_DEBUG
 
 #include <iostream>
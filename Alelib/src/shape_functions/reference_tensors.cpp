@@ -0,0 +1,156 @@
+#include "reference_tensors.hpp"
+#include "tabulation_cache.hpp"
+#include "../quadrature/quadrature.hpp"
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace alelib
+{
+
+namespace
+{
+  // owns the tensors computed so far
+  struct RefTensorStore
+  {
+    typedef std::map<std::pair<int,int>, ReferenceTensors*> MapT;
+    MapT       table;
+    std::mutex lock;
+
+    ~RefTensorStore()
+    {
+      for (MapT::iterator it = table.begin(); it != table.end(); ++it)
+        delete it->second;
+    }
+  };
+
+  RefTensorStore& refTensorStore()
+  {
+    static RefTensorStore store;
+    return store;
+  }
+}
+
+
+ReferenceTensors const& ReferenceTensors::get(ECellType ct, int degree)
+{
+  RefTensorStore& store = refTensorStore();
+  std::lock_guard<std::mutex> guard(store.lock);
+
+  std::pair<int,int> const key(ct, degree);
+  RefTensorStore::MapT::iterator it = store.table.find(key);
+  if (it == store.table.end())
+    it = store.table.insert(std::make_pair(key, new ReferenceTensors(ct, degree))).first;
+
+  return *it->second;
+}
+
+ReferenceTensors::ReferenceTensors(ECellType ct, int degree)
+  : m_cell_type(ct), m_degree(degree)
+{
+  switch (ct)
+  {
+    case EDGE:        m_dim = 1; break;
+    case TRIANGLE:    m_dim = 2; break;
+    case TETRAHEDRON: m_dim = 3; break;
+    default:
+      ALELIB_ASSERT(false, "ReferenceTensors: only simplices have affine maps", std::invalid_argument);
+  }
+  ALELIB_ASSERT(degree >= 1, "invalid degree", std::invalid_argument);
+
+  ShapeFunction sf;
+  sf.setType("Lagrange", m_dim, degree);
+  m_ndofs = sf.numDofs();
+
+  // the convection integrand has degree 3*degree - 1
+  Quadrature const quadr(ct, 3*degree);
+  ReferenceTabulation const& tab = TabulationCache::get(sf, quadr);
+
+  int const D = m_dim, n = m_ndofs;
+  m_mass.assign(n*n, 0.);
+  m_stiff.assign(D*D*n*n, 0.);
+  m_conv.assign(D*n*n*n, 0.);
+  for (int qp = 0; qp < quadr.numPoints(); ++qp)
+  {
+    Real const w = quadr.weight(qp);
+    for (int a = 0; a < n; ++a)
+      for (int b = 0; b < n; ++b)
+      {
+        Real const pab = w*tab.value(qp, a)*tab.value(qp, b);
+        m_mass[a*n + b] += pab;
+        for (int j = 0; j < D; ++j)
+          for (int l = 0; l < D; ++l)
+            m_stiff[((j*D + l)*n + a)*n + b] += w*tab.grad(qp, a, j)*tab.grad(qp, b, l);
+        for (int l = 0; l < D; ++l)
+        {
+          Real const pa_db = w*tab.value(qp, a)*tab.grad(qp, b, l);
+          for (int c = 0; c < n; ++c)
+            m_conv[((l*n + c)*n + a)*n + b] += tab.value(qp, c)*pa_db;
+        }
+      }
+  }
+
+  // G is symmetric: only j <= l are needed
+  m_stiff_sym.assign(D*(D + 1)/2*n*n, 0.);
+  int s = 0;
+  for (int j = 0; j < D; ++j)
+    for (int l = j; l < D; ++l, ++s)
+      for (int k = 0; k < n*n; ++k)
+        m_stiff_sym[s*n*n + k] = m_stiff[(j*D + l)*n*n + k] + (j != l ? m_stiff[(l*D + j)*n*n + k] : 0.);
+}
+
+void ReferenceTensors::massMatrix(Real detJ, Real* M) const
+{
+  Real const d = std::fabs(detJ);
+  for (int k = 0; k < m_ndofs*m_ndofs; ++k)
+    M[k] = d*m_mass[k];
+}
+
+void ReferenceTensors::laplaceMatrix(Real detJ, Real const* invJ, int sdim, Real* K) const
+{
+  int const D = m_dim, nn = m_ndofs*m_ndofs;
+  Real const d = std::fabs(detJ);
+
+  // |J| G_jl, j <= l
+  Real G[6];
+  int s = 0;
+  for (int j = 0; j < D; ++j)
+    for (int l = j; l < D; ++l, ++s)
+    {
+      G[s] = 0;
+      for (int i = 0; i < sdim; ++i)
+        G[s] += invJ[j*sdim + i]*invJ[l*sdim + i];
+      G[s] *= d;
+    }
+
+  Real const* A = &m_stiff_sym[0];
+  for (int k = 0; k < nn; ++k)
+    K[k] = G[0]*A[k];
+  for (int t = 1; t < s; ++t)
+    for (int k = 0; k < nn; ++k)
+      K[k] += G[t]*A[t*nn + k];
+}
+
+void ReferenceTensors::convectionMatrix(Real detJ, Real const* invJ, int sdim, Real const* u, Real* C) const
+{
+  int const D = m_dim, n = m_ndofs, nn = n*n;
+  Real const d = std::fabs(detJ);
+
+  for (int k = 0; k < nn; ++k)
+    C[k] = 0;
+  for (int l = 0; l < D; ++l)
+    for (int c = 0; c < n; ++c)
+    {
+      // |J| beta^l_c
+      Real beta = 0;
+      for (int i = 0; i < sdim; ++i)
+        beta += invJ[l*sdim + i]*u[c*sdim + i];
+      beta *= d;
+      Real const* T = &m_conv[(l*n + c)*nn];
+      for (int k = 0; k < nn; ++k)
+        C[k] += beta*T[k];
+    }
+}
+
+} // end namespace alelib
@@ -0,0 +1,130 @@
+// This file is part of Alelib, a toolbox for finite element codes.
+//
+// Alelib is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// Alelib is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// Alelib. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALELIB_REFERENCE_TENSORS_HPP
+#define ALELIB_REFERENCE_TENSORS_HPP
+
+#include "shape_function.hpp"
+#include "../mesh/enums.hpp"
+#include "../util/assert.hpp"
+#include <vector>
+
+namespace alelib
+{
+
+/** @brief Reference tensors of the mass, Laplace and convection forms of the Lagrange functions of a simplex.
+ *
+ *  On an affine cell, with \f$ |J| \f$ the measure factor of the map and \f$ J^{-1} \f$ its (pseudo-)inverse,
+ *  \f[ \int \phi_a\phi_b = |J| M_{ab},\qquad
+ *      \int \nabla\phi_a\cdot\nabla\phi_b = |J| \sum_{jl} G_{jl} A^{jl}_{ab},\quad G = J^{-1}J^{-T},\qquad
+ *      \int \phi_a\, \bf{u}\cdot\nabla\phi_b = |J| \sum_{cl} \beta^l_c C^{l}_{cab},\quad
+ *      \beta^l_c = \sum_i \partial_i\xi_l\, u_{c,i}, \f]
+ *  where \f$ M, A, C \f$ are integrals in the reference cell and the velocity is interpolated by the same
+ *  functions, \f$ \bf{u} = \sum_c \bf{u}_c\phi_c \f$. So the element matrices are contractions of fixed
+ *  tensors with the geometry of the cell (see CellGeometry or Mesh::enableGeometryCache()), instead of
+ *  quadratures point by point.
+ *
+ *  The functions are the "Lagrange" ones, so the reference cell and J are the ones of CellGeometry
+ *  (EDGE: [-1,1]). The matrices are row-major, <tt>K[a*numDofs() + b]</tt>.
+ *  Instances are computed once per (cell type, degree) by get() and live until the end of the program.
+ */
+class ReferenceTensors
+{
+public:
+
+  /// the tensors of the Lagrange functions of degree \c degree of the simplex \c ct.
+  static ReferenceTensors const& get(ECellType ct, int degree);
+
+  /// \f$ M_{ab} \f$
+  Real const* mass() const
+  { return &m_mass[0]; }
+
+  /// \f$ A^{jl}_{ab} = \int \partial_j\phi_a \partial_l\phi_b \f$
+  Real const* stiffness(int j, int l) const
+  { return &m_stiff[(j*m_dim + l)*m_ndofs*m_ndofs]; }
+
+  /// \f$ C^l_{cab} = \int \phi_c\phi_a \partial_l\phi_b \f$, <tt>convection(l)[(c*numDofs() + a)*numDofs() + b]</tt>
+  Real const* convection(int l) const
+  { return &m_conv[l*m_ndofs*m_ndofs*m_ndofs]; }
+
+  /// @param detJ the measure factor of the map (its absolute value is taken).
+  void massMatrix(Real detJ, Real* M) const;
+
+  /// @param invJ \f$ \partial\xi_j/\partial x_i \f$: <tt>invJ[j*sdim + i]</tt>.
+  void laplaceMatrix(Real detJ, Real const* invJ, int sdim, Real* K) const;
+
+  /// @param u nodal velocities, <tt>u[c*sdim + i]</tt>.
+  void convectionMatrix(Real detJ, Real const* invJ, int sdim, Real const* u, Real* C) const;
+
+  /** @brief Laplace matrices of cells of a mesh, from its geometry cache (Mesh::enableGeometryCache()),
+   *         which must be up to date (Mesh::updateGeometryCache()).
+   *  @param K <tt>K[(k*numDofs() + a)*numDofs() + b]</tt> for the cell <tt>cells[k]</tt>. */
+  template<class MeshT>
+  void laplaceMatrices(MeshT const* mp, typename MeshT::CellH const* cells, int ncells, Real* K) const
+  {
+    int const sd = MeshT::SpaceDim;
+    ALELIB_CHECK(mp->geometryCacheEnabled() && MeshT::CellType == m_cell_type, "invalid mesh", std::invalid_argument);
+    Real const* det = mp->cellDetJacobians();
+    Real const* invJ[9];
+    for (int j = 0; j < m_dim; ++j)
+      for (int i = 0; i < sd; ++i)
+        invJ[j*sd + i] = mp->cellInvJacobians(j, i);
+
+    Real iJ[9];
+    for (int k = 0; k < ncells; ++k)
+    {
+      std::size_t const id = cells[k].id(mp);
+      for (int n = 0; n < m_dim*sd; ++n)
+        iJ[n] = invJ[n][id];
+      laplaceMatrix(det[id], iJ, sd, K + k*m_ndofs*m_ndofs);
+    }
+  }
+
+  int numDofs() const
+  { return m_ndofs; }
+
+  int dim() const
+  { return m_dim; }
+
+  int degree() const
+  { return m_degree; }
+
+  ECellType cellType() const
+  { return m_cell_type; }
+
+  ReferenceTensors(ECellType ct, int degree);
+
+private:
+
+  ECellType m_cell_type;
+  int       m_dim;
+  int       m_degree;
+  int       m_ndofs;
+
+  std::vector<Real> m_mass;      // [a][b]
+  std::vector<Real> m_stiff;     // [j][l][a][b]
+  std::vector<Real> m_stiff_sym; // [j<=l][a][b]: A^{jl} + A^{lj} (A^{jj} if j == l)
+  std::vector<Real> m_conv;      // [l][c][a][b]
+};
+
+} // end namespace alelib
+
+#endif // ALELIB_REFERENCE_TENSORS_HPP
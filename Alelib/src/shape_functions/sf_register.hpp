@@ -10,6 +10,8 @@
 
 /*  !!!!!!~~~~~~~ Include your file here ~~~~~~~!!!!!!!!! */
 #include "shape_types/sf_simplex_lagrange.hpp"
+#include "shape_types/sf_hcube_lagrange.hpp"
+#include "shape_types/sf_simplex_bernstein.hpp"
 #include "shape_types/sf_bubble.hpp"
 #include "shape_types/sf_concatenated.hpp"
 
@@ -36,6 +38,8 @@ std::map<std::string, SfStaticMemFn> init_register()
   // Add here
   reg[SfSimplexLagrange::nameId()] = SfSimplexLagrange::create;
   reg[SfBubble::nameId()]          = SfBubble::create;
+  reg[SfHcubeLagrange::nameId()]   = SfHcubeLagrange::create;
+  reg[SfSimplexBernstein::nameId()] = SfSimplexBernstein::create;
   
   return reg;
 }
@@ -3,6 +3,8 @@
 #include <stdexcept> 
 #include <sstream>
 #include <algorithm>
+#include <memory>
+#include <mutex>
 #include "../util/assert.hpp"
 
 
@@ -22,17 +24,95 @@ namespace alelib
 {
 
 
+namespace
+{
+  struct SfKey
+  {
+    std::string type; // without white spaces
+    int         dim;
+    int         degree;
+
+    bool operator<(SfKey const& o) const
+    {
+      if (dim != o.dim)       return dim < o.dim;
+      if (degree != o.degree) return degree < o.degree;
+      return type < o.type;
+    }
+  };
+
+  // owns the implementations handed out by ShapeFunction::setType; they are deleted at exit
+  struct SfStore
+  {
+    typedef std::map<SfKey, ShapeFuncImpl const*> MapT;
+    MapT       table;
+    std::mutex lock;
+
+    ~SfStore()
+    {
+      for (MapT::iterator it = table.begin(); it != table.end(); ++it)
+        delete it->second;
+    }
+  };
+
+  SfStore& sfStore()
+  {
+    static SfStore store;
+    return store;
+  }
+
+  ShapeFuncImpl* createImpl(std::string const& input, int dim, int degree)
+  {
+    static const std::map<std::string, SfStaticMemFn> registry = init_register();
+    std::map<std::string, SfStaticMemFn>::const_iterator it;
+
+    std::stringstream ss(input);
+    std::vector<std::string> shapes;
+    std::string stmp;
+    std::string type_i;
+    std::vector<std::string> options_i;
+
+    // split user input if it's a concatenation of Shape Functions
+    while(std::getline(ss, stmp, '+'))
+      shapes.push_back(stmp);
+
+    std::unique_ptr<SfConcatenated> impl(new SfConcatenated());
+
+    for (int i = 0; i < (int) shapes.size(); ++i)
+    {
+      // clear ss
+      ss.str(std::string());
+      ss.clear();
+      ss << shapes[i];
+
+      // clear options
+      options_i.clear();
+
+      // splits `shapes` into type and options
+      while(std::getline(ss, stmp, ','))
+        options_i.push_back(stmp);
+      ALELIB_CHECK(!options_i.empty(), "invalid shape function", std::invalid_argument);
+      type_i = options_i[0];
+      options_i.erase(options_i.begin());
+
+      it = registry.find(type_i);
+      ALELIB_CHECK(it != registry.end(), "invalid shape function", std::invalid_argument);
+
+      // create
+      impl->appendSf( (*it).second(options_i, dim, degree) );
+    }
+
+    return impl.release();
+  }
+}
+
+
 ShapeFunction::ShapeFunction() : m_pimpl(0), m_gdisc(false)
 {
 }
 
 ShapeFunction::~ShapeFunction()
 {
-  if (m_pimpl)
-  {
-    delete m_pimpl;
-    m_pimpl = NULL;
-  }
+  // the implementation is owned by the store
 }
 
 bool ShapeFunction::isSet() const
@@ -45,79 +125,42 @@ const char* ShapeFunction::name() const
   return m_pimpl->name();
 }
 
-ShapeFunction::ShapeFunction(ShapeFunction const& cp)
+ShapeFunction::ShapeFunction(ShapeFunction const& cp) : m_pimpl(cp.m_pimpl), m_gdisc(cp.m_gdisc)
 {
-  if (cp.isSet())
-    m_pimpl = cp.m_pimpl->clone();
-  else
-    m_pimpl = 0;
 }
 
 ShapeFunction& ShapeFunction::operator=(ShapeFunction const& cp)
 {
-  if (&cp != this)
-  {
-    delete m_pimpl;
-    m_pimpl = cp.m_pimpl->clone();
-  }
+  m_pimpl = cp.m_pimpl;
+  m_gdisc = cp.m_gdisc;
   return *this;
 }
 
 void ShapeFunction::setType(const char* type, int dim, int degree)
 {
-  static const std::map<std::string, SfStaticMemFn> registry = init_register();
-  std::map<std::string, SfStaticMemFn>::const_iterator it;
-  
-  std::string input(type);
-  
+  SfKey key;
+  key.type   = type;
+  key.dim    = dim;
+  key.degree = degree;
+
   // remove white spaces
-  input.erase(  std::remove(input.begin(), input.end(), ' '), input.end() );
-  
-  std::stringstream ss(input);
-  std::vector<std::string> shapes;
-  std::string stmp;
-  std::string type_i;
-  std::vector<std::string> options_i;
-
-  // split user input if it's a concatenation of Shape Functions
-  while(std::getline(ss, stmp, '+'))
-    shapes.push_back(stmp);
-
-  if (m_pimpl)
-    delete m_pimpl;
-  
-  m_pimpl = new SfConcatenated();
-
-  for (int i = 0; i < (int) shapes.size(); ++i)
-  {
-    // clear ss
-    ss.str(std::string());
-    ss.clear();
-    ss << shapes[i];
-
-    // clear options
-    options_i.clear();
-
-    // splits `shapes` into type and options
-    while(std::getline(ss, stmp, ','))
-      options_i.push_back(stmp);
-    type_i = options_i[0];
-    options_i.erase(options_i.begin());
-    
-    it = registry.find(shapes[i]);
-    ALELIB_CHECK(it != registry.end(), "invalid shape function", std::invalid_argument);
-    
-    // create
-    static_cast<SfConcatenated*>(m_pimpl)->appendSf( (*it).second(options_i, dim, degree) );
-    
-    // TODO
-    
-  }
-  
-  
-  
-  
-  //m_pimpl = new SfSimplexLagrange(2,1,false);
+  key.type.erase(  std::remove(key.type.begin(), key.type.end(), ' '), key.type.end() );
+
+  SfStore& store = sfStore();
+  std::lock_guard<std::mutex> guard(store.lock);
+
+  SfStore::MapT::iterator it = store.table.find(key);
+  if (it == store.table.end())
+    it = store.table.insert(std::make_pair(key, createImpl(key.type, dim, degree))).first;
+
+  m_pimpl = it->second;
+}
+
+int ShapeFunction::numSharedImpls()
+{
+  SfStore& store = sfStore();
+  std::lock_guard<std::mutex> guard(store.lock);
+  return store.table.size();
 }
 
 Real ShapeFunction::value(Real const*x, unsigned ith) const
@@ -129,6 +172,34 @@ Real ShapeFunction::grad(Real const*x, unsigned ith, unsigned c) const
 Real ShapeFunction::hessian(Real const*x, unsigned ith, unsigned c, unsigned d) const
 { return m_pimpl->hessian(x, ith, c, d); }
 
+void ShapeFunction::tabulate(int npts, Real const* pts, int derivative_order, Real* out) const
+{
+  ALELIB_CHECK(derivative_order >= 0 && derivative_order <= 2, "derivative_order must be 0, 1 or 2", std::invalid_argument);
+  if (npts > 0)
+    m_pimpl->tabulate(npts, pts, derivative_order, out);
+}
+
+int ShapeFunction::tabulateSize(int npts, int derivative_order) const
+{
+  int const dim = m_pimpl->dim();
+  int n = npts*m_pimpl->numDofs();
+  for (int k = 0; k < derivative_order; ++k)
+    n *= dim;
+  return n;
+}
+
+void ShapeFunction::tabulateSoA(int npts, Real const* const* xyz, Real* out) const
+{
+  if (npts > 0)
+    m_pimpl->tabulateSoA(npts, xyz, out);
+}
+
+void ShapeFunction::interpolateTensor(int nq, Real const* pts1d, Real const* coefs, Real* vals, Real* grads) const
+{
+  if (nq > 0)
+    m_pimpl->interpolateTensor(nq, pts1d, coefs, vals, grads);
+}
+
 bool ShapeFunction::isTauEquivalent() const
 { return m_pimpl->isTauEquivalent(); }
 
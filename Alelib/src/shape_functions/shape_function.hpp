@@ -35,10 +35,14 @@ class ShapeFuncImpl; // implementation detail
 
 /** @brief An object of this class is a set of shape functions \f$ \{\varphi^{i}\}_{i=1}^{n} \f$
  *         in the master element.
+ *
+ *  It is a light handle: the implementations are immutable and interned, one per
+ *  (type, dim, degree), and live until the program ends. Copies share the same one,
+ *  and so can be passed around and used by several threads at once.
  */ 
 class ShapeFunction
 {
-  ShapeFuncImpl* m_pimpl;
+  ShapeFuncImpl const* m_pimpl;
   bool           m_gdisc; // globally discontinuous
   
 public:
@@ -59,6 +63,8 @@ public:
    *                   - <c> "Lagrange"               </c> Same as above; \n
    *                   - <c> "Lagrange_hcube"         </c> Lagrange shape functions on quads (2d) / hexahedrons (3d); \n
    *                   - <c> "Lagrange,discontinuous" </c> Discontinuous Lagrange shape functions; \n
+   *                   - <c> "Lagrange,generic"       </c> Lagrange functions without the specialized kernels used for degrees 1 to 3; \n
+   *                   - <c> "Bernstein"              </c> Bernstein-Bezier polynomials on simplices; \n
    *                   - <c> "Lagrange + Bubble"      </c> Concatenates a bubble function to Lagrange functions; \n
    *                   - <c> "Bubble + Lagrange"      </c> Same as above, but the bubble function is numbered first; \n
    *                   - <c> "Hermite"                </c> Hermite functions for simplicies; \n
@@ -72,6 +78,9 @@ public:
    */ 
   void setType(const char* type, int dim, int degree = -1);
 
+  /** @brief Number of distinct implementations created so far by \c setType(). */
+  static int numSharedImpls();
+
   /** @brief returns if \c setType() has been called. */ 
   bool isSet() const;
 
@@ -96,6 +105,42 @@ public:
 
   Real hessian(Real const*x, unsigned ith, unsigned c, unsigned d) const;
 
+  /** @brief Evaluates all shape functions, or all their derivatives of a given order, at several points at once.
+   *  @param npts Number of points.
+   *  @param pts The coordinates of the points, \c dim() entries per point.
+   *  @param derivative_order 0 for values, 1 for gradients and 2 for hessians.
+   *  @param[out] out Array with \c tabulateSize(npts,derivative_order) entries, ordered as (point, function, derivative):
+   *              \f$ \varphi^{i}(\bf{x}_p) \f$ is at <tt>out[p*numDofs() + i]</tt>,
+   *              \f$ \partial_c \varphi^{i}(\bf{x}_p) \f$ at <tt>out[(p*numDofs() + i)*dim() + c]</tt> and
+   *              \f$ \partial_c\partial_d \varphi^{i}(\bf{x}_p) \f$ at <tt>out[((p*numDofs() + i)*dim() + c)*dim() + d]</tt>.
+   */
+  void tabulate(int npts, Real const* pts, int derivative_order, Real* out) const;
+
+  /** @brief Returns the number of entries written by \c tabulate(npts, pts, derivative_order, out). */
+  int tabulateSize(int npts, int derivative_order) const;
+
+  /** @brief Evaluates all shape functions at many points given in SoA layout.
+   *  This is the path for large batches of arbitrary points (particles, probes). Lagrange and bubble
+   *  functions use vectorized kernels (AVX2 or AVX-512), chosen at runtime from the CPU features, with
+   *  a scalar fallback.
+   *  @param npts Number of points.
+   *  @param xyz \c xyz[c][p] is the coordinate \c c of the point \c p.
+   *  @param[out] out Array with <tt>npts*numDofs()</tt> entries: \f$ \varphi^{i}(\bf{x}_p) \f$ is at <tt>out[i*npts + p]</tt>.
+   */
+  void tabulateSoA(int npts, Real const* const* xyz, Real* out) const;
+
+  /** @brief Evaluates \f$ u = \sum_i c_i \varphi^{i} \f$ and its gradient at the tensor grid of 1d points.
+   *  The grid has <tt>nq^dim()</tt> points, the first coordinate varying fastest, which is the order used
+   *  by the quadrature rules of quadrangles and hexahedra; \c pts1d can be taken from the \c EDGE rule
+   *  of the same degree. For \c "Lagrange_hcube" the evaluation is sum-factorized.
+   *  @param nq Number of 1d points.
+   *  @param pts1d The 1d points.
+   *  @param coefs The coefficients \f$ c_i \f$, one per function.
+   *  @param[out] vals \f$ u \f$ at each grid point; can be \c NULL.
+   *  @param[out] grads \f$ \partial_c u \f$ at <tt>grads[q*dim() + c]</tt>; can be \c NULL.
+   */
+  void interpolateTensor(int nq, Real const* pts1d, Real const* coefs, Real* vals, Real* grads) const;
+
   bool isTauEquivalent() const;
   bool isLinear() const;
   
@@ -0,0 +1,71 @@
+#include "sf_bubble.hpp"
+#include "../../util/simd.hpp"
+
+namespace alelib
+{
+
+// The vectorized kernels live here rather than in the header: the functions compiled for other
+// targets cannot be inlined into their callers anyway.
+namespace
+{
+  // bubble values at the points [p0,p1), W points at a time (V holds W Reals)
+  template<class V, int W>
+  ALE_FORCE_INLINE void bubbleValuesSoA(int p0, int p1, int dim, Real const* const* x, Real* out)
+  {
+    Real const K = dim==2 ? 27. : 256.;
+    for (int p = p0; p + W <= p1; p += W)
+    {
+      V x0, v;
+      simd::load(x0, x[0] + p);
+      if (dim == 1)
+        v = Real(1.) - x0*x0;
+      else
+      {
+        V w = Real(1.) - x0;
+        v = K*x0;
+        for (int c = 1; c < dim; ++c)
+        {
+          V xc;
+          simd::load(xc, x[c] + p);
+          w = w - xc;
+          v = v*xc;
+        }
+        v = v*w;
+      }
+      simd::store(out + p, v);
+    }
+  }
+
+  void bubbleValuesSoAScalar(int npts, int dim, Real const* const* x, Real* out)
+  { bubbleValuesSoA<Real,1>(0, npts, dim, x, out); }
+
+#ifdef ALE_HAS_SIMD_DISPATCH
+  ALE_TARGET_AVX2 void bubbleValuesSoAAvx2(int npts, int dim, Real const* const* x, Real* out)
+  {
+    int const nv = npts/4*4;
+    bubbleValuesSoA<simd::RealV4,4>(0, nv, dim, x, out);
+    bubbleValuesSoA<Real,1>(nv, npts, dim, x, out);
+  }
+
+  ALE_TARGET_AVX512 void bubbleValuesSoAAvx512(int npts, int dim, Real const* const* x, Real* out)
+  {
+    int const nv = npts/8*8;
+    bubbleValuesSoA<simd::RealV8,8>(0, nv, dim, x, out);
+    bubbleValuesSoA<Real,1>(nv, npts, dim, x, out);
+  }
+#endif
+}
+
+void SfBubble::tabulateSoA(int npts, Real const* const* x, Real* out) const
+{
+  switch (simd::level())
+  {
+#ifdef ALE_HAS_SIMD_DISPATCH
+    case SIMD_AVX512: bubbleValuesSoAAvx512(npts, m_dim, x, out); break;
+    case SIMD_AVX2:   bubbleValuesSoAAvx2(npts, m_dim, x, out);   break;
+#endif
+    default:          bubbleValuesSoAScalar(npts, m_dim, x, out);
+  }
+}
+
+} // end alelib namespace
@@ -12,7 +12,6 @@
 namespace alelib
 {
 
-
 // Every Shape type must inherits this class
 class SfBubble : public ShapeFuncImpl
 {
@@ -128,6 +127,67 @@ public:
     }
   }
 
+  // closed form: with w = 1-sum(x), the bubble is K*x0*...*w and its derivatives
+  // only need products of the coordinates that were not differentiated.
+  virtual void tabulate(int npts, Real const* pts, int derivative_order, Real* out) const
+  {
+    int const dim = m_dim;
+    Real const K = dim==2 ? 27. : 256.;
+
+    for (int p = 0; p < npts; ++p)
+    {
+      Real const* x = pts + p*dim;
+
+      if (dim == 1)
+      {
+        switch (derivative_order)
+        {
+          case 0: *out++ = 1. - x[0]*x[0]; break;
+          case 1: *out++ = -2.*x[0];       break;
+          default: *out++ = -2.;
+        }
+        continue;
+      }
+
+      Real w = 1.;
+      for (int c = 0; c < dim; ++c)
+        w -= x[c];
+
+      if (derivative_order == 0)
+      {
+        Real v = K*w;
+        for (int c = 0; c < dim; ++c)
+          v *= x[c];
+        *out++ = v;
+      }
+      else
+      if (derivative_order == 1)
+      {
+        for (int c = 0; c < dim; ++c)
+        {
+          Real g = K*(w - x[c]);
+          for (int e = 0; e < dim; ++e)
+            if (e != c)
+              g *= x[e];
+          *out++ = g;
+        }
+      }
+      else
+      {
+        for (int c = 0; c < dim; ++c)
+          for (int d = 0; d < dim; ++d)
+          {
+            Real h = c==d ? -2.*K : K*(w - x[c] - x[d]);
+            for (int e = 0; e < dim; ++e)
+              if (e != c && e != d)
+                h *= x[e];
+            *out++ = h;
+          }
+      }
+    }
+  }
+
+  virtual void tabulateSoA(int npts, Real const* const* x, Real* out) const;
 
   virtual bool isTauEquivalent() const
   { return true; }
@@ -1,5 +1,6 @@
 #include "sf_concatenated.hpp"
 #include <stdexcept>
+#include <algorithm>
 
 namespace alelib {
 
@@ -96,6 +97,49 @@ Real SfConcatenated::hessian(Real const*x, unsigned ith, unsigned c, unsigned d)
   return m_parts[nth]->hessian(x, local_ith, c, d);  
 }
 
+// each part tabulates its own functions, which are then interleaved per point
+void SfConcatenated::tabulate(int npts, Real const* pts, int derivative_order, Real* out) const
+{
+  if (m_parts.size() == 1)
+  {
+    m_parts[0]->tabulate(npts, pts, derivative_order, out);
+    return;
+  }
+
+  int const dim = this->dim();
+  int const nd  = derivative_order == 0 ? 1 : (derivative_order == 1 ? dim : dim*dim);
+  std::vector<Real> buf;
+  int offset = 0; // first function of the current part
+
+  for (int n = 0; n < (int)m_parts.size(); ++n)
+  {
+    int const nf = m_parts[n]->numDofs();
+    buf.resize(npts*nf*nd);
+    m_parts[n]->tabulate(npts, pts, derivative_order, buf.data());
+    for (int p = 0; p < npts; ++p)
+      std::copy(buf.begin() + p*nf*nd, buf.begin() + (p+1)*nf*nd, out + (p*m_ndofs + offset)*nd);
+    offset += nf;
+  }
+}
+
+// the output is function-major, so each part fills its own block
+void SfConcatenated::tabulateSoA(int npts, Real const* const* x, Real* out) const
+{
+  for (int n = 0; n < (int)m_parts.size(); ++n)
+  {
+    m_parts[n]->tabulateSoA(npts, x, out);
+    out += npts*m_parts[n]->numDofs();
+  }
+}
+
+void SfConcatenated::interpolateTensor(int nq, Real const* pts1d, Real const* coefs, Real* vals, Real* grads) const
+{
+  if (m_parts.size() == 1)
+    m_parts[0]->interpolateTensor(nq, pts1d, coefs, vals, grads);
+  else
+    ShapeFuncImpl::interpolateTensor(nq, pts1d, coefs, vals, grads);
+}
+
 bool SfConcatenated::isTauEquivalent() const
 {
   bool b = true;
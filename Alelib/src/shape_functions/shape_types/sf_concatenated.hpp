@@ -40,6 +40,9 @@ public:
   virtual Real value(Real const*x, unsigned ith) const;
   virtual Real grad(Real const*x, unsigned ith, unsigned c) const;
   virtual Real hessian(Real const*x, unsigned ith, unsigned c, unsigned d) const;
+  virtual void tabulate(int npts, Real const* pts, int derivative_order, Real* out) const;
+  virtual void tabulateSoA(int npts, Real const* const* x, Real* out) const;
+  virtual void interpolateTensor(int nq, Real const* pts1d, Real const* coefs, Real* vals, Real* grads) const;
 
   virtual bool isTauEquivalent() const;
   virtual bool isLinear() const;
@@ -0,0 +1,381 @@
+#include "../parametric_pts.hpp"
+#include "sf_hcube_lagrange.hpp"
+#include <stdexcept>
+#include <sstream>
+#include <algorithm>
+
+#define ALELIB_HCUBE_LAGRANGE_DEG_LIMIT 30
+
+namespace alelib
+{
+
+namespace
+{
+  // out = M applied along the direction `axis` of `in`, an array with shape[c] entries
+  // in the direction c (the first direction is the fastest). M is nout x shape[axis].
+  void applyAlong(int dim, int const* shape, int axis, Real const* M, int nout, Real const* in, Real* out)
+  {
+    int inner = 1, outer = 1;
+    for (int c = 0; c < axis; ++c)
+      inner *= shape[c];
+    for (int c = axis+1; c < dim; ++c)
+      outer *= shape[c];
+    int const nin = shape[axis];
+
+    for (int o = 0; o < outer; ++o)
+      for (int q = 0; q < nout; ++q)
+      {
+        Real* dst = out + (o*nout + q)*inner;
+        std::fill(dst, dst+inner, 0.);
+        for (int j = 0; j < nin; ++j)
+        {
+          Real const m = M[q*nin + j];
+          Real const* src = in + (o*nin + j)*inner;
+          for (int k = 0; k < inner; ++k)
+            dst[k] += m*src[k];
+        }
+      }
+  }
+}
+
+ShapeFuncImpl* SfHcubeLagrange::create(std::vector<std::string> /*options*/, int dim, int degree)
+{
+  return new Self(dim,degree,0);
+}
+
+SfHcubeLagrange::SfHcubeLagrange(unsigned dim, unsigned degree, bool /*is_disc*/) : m_degree(degree), m_dim(dim)
+{
+  if (dim < 1 || dim > 3)
+    throw std::invalid_argument("SfHcubeLagrange constructor: `dim` must be in 1,2 or 3");
+  if (m_degree > ALELIB_HCUBE_LAGRANGE_DEG_LIMIT)
+    throw std::invalid_argument("SfHcubeLagrange constructor: `degree` exceeded ALELIB_HCUBE_LAGRANGE_DEG_LIMIT");
+
+  m_ndofs = 1;
+  for (unsigned c = 0; c < dim; ++c)
+    m_ndofs *= degree+1;
+
+  Self::computeNodes();
+
+  std::stringstream ss;
+
+  ss << "Lagrange_hcube," << dim << "," << degree;
+
+  m_name = ss.str();
+}
+
+void SfHcubeLagrange::computeNodes()
+{
+  int const n   = Self::degree();
+  int const dim = Self::dim();
+
+  m_nodes1d.resize(n+1);
+  m_weights1d.resize(n+1);
+  if (n == 0)
+    m_nodes1d[0] = 0.;
+  for (int j = 0; j < n+1 && n > 0; ++j)
+    m_nodes1d[j] = -1. + 2.*j/n;
+  for (int j = 0; j < n+1; ++j)
+  {
+    m_weights1d[j] = 1.;
+    for (int m = 0; m < n+1; ++m)
+      if (m != j)
+        m_weights1d[j] /= m_nodes1d[j] - m_nodes1d[m];
+  }
+
+  // the parametric points have coordinates -n, -n+2, ..., n; the 1d node index is (x+n)/2
+  switch (dim)
+  {
+    case 1: genLineParametricPtsINT(n, m_tensor_idx); break;
+    case 2: genQuadParametricPtsINT(n, m_tensor_idx); break;
+    case 3: genHexParametricPtsINT(n, m_tensor_idx);  break;
+  };
+
+  for (int i = 0; i < (int)m_tensor_idx.size(); ++i)
+    m_tensor_idx[i] = (m_tensor_idx[i] + n)/2;
+}
+
+// each polynomial is a product of n factors (x - z_m); its derivatives come by the product rule
+void SfHcubeLagrange::tabulate1d(Real x, Real *B, Real *D, Real *D2) const
+{
+  int const nb = Self::degree()+1;
+
+  for (int j = 0; j < nb; ++j)
+  {
+    Real p = 1., dp = 0., d2p = 0.;
+    for (int m = 0; m < nb; ++m)
+    {
+      if (m == j)
+        continue;
+      Real const f = x - m_nodes1d[m];
+      d2p = d2p*f + 2.*dp;
+      dp  = dp*f + p;
+      p  *= f;
+    }
+    if (B)  B[j]  = p*m_weights1d[j];
+    if (D)  D[j]  = dp*m_weights1d[j];
+    if (D2) D2[j] = d2p*m_weights1d[j];
+  }
+}
+
+Real SfHcubeLagrange::value(Real const*x, unsigned ith) const
+{
+  if (ith >= m_ndofs)
+    throw std::out_of_range("SfHcubeLagrange::value: invalid index");
+
+  Real ret = 1.;
+  Real B[ALELIB_HCUBE_LAGRANGE_DEG_LIMIT+1];
+  for (int e = 0; e < (int)m_dim; ++e)
+  {
+    Self::tabulate1d(x[e], B, NULL, NULL);
+    ret *= B[m_tensor_idx[m_dim*ith + e]];
+  }
+  return ret;
+}
+
+Real SfHcubeLagrange::grad(Real const*x, unsigned ith, unsigned c) const
+{
+  if (ith >= m_ndofs)
+    throw std::out_of_range("SfHcubeLagrange::grad: invalid index");
+
+  Real ret = 1.;
+  Real B[ALELIB_HCUBE_LAGRANGE_DEG_LIMIT+1], D[ALELIB_HCUBE_LAGRANGE_DEG_LIMIT+1];
+  for (int e = 0; e < (int)m_dim; ++e)
+  {
+    Self::tabulate1d(x[e], B, D, NULL);
+    ret *= (e == (int)c ? D : B)[m_tensor_idx[m_dim*ith + e]];
+  }
+  return ret;
+}
+
+Real SfHcubeLagrange::hessian(Real const*x, unsigned ith, unsigned c, unsigned d) const
+{
+  if (ith >= m_ndofs)
+    throw std::out_of_range("SfHcubeLagrange::hessian: invalid index");
+
+  Real ret = 1.;
+  Real B[ALELIB_HCUBE_LAGRANGE_DEG_LIMIT+1], D[ALELIB_HCUBE_LAGRANGE_DEG_LIMIT+1], D2[ALELIB_HCUBE_LAGRANGE_DEG_LIMIT+1];
+  for (int e = 0; e < (int)m_dim; ++e)
+  {
+    Self::tabulate1d(x[e], B, D, D2);
+    int const k = (e == (int)c) + (e == (int)d);
+    ret *= (k == 0 ? B : (k == 1 ? D : D2))[m_tensor_idx[m_dim*ith + e]];
+  }
+  return ret;
+}
+
+// the 1d polynomials are tabulated once per point and direction
+void SfHcubeLagrange::tabulate(int npts, Real const* pts, int derivative_order, Real* out) const
+{
+  int const dim = Self::dim();
+  int const nb  = Self::degree()+1;
+  int const nf  = Self::numDofs();
+
+  if (derivative_order < 0 || derivative_order > 2)
+    throw std::invalid_argument("SfHcubeLagrange::tabulate: `derivative_order` must be 0, 1 or 2");
+
+  // T[k][c][j]: k-th derivative of the j-th 1d polynomial at the coordinate c
+  std::vector<Real> T(3*dim*nb);
+  Real* const T0 = &T[0];
+  Real* const T1 = T0 + dim*nb;
+  Real* const T2 = T1 + dim*nb;
+
+  for (int p = 0; p < npts; ++p)
+  {
+    for (int c = 0; c < dim; ++c)
+      Self::tabulate1d(pts[p*dim + c], T0 + c*nb, T1 + c*nb, derivative_order == 2 ? T2 + c*nb : NULL);
+
+    for (int i = 0; i < nf; ++i)
+    {
+      int const* idx = &m_tensor_idx[dim*i];
+      if (derivative_order == 0)
+      {
+        Real v = 1.;
+        for (int e = 0; e < dim; ++e)
+          v *= T0[e*nb + idx[e]];
+        *out++ = v;
+      }
+      else
+      if (derivative_order == 1)
+      {
+        for (int c = 0; c < dim; ++c)
+        {
+          Real v = 1.;
+          for (int e = 0; e < dim; ++e)
+            v *= (e == c ? T1 : T0)[e*nb + idx[e]];
+          *out++ = v;
+        }
+      }
+      else
+      {
+        for (int c = 0; c < dim; ++c)
+          for (int d = 0; d < dim; ++d)
+          {
+            Real v = 1.;
+            for (int e = 0; e < dim; ++e)
+            {
+              int const k = (e == c) + (e == d);
+              v *= (k == 0 ? T0 : (k == 1 ? T1 : T2))[e*nb + idx[e]];
+            }
+            *out++ = v;
+          }
+      }
+    }
+  }
+}
+
+// Sum factorization: the coefficients are laid out as a (degree+1)^dim tensor and the 1d
+// matrices are applied one direction at a time, which costs O(p^(dim+1)) per output
+// instead of the O(p^(2 dim)) of summing over all the functions at all the points.
+void SfHcubeLagrange::interpolateTensor(int nq, Real const* pts1d, Real const* coefs, Real* vals, Real* grads) const
+{
+  int const dim = Self::dim();
+  int const nb  = Self::degree()+1;
+  int const nf  = Self::numDofs();
+
+  std::vector<Real> B(nq*nb), D(nq*nb);
+  for (int q = 0; q < nq; ++q)
+    Self::tabulate1d(pts1d[q], &B[q*nb], &D[q*nb], NULL);
+
+  int const stride[3] = {1, nb, nb*nb};
+  int nqd = 1, sz = 1; // sz is enough for any partial contraction
+  for (int c = 0; c < dim; ++c)
+  {
+    nqd *= nq;
+    sz  *= std::max(nq, nb);
+  }
+
+  std::vector<Real> U(nf), bufa(sz), bufb(sz);
+  for (int i = 0; i < nf; ++i)
+  {
+    int lex = 0;
+    for (int c = 0; c < dim; ++c)
+      lex += stride[c]*m_tensor_idx[dim*i + c];
+    U[lex] = coefs[i];
+  }
+
+  // which = -1: values; which = c: derivatives in the direction c
+  for (int which = -1; which < (grads ? dim : 0); ++which)
+  {
+    if (which == -1 && !vals)
+      continue;
+
+    int shape[3] = {nb, nb, nb};
+    Real const* in = &U[0];
+    Real* out = &bufa[0];
+    for (int axis = 0; axis < dim; ++axis)
+    {
+      applyAlong(dim, shape, axis, axis == which ? &D[0] : &B[0], nq, in, out);
+      shape[axis] = nq;
+      in  = out;
+      out = (out == &bufa[0]) ? &bufb[0] : &bufa[0];
+    }
+
+    if (which == -1)
+      std::copy(in, in + nqd, vals);
+    else
+      for (int q = 0; q < nqd; ++q)
+        grads[q*dim + which] = in[q];
+  }
+}
+
+const char* SfHcubeLagrange::name() const
+{
+  return m_name.c_str();
+}
+
+// used for Shape Function registration
+const char* SfHcubeLagrange::nameId()
+{
+  return "Lagrange_hcube";
+}
+
+int SfHcubeLagrange::numDofs() const
+{
+  return m_ndofs;
+}
+
+int SfHcubeLagrange::dim() const
+{
+  return m_dim;
+}
+
+int SfHcubeLagrange::numDofsInRidge()  const
+{
+  if (Self::degree() == 0)
+    return 0;
+  switch (Self::dim())
+  {
+    case 1: return 0;
+    case 2: return 1;
+    case 3: return Self::degree()-1;
+  }
+  throw std::runtime_error("SfHcubeLagrange::numDofsInRidge: I should not be here");
+}
+
+int SfHcubeLagrange::numDofsInFacet()   const
+{
+  if (Self::degree() == 0)
+    return 0;
+  switch (Self::dim())
+  {
+    case 1: return 1;
+    case 2: return Self::degree()-1;
+    case 3: return (Self::degree()-1)*(Self::degree()-1);
+  }
+  throw std::runtime_error("SfHcubeLagrange::numDofsInFacet: I should not be here");
+}
+
+int SfHcubeLagrange::numDofsInCell()    const
+{
+  if (Self::degree() == 0)
+    return 1;
+  int n = 1;
+  for (int c = 0; c < Self::dim(); ++c)
+    n *= Self::degree()-1;
+  return n;
+}
+
+int SfHcubeLagrange::numDofsPerVertex() const
+{
+  if (Self::degree() == 0)
+    return 0;
+  return 1;
+}
+
+int SfHcubeLagrange::numDofsPerRidge()  const
+{
+  if (Self::degree() == 0)
+    return 0;
+  switch (Self::dim())
+  {
+    case 1: return 0;
+    case 2: return 1;
+    case 3: return Self::degree()+1;
+  }
+  throw std::runtime_error("SfHcubeLagrange::numDofsPerRidge: I should not be here");
+}
+
+int SfHcubeLagrange::numDofsPerFacet()   const
+{
+  if (Self::degree() == 0)
+    return 0;
+  switch (Self::dim())
+  {
+    case 1: return 1;
+    case 2: return Self::degree()+1;
+    case 3: return (Self::degree()+1)*(Self::degree()+1);
+  }
+  throw std::runtime_error("SfHcubeLagrange::numDofsPerFacet: I should not be here");
+}
+
+SfHcubeLagrange* SfHcubeLagrange::clone() const
+{
+  return new SfHcubeLagrange(*this);
+}
+
+int SfHcubeLagrange::degree() const
+{
+  return m_degree;
+}
+
+} // end alelib namespace
@@ -0,0 +1,82 @@
+#ifndef ALELIB_SF_HCUBE_LAGRANGE
+#define ALELIB_SF_HCUBE_LAGRANGE
+
+#include "shape_impl.hpp"  // the interface
+#include <vector>
+#include <string>
+
+
+namespace alelib
+{
+
+/* Tensor-product Lagrange functions on the reference hypercube [-1,1]^dim (edge, quadrangle, hexahedron).
+ *
+ * The nodes are equally spaced and numbered like the simplices: vertices, then the nodes
+ * inside the edges, then inside the faces (3d), then inside the cell, following the
+ * vertex/edge/face numbering of the mesh. Each function is the product of 1d Lagrange
+ * polynomials, one per direction, whose node indices are stored in `m_tensor_idx`.
+ */
+class SfHcubeLagrange : public ShapeFuncImpl
+{
+  unsigned m_degree;
+  unsigned m_dim;
+  unsigned m_ndofs;
+  std::string m_name;            // contains name and options
+  std::vector<Real> m_nodes1d;   // 1d nodes, increasing
+  std::vector<Real> m_weights1d; // barycentric weights of the 1d nodes
+  std::vector<int>  m_tensor_idx; // m_tensor_idx[dim*i + c] = 1d node of the function i in the direction c
+
+  typedef SfHcubeLagrange Self;
+  typedef ShapeFuncImpl Base;
+
+public:
+
+  SfHcubeLagrange(unsigned dim, unsigned degree, bool is_discontinuous);
+
+  // used for Shape Function registration
+  static const char* nameId();
+  const char* name() const;
+
+  static ShapeFuncImpl* create(std::vector<std::string> options, int dim, int degree);
+
+  virtual Real value(Real const*x, unsigned ith) const;
+  virtual Real grad(Real const*x, unsigned ith, unsigned c) const;
+  virtual Real hessian(Real const*x, unsigned ith, unsigned c, unsigned d) const;
+  virtual void tabulate(int npts, Real const* pts, int derivative_order, Real* out) const;
+  virtual void interpolateTensor(int nq, Real const* pts1d, Real const* coefs, Real* vals, Real* grads) const;
+
+  virtual bool isTauEquivalent() const {return true;}
+  virtual bool isLinear() const {return false;}
+  virtual bool isConforming() const {return m_degree > 0;}
+  virtual bool isInterpolator() const {return true;}
+
+  virtual int numDofs() const;
+  virtual int dim()    const;
+
+  virtual int numDofsInRidge()  const;
+  virtual int numDofsInFacet()   const;
+  virtual int numDofsInCell()    const;
+
+  virtual int numDofsPerVertex() const;
+  virtual int numDofsPerRidge()  const;
+  virtual int numDofsPerFacet()   const;
+
+  virtual SfHcubeLagrange* clone() const;
+
+  int degree() const;
+
+  /** @brief Values and first and second derivatives of the degree+1 1d Lagrange polynomials at x.
+   *  Any output pointer can be NULL. */
+  void tabulate1d(Real x, Real *B, Real *D, Real *D2) const;
+
+private:
+
+  void computeNodes();
+
+};
+
+
+} // namespace alelib
+
+
+#endif // ALELIB_SF_HCUBE_LAGRANGE
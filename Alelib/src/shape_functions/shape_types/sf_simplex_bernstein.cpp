@@ -0,0 +1,575 @@
+#include "../parametric_pts.hpp"
+#include "sf_simplex_bernstein.hpp"
+#include "../../quadrature/quadrature.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <sstream>
+
+#define ALELIB_BERNSTEIN_DEG_LIMIT 30
+
+namespace alelib
+{
+
+namespace
+{
+  // pw[k*ld + j] = L_k^j, j <= maxp[k]
+  void powersL(int nl, int ld, Real const* L, int const* maxp, Real* pw)
+  {
+    for (int k = 0; k < nl; ++k)
+    {
+      pw[k*ld] = 1.;
+      for (int j = 1; j <= maxp[k]; ++j)
+        pw[k*ld + j] = pw[k*ld + j-1]*L[k];
+    }
+  }
+
+  // B[m*ld + j] = B^m_j(t) = m!/(j!(m-j)!) t^j (1-t)^(m-j), j <= m <= n
+  void bernstein1d(int n, Real t, Real* B)
+  {
+    int const ld = n+1;
+    B[0] = 1.;
+    for (int m = 1; m <= n; ++m)
+    {
+      B[m*ld + m] = t*B[(m-1)*ld + m-1];
+      for (int j = m-1; j > 0; --j)
+        B[m*ld + j] = (1.-t)*B[(m-1)*ld + j] + t*B[(m-1)*ld + j-1];
+      B[m*ld] = (1.-t)*B[(m-1)*ld];
+    }
+  }
+
+  // derivatives w.r.t. the barycentric coordinates of the function with multi-index a,
+  // given the powers pw[k*(n+1) + j] = L_k^j; dL has dim+1 entries and HL (dim+1)^2
+  void derivsL(int dim, int n, int const* a, Real multinom, Real const* pw, Real* dL, Real* HL)
+  {
+    int const ld = n+1;
+    int const nl = dim+1;
+
+    if (dL)
+      for (int k = 0; k < nl; ++k)
+      {
+        if (a[k] == 0)
+        {
+          dL[k] = 0.;
+          continue;
+        }
+        Real v = multinom*a[k]*pw[k*ld + a[k]-1];
+        for (int e = 0; e < nl; ++e)
+          if (e != k)
+            v *= pw[e*ld + a[e]];
+        dL[k] = v;
+      }
+
+    if (HL)
+      for (int k = 0; k < nl; ++k)
+        for (int l = 0; l < nl; ++l)
+        {
+          Real v;
+          if (k == l)
+            v = a[k] < 2 ? 0. : multinom*a[k]*(a[k]-1)*pw[k*ld + a[k]-2];
+          else
+            v = (a[k] == 0 || a[l] == 0) ? 0. : multinom*a[k]*a[l]*pw[k*ld + a[k]-1]*pw[l*ld + a[l]-1];
+          for (int e = 0; e < nl && v != 0.; ++e)
+            if (e != k && e != l)
+              v *= pw[e*ld + a[e]];
+          HL[k*nl + l] = v;
+        }
+  }
+}
+
+ShapeFuncImpl* SfSimplexBernstein::create(std::vector<std::string> /*options*/, int dim, int degree)
+{
+  return new Self(dim,degree,0);
+}
+
+SfSimplexBernstein::SfSimplexBernstein(unsigned dim, unsigned degree, bool /*is_disc*/) : m_degree(degree), m_dim(dim)
+{
+  if (dim < 1 || dim > 3)
+    throw std::invalid_argument("SfSimplexBernstein constructor: `dim` must be in 1,2 or 3");
+  if (m_degree > ALELIB_BERNSTEIN_DEG_LIMIT)
+    throw std::invalid_argument("SfSimplexBernstein constructor: `degree` exceeded ALELIB_BERNSTEIN_DEG_LIMIT");
+
+  switch (dim)
+  {
+    case 1: m_ndofs = (degree + 1); break;
+    case 2: m_ndofs = (degree + 1)*(degree + 2)/2; break;
+    case 3: m_ndofs = (degree + 1)*(degree + 2)*(degree + 3)/6; break;
+  };
+
+  Self::computeIndices();
+
+  std::stringstream ss;
+
+  ss << "Bernstein," << dim << "," << degree;
+
+  m_name = ss.str();
+}
+
+// the multi-indices are the integer coordinates of the Lagrange nodes
+void SfSimplexBernstein::computeIndices()
+{
+  int const n   = Self::degree();
+  int const dim = Self::dim();
+  int const nl  = dim+1;
+
+  m_alpha.assign(nl*m_ndofs, 0);
+  m_multinom.assign(m_ndofs, 1.);
+
+  m_fact.assign(2*n + dim + 1, 1.);
+  for (int k = 2; k < (int)m_fact.size(); ++k)
+    m_fact[k] = m_fact[k-1]*k;
+
+  if (n == 0)
+    return;
+
+  std::vector<int> pts;
+  switch (dim)
+  {
+    case 1: genLineParametricPtsINT(n, pts); break;
+    case 2: genTriParametricPtsINT(n, pts);  break;
+    case 3: genTetParametricPtsINT(n, pts);  break;
+  };
+
+  if (dim == 1)
+    for (int i = 0; i < (int)pts.size(); ++i)
+      pts[i] = (pts[i] + n)/2;
+
+  for (int i = 0; i < (int)m_ndofs; ++i)
+  {
+    int* a = &m_alpha[nl*i];
+    a[0] = n;
+    for (int k = 1; k <= dim; ++k)
+    {
+      a[k] = pts[dim*i + k-1];
+      a[0] -= a[k];
+    }
+    m_multinom[i] = m_fact[n];
+    for (int k = 0; k < nl; ++k)
+      m_multinom[i] /= m_fact[a[k]];
+  }
+}
+
+void SfSimplexBernstein::bary(Real const* x, Real* L) const
+{
+  int const dim = Self::dim();
+  if (dim == 1)
+  {
+    L[1] = 0.5*(1. + x[0]);
+    L[0] = 1. - L[1];
+    return;
+  }
+  L[0] = 1.;
+  for (int k = 1; k <= dim; ++k)
+  {
+    L[k] = x[k-1];
+    L[0] -= L[k];
+  }
+}
+
+// only the powers of the single product B_ith are computed
+Real SfSimplexBernstein::value(Real const*x, unsigned ith) const
+{
+  if (ith >= m_ndofs)
+    throw std::out_of_range("SfSimplexBernstein::value: invalid index");
+
+  int const nl = Self::dim()+1;
+  int const* a = &m_alpha[nl*ith];
+  Real L[4];
+  Self::bary(x, L);
+
+  Real v = m_multinom[ith];
+  for (int k = 0; k < nl; ++k)
+    for (int j = 0; j < a[k]; ++j)
+      v *= L[k];
+  return v;
+}
+
+Real SfSimplexBernstein::grad(Real const*x, unsigned ith, unsigned c) const
+{
+  if (ith >= m_ndofs)
+    throw std::out_of_range("SfSimplexBernstein::grad: invalid index");
+
+  int const n  = Self::degree();
+  int const nl = Self::dim()+1;
+  int const* a = &m_alpha[nl*ith];
+  Real L[4], dL[4], pw[4*(ALELIB_BERNSTEIN_DEG_LIMIT+1)];
+  Self::bary(x, L);
+  powersL(nl, n+1, L, a, pw);
+
+  derivsL(nl-1, n, a, m_multinom[ith], pw, dL, NULL);
+  return (dL[c+1] - dL[0])*(nl == 2 ? 0.5 : 1.);
+}
+
+Real SfSimplexBernstein::hessian(Real const*x, unsigned ith, unsigned c, unsigned d) const
+{
+  if (ith >= m_ndofs)
+    throw std::out_of_range("SfSimplexBernstein::hessian: invalid index");
+
+  int const n  = Self::degree();
+  int const nl = Self::dim()+1;
+  int const* a = &m_alpha[nl*ith];
+  Real L[4], HL[16], pw[4*(ALELIB_BERNSTEIN_DEG_LIMIT+1)];
+  Self::bary(x, L);
+  powersL(nl, n+1, L, a, pw);
+
+  derivsL(nl-1, n, a, m_multinom[ith], pw, NULL, HL);
+  return (HL[(c+1)*nl + d+1] - HL[(c+1)*nl] - HL[d+1] + HL[0])*(nl == 2 ? 0.25 : 1.);
+}
+
+// the powers of the barycentric coordinates are computed once per point
+void SfSimplexBernstein::tabulate(int npts, Real const* pts, int derivative_order, Real* out) const
+{
+  int const n   = Self::degree();
+  int const dim = Self::dim();
+  int const nl  = dim+1;
+  int const nf  = Self::numDofs();
+  Real const scale = dim == 1 ? 0.5 : 1.;
+
+  if (derivative_order < 0 || derivative_order > 2)
+    throw std::invalid_argument("SfSimplexBernstein::tabulate: `derivative_order` must be 0, 1 or 2");
+
+  int const maxp[4] = {n, n, n, n};
+  Real L[4], dL[4], HL[16], pw[4*(ALELIB_BERNSTEIN_DEG_LIMIT+1)];
+
+  for (int p = 0; p < npts; ++p)
+  {
+    Self::bary(pts + p*dim, L);
+    powersL(nl, n+1, L, maxp, pw);
+
+    for (int i = 0; i < nf; ++i)
+    {
+      int const* a = &m_alpha[nl*i];
+      if (derivative_order == 0)
+      {
+        Real v = m_multinom[i];
+        for (int k = 0; k < nl; ++k)
+          v *= pw[k*(n+1) + a[k]];
+        *out++ = v;
+      }
+      else
+      if (derivative_order == 1)
+      {
+        derivsL(dim, n, a, m_multinom[i], pw, dL, NULL);
+        for (int c = 0; c < dim; ++c)
+          *out++ = (dL[c+1] - dL[0])*scale;
+      }
+      else
+      {
+        derivsL(dim, n, a, m_multinom[i], pw, NULL, HL);
+        for (int c = 0; c < dim; ++c)
+          for (int d = 0; d < dim; ++d)
+            *out++ = (HL[(c+1)*nl + d+1] - HL[(c+1)*nl] - HL[d+1] + HL[0])*scale*scale;
+      }
+    }
+  }
+}
+
+// The coefficients are stored in a dense (p+1)^dim array indexed by a_1..a_dim (a_0 is implied
+// by the level r). Each level r -> r-1 replaces c_b by sum_k L_k c_{b+e_k}; since b+e_k comes
+// after b in that array, it can be done in place. Total cost O(p^(dim+1)).
+Real SfSimplexBernstein::deCasteljau(Real const* x, Real const* coefs) const
+{
+  int const n   = Self::degree();
+  int const dim = Self::dim();
+  int const nl  = dim+1;
+  int const ld  = n+1;
+
+  if (n == 0)
+    return coefs[0];
+
+  int const stride[3] = {1, ld, ld*ld};
+  int sz = 1;
+  for (int c = 0; c < dim; ++c)
+    sz *= ld;
+
+  std::vector<Real> C(sz, 0.);
+  for (int i = 0; i < (int)m_ndofs; ++i)
+  {
+    int pos = 0;
+    for (int k = 1; k < nl; ++k)
+      pos += stride[k-1]*m_alpha[nl*i + k];
+    C[pos] = coefs[i];
+  }
+
+  Real L[4];
+  Self::bary(x, L);
+
+  for (int r = n; r > 0; --r)
+  {
+    for (int pos = 0; pos < sz; ++pos)
+    {
+      int sum = 0;
+      for (int c = 0, q = pos; c < dim; ++c, q /= ld)
+        sum += q % ld;
+      if (sum > r-1)
+        continue;
+      Real v = L[0]*C[pos];
+      for (int k = 1; k < nl; ++k)
+        v += L[k]*C[pos + stride[k-1]];
+      C[pos] = v;
+    }
+  }
+
+  return C[0];
+}
+
+// With t_k = (1 + x_k)/2 the 1d coordinates of the direction k of the collapsed rule (fastest first),
+//
+//   L_dim = t_dim,  L_{dim-1} = t_{dim-1}(1 - t_dim),  ...,  L_0 = (1 - t_1)...(1 - t_dim),
+//
+// and B_a = B^n_{a_dim}(t_dim) B^{n-a_dim}_{a_{dim-1}}(t_{dim-1}) ... B^{a_0+a_1}_{a_1}(t_1), so the
+// sums over the points are done from the outer direction to the inner one: each step adds one index
+// of a and removes one direction of points. In 1d and 2d the missing outer directions have the single
+// point t = 0 (as igetQuadrPtsCollapsed does), where only the index 0 survives.
+void SfSimplexBernstein::moments(Real vol, int order, Real const* f, Real* mu) const
+{
+  int const n   = Self::degree();
+  int const dim = Self::dim();
+  int const nl  = dim+1;
+  int const ld  = n+1;
+  int const q1  = order/2 + 1;
+
+  int q[3];
+  std::vector<Real> t[3], w[3], B[3];
+  for (int r = 0; r < 3; ++r)
+  {
+    if (r >= dim)
+    {
+      t[r].assign(1, -1.);
+      w[r].assign(1, 1.);
+    }
+    else
+    if (dim == 1)
+      Quadrature::gaussRule1d(q1, t[r], w[r]);
+    else
+      Quadrature::gaussJacobiRule1d(q1, r, t[r], w[r]);
+    q[r] = t[r].size();
+
+    Real sum = 0.;
+    for (int i = 0; i < q[r]; ++i)
+      sum += w[r][i];
+    B[r].assign(q[r]*ld*ld, 0.);
+    for (int i = 0; i < q[r]; ++i)
+    {
+      w[r][i] /= sum;
+      bernstein1d(n, 0.5*(1. + t[r][i]), &B[r][i*ld*ld]);
+    }
+  }
+
+  int const n3 = dim > 2 ? n : 0;
+  int const n2 = dim > 1 ? n : 0;
+
+  // F1[(i + q0 j)*ld + a3] = sum_k w_k B^n_a3(t3_k) f(i,j,k)
+  std::vector<Real> F1(q[0]*q[1]*ld, 0.);
+  for (int k = 0; k < q[2]; ++k)
+    for (int ij = 0; ij < q[0]*q[1]; ++ij)
+    {
+      Real const fk = w[2][k]*f[ij + q[0]*q[1]*k];
+      for (int a3 = 0; a3 <= n3; ++a3)
+        F1[ij*ld + a3] += B[2][(k*ld + n)*ld + a3]*fk;
+    }
+
+  // F2[(i*ld + a3)*ld + a2] = sum_j w_j B^(n-a3)_a2(t2_j) F1[i,j][a3]
+  std::vector<Real> F2(q[0]*ld*ld, 0.);
+  for (int i = 0; i < q[0]; ++i)
+    for (int j = 0; j < q[1]; ++j)
+      for (int a3 = 0; a3 <= n3; ++a3)
+      {
+        Real const fj = w[1][j]*F1[(i + q[0]*j)*ld + a3];
+        Real const* Bj = &B[1][(j*ld + n-a3)*ld];
+        for (int a2 = 0; a2 <= std::min(n2, n-a3); ++a2)
+          F2[(i*ld + a3)*ld + a2] += Bj[a2]*fj;
+      }
+
+  // mu[a1 + ld*(a2 + ld*a3)] = sum_i w_i B^(n-a3-a2)_a1(t1_i) F2[i][a3,a2]
+  std::vector<Real> M(ld*ld*ld, 0.);
+  for (int i = 0; i < q[0]; ++i)
+    for (int a3 = 0; a3 <= n3; ++a3)
+      for (int a2 = 0; a2 <= std::min(n2, n-a3); ++a2)
+      {
+        Real const fi = w[0][i]*F2[(i*ld + a3)*ld + a2];
+        Real const* Bi = &B[0][(i*ld + n-a3-a2)*ld];
+        for (int a1 = 0; a1 <= n-a3-a2; ++a1)
+          M[a1 + ld*(a2 + ld*a3)] += Bi[a1]*fi;
+      }
+
+  for (int i = 0; i < (int)m_ndofs; ++i)
+  {
+    int const* a = &m_alpha[nl*i];
+    int pos = 0;
+    for (int k = dim; k >= 1; --k)
+      pos = pos*ld + a[k];
+    mu[i] = vol*M[pos];
+  }
+}
+
+// int_T B^n_a B^n_b = vol * (n!)^2 d! / (2n+d)! * prod_k (a_k+b_k)!/(a_k! b_k!)
+Real SfSimplexBernstein::massEntry(Real vol, int n, int const* a, int const* b) const
+{
+  int const dim = Self::dim();
+  Real v = vol*m_fact[n]*m_fact[n]*m_fact[dim]/m_fact[2*n + dim];
+  for (int k = 0; k <= dim; ++k)
+    v *= m_fact[a[k]+b[k]]/(m_fact[a[k]]*m_fact[b[k]]);
+  return v;
+}
+
+void SfSimplexBernstein::massMatrix(Real vol, Real* M) const
+{
+  int const nl = Self::dim()+1;
+  int const nf = Self::numDofs();
+
+  for (int i = 0; i < nf; ++i)
+    for (int j = 0; j < nf; ++j)
+      M[i*nf + j] = massEntry(vol, Self::degree(), &m_alpha[nl*i], &m_alpha[nl*j]);
+}
+
+// grad B^n_a = n sum_k B^{n-1}_{a-e_k} grad L_k, so every entry is a combination of
+// mass entries of degree n-1
+void SfSimplexBernstein::stiffnessMatrix(Real vol, Real const* gradL, int sdim, Real* K) const
+{
+  int const n  = Self::degree();
+  int const nl = Self::dim()+1;
+  int const nf = Self::numDofs();
+
+  Real G[16]; // gradL_k . gradL_l
+  for (int k = 0; k < nl; ++k)
+    for (int l = 0; l < nl; ++l)
+    {
+      G[k*nl + l] = 0.;
+      for (int c = 0; c < sdim; ++c)
+        G[k*nl + l] += gradL[k*sdim + c]*gradL[l*sdim + c];
+    }
+
+  int a[4], b[4];
+  for (int i = 0; i < nf; ++i)
+    for (int j = 0; j < nf; ++j)
+    {
+      Real v = 0.;
+      for (int k = 0; k < nl && n > 0; ++k)
+      {
+        if (m_alpha[nl*i + k] == 0)
+          continue;
+        std::copy(&m_alpha[nl*i], &m_alpha[nl*i] + nl, a);
+        --a[k];
+        for (int l = 0; l < nl; ++l)
+        {
+          if (m_alpha[nl*j + l] == 0)
+            continue;
+          std::copy(&m_alpha[nl*j], &m_alpha[nl*j] + nl, b);
+          --b[l];
+          v += G[k*nl + l]*massEntry(vol, n-1, a, b);
+        }
+      }
+      K[i*nf + j] = n*n*v;
+    }
+}
+
+void SfSimplexBernstein::multiIndex(unsigned ith, int *a) const
+{
+  int const nl = Self::dim()+1;
+  std::copy(&m_alpha[nl*ith], &m_alpha[nl*ith] + nl, a);
+}
+
+const char* SfSimplexBernstein::name() const
+{
+  return m_name.c_str();
+}
+
+// used for Shape Function registration
+const char* SfSimplexBernstein::nameId()
+{
+  return "Bernstein";
+}
+
+int SfSimplexBernstein::numDofs() const
+{
+  return m_ndofs;
+}
+
+int SfSimplexBernstein::dim() const
+{
+  return m_dim;
+}
+
+int SfSimplexBernstein::numDofsInRidge()  const
+{
+  if (Self::degree() == 0)
+    return 0;
+  switch (Self::dim())
+  {
+    case 1: return 0;
+    case 2: return 1;
+    case 3: return Self::degree()-1;
+  }
+  throw std::runtime_error("SfSimplexBernstein::numDofsInRidge: I should not be here");
+}
+
+int SfSimplexBernstein::numDofsInFacet()   const
+{
+  if (Self::degree() == 0)
+    return 0;
+  switch (Self::dim())
+  {
+    case 1: return 1;
+    case 2: return Self::degree()-1;
+    case 3: return (Self::degree()-1)*(Self::degree()-2)/2;
+  }
+  throw std::runtime_error("SfSimplexBernstein::numDofsInFacet: I should not be here");
+}
+
+int SfSimplexBernstein::numDofsInCell()    const
+{
+  if (Self::degree() == 0)
+    return 1;
+  switch (Self::dim())
+  {
+    case 1: return Self::degree()-1;
+    case 2: return (Self::degree()-1)*(Self::degree()-2)/2;
+    case 3: return (Self::degree()-1)*(Self::degree()-2)*(Self::degree()-3)/6;
+  }
+  throw std::runtime_error("SfSimplexBernstein::numDofsInCell: I should not be here");
+}
+
+int SfSimplexBernstein::numDofsPerVertex() const
+{
+  if (Self::degree() == 0)
+    return 0;
+  return 1;
+}
+
+int SfSimplexBernstein::numDofsPerRidge()  const
+{
+  if (Self::degree() == 0)
+    return 0;
+  switch (Self::dim())
+  {
+    case 1: return 0;
+    case 2: return 1;
+    case 3: return Self::degree()+1;
+  }
+  throw std::runtime_error("SfSimplexBernstein::numDofsPerRidge: I should not be here");
+}
+
+int SfSimplexBernstein::numDofsPerFacet()   const
+{
+  if (Self::degree() == 0)
+    return 0;
+  switch (Self::dim())
+  {
+    case 1: return 1;
+    case 2: return Self::degree()+1;
+    case 3: return (Self::degree()+1)*(Self::degree()+2)/2;
+  }
+  throw std::runtime_error("SfSimplexBernstein::numDofsPerFacet: I should not be here");
+}
+
+SfSimplexBernstein* SfSimplexBernstein::clone() const
+{
+  return new SfSimplexBernstein(*this);
+}
+
+int SfSimplexBernstein::degree() const
+{
+  return m_degree;
+}
+
+} // end alelib namespace
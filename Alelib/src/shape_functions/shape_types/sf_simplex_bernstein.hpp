@@ -0,0 +1,117 @@
+#ifndef ALELIB_SF_SIMPLEX_BERNSTEIN
+#define ALELIB_SF_SIMPLEX_BERNSTEIN
+
+#include "shape_impl.hpp"  // the interface
+#include <vector>
+#include <string>
+
+
+namespace alelib
+{
+
+/* Bernstein-Bezier polynomials on simplices:
+ *
+ *    B_a = p!/(a_0! ... a_d!) L_0^a_0 ... L_d^a_d,   |a| = p,
+ *
+ * where L_k are the barycentric coordinates. The multi-indices a are numbered like the
+ * nodes of SfSimplexLagrange of the same degree (B_a is "attached" to the lattice point a/p),
+ * so the dofs are distributed among vertices, ridges, facets and cell the same way and
+ * reorderDofsLagrange() gives the orientation of shared entities.
+ *
+ * Besides the usual interface, it has the algorithms that make the basis attractive at
+ * high order: de Casteljau evaluation of a polynomial in O(p^(d+1)), sum-factorized moments
+ * in O(p^(d+1)), and closed-form mass and stiffness matrices on affine simplices, computed
+ * without quadrature.
+ */
+class SfSimplexBernstein : public ShapeFuncImpl
+{
+  unsigned m_degree;
+  unsigned m_dim;
+  unsigned m_ndofs;
+  std::string m_name;          // contains name and options
+  std::vector<int>  m_alpha;   // m_alpha[(dim+1)*i + k] = k-th index of the function i
+  std::vector<Real> m_multinom; // p!/a!
+  std::vector<Real> m_fact;     // m_fact[k] = k!, k <= 2p+dim
+
+  typedef SfSimplexBernstein Self;
+  typedef ShapeFuncImpl Base;
+
+public:
+
+  SfSimplexBernstein(unsigned dim, unsigned degree, bool is_discontinuous);
+
+  // used for Shape Function registration
+  static const char* nameId();
+  const char* name() const;
+
+  static ShapeFuncImpl* create(std::vector<std::string> options, int dim, int degree);
+
+  virtual Real value(Real const*x, unsigned ith) const;
+  virtual Real grad(Real const*x, unsigned ith, unsigned c) const;
+  virtual Real hessian(Real const*x, unsigned ith, unsigned c, unsigned d) const;
+  virtual void tabulate(int npts, Real const* pts, int derivative_order, Real* out) const;
+
+  virtual bool isTauEquivalent() const {return true;}
+  virtual bool isLinear() const {return m_degree == 1;}
+  virtual bool isConforming() const {return m_degree > 0;}
+  virtual bool isInterpolator() const {return m_degree <= 1;}
+
+  virtual int numDofs() const;
+  virtual int dim()    const;
+
+  virtual int numDofsInRidge()  const;
+  virtual int numDofsInFacet()   const;
+  virtual int numDofsInCell()    const;
+
+  virtual int numDofsPerVertex() const;
+  virtual int numDofsPerRidge()  const;
+  virtual int numDofsPerFacet()   const;
+
+  virtual SfSimplexBernstein* clone() const;
+
+  int degree() const;
+
+  /** @brief the multi-index of the function ith; \c a has dim()+1 entries. */
+  void multiIndex(unsigned ith, int *a) const;
+
+  /** @brief Evaluates \f$ \sum_i c_i B_i(x) \f$ by the de Casteljau algorithm. */
+  Real deCasteljau(Real const* x, Real const* coefs) const;
+
+  /** @brief Moments \f$ \mu_i = \int_T f B_i \f$ over a simplex of measure \c vol, by sum factorization.
+   *
+   *  In the collapsed coordinates of the Gauss-Jacobi rules every \f$ B_i \f$ is a product of 1d Bernstein
+   *  polynomials, so the sums over the points are done one direction at a time, in O(p^(dim+1)) for
+   *  about p points per direction instead of O(p^(2 dim)).
+   *  @param order the rule is exact when \f$ f B_i \f$ is a polynomial of this degree.
+   *  @param f values of f at the points of Quadrature::igetQuadrPtsCollapsed(order, dim()), in that
+   *           order (at the points of Quadrature::igetQuadrPtsHypercube(order, 1) in 1d).
+   *  @param[out] mu numDofs() entries. */
+  void moments(Real vol, int order, Real const* f, Real* mu) const;
+
+  /** @brief Mass matrix \f$ \int_T B_i B_j \f$ of an affine simplex of measure \c vol,
+   *         row-major with numDofs()^2 entries. */
+  void massMatrix(Real vol, Real* M) const;
+
+  /** @brief Stiffness matrix \f$ \int_T \nabla B_i\cdot\nabla B_j \f$ of an affine simplex.
+   *  @param vol measure of the simplex.
+   *  @param gradL gradients of its barycentric coordinates: <tt>gradL[k*sdim + c]</tt>, k = 0..dim().
+   *  @param sdim spatial dimension.
+   *  @param[out] K row-major, numDofs()^2 entries. */
+  void stiffnessMatrix(Real vol, Real const* gradL, int sdim, Real* K) const;
+
+private:
+
+  void computeIndices();
+
+  // barycentric coordinates and d(L_k)/dx_c scale (1/2 in 1d)
+  void bary(Real const* x, Real* L) const;
+
+  // integral over the simplex of measure vol of B^n_a B^n_b
+  Real massEntry(Real vol, int n, int const* a, int const* b) const;
+};
+
+
+} // namespace alelib
+
+
+#endif // ALELIB_SF_SIMPLEX_BERNSTEIN
@@ -1,24 +1,24 @@
 #include "../parametric_pts.hpp" // probably you will need to include this
 
 #include "sf_simplex_lagrange.hpp"
+#include "sf_simplex_lagrange_fixed.hpp"
+#include "../../util/simd.hpp"
+#include <algorithm>
 #include <stdexcept>
 #include <cstdlib> // atoi
 #include <cmath>
-#include <Ead/ead.hpp>
-#include <Ead/ead2.hpp>
 #include <sstream>
 
 #define ALELIB_LAGRANGE_DEG_LIMIT 30
+#define ALELIB_LAGRANGE_TAB_SIZE (4*(ALELIB_LAGRANGE_DEG_LIMIT+1)) // size of the factor tables
 
 namespace alelib
 {
 
+// barycentric coordinates of the point x_; in 1d, x_ is first rescaled from [-1,1] to [0,1]
 template<class Scalar>
-Scalar lagrange(Scalar const*x_, unsigned ith, int degree, int dim, std::vector<long int> const& m_denominator, std::vector<int>const& m_integer_pts)
+void lagrangeBary(Scalar const*x_, int dim, Scalar *L)
 {
-  if (degree == 0)
-    return Scalar(1.);
-
   Scalar x[3];
   for (int i = 0; i < dim; ++i)
     x[i] = x_[i];
@@ -26,19 +26,26 @@ Scalar lagrange(Scalar const*x_, unsigned ith, int degree, int dim, std::vector<
   if (dim==1) // rescale
     x[0] = 0.5*(1.+x[0]);
 
-  Scalar L[4]; // barycentric coordinates
   L[0] = 1.;
   for (int k = 1; k <= dim; ++k)
   {
     L[k] = x[k-1];
     L[0] -= L[k];
   }
+}
+
+// the ith lagrange function evaluated from the barycentric coordinates L
+template<class Scalar>
+Scalar lagrangeFromBary(Scalar const*L, unsigned ith, int degree, int dim, std::vector<long int> const& m_denominator, std::vector<int>const& m_integer_pts)
+{
+  if (degree == 0)
+    return Scalar(1.);
 
   int sup[4]; // final index in the products of sequences
   sup[0] = degree;
   for (int k = 1; k <= dim; ++k)
   {
-    sup[k] = m_integer_pts.at(dim*ith + k-1);
+    sup[k] = m_integer_pts[dim*ith + k-1];
     sup[0] -= sup[k];
   }
 
@@ -58,15 +65,109 @@ Scalar lagrange(Scalar const*x_, unsigned ith, int degree, int dim, std::vector<
   }
 
   
-  numerator /= m_denominator.at(ith);
+  numerator /= m_denominator[ith];
 
 
   return numerator;
 }
 
+template<class Scalar>
+Scalar lagrange(Scalar const*x_, unsigned ith, int degree, int dim, std::vector<long int> const& m_denominator, std::vector<int>const& m_integer_pts)
+{
+  if (degree == 0)
+    return Scalar(1.);
+
+  Scalar L[4]; // barycentric coordinates
+  lagrangeBary(x_, dim, L);
+
+  return lagrangeFromBary(L, ith, degree, dim, m_denominator, m_integer_pts);
+}
+
+
+// Degrees 1 to 3 get the compile-time specialized kernels, unless the option "generic" is given.
+namespace
+{
+  // Values of all functions at the points [p0,p1), W points at a time (V holds W Reals).
+  // sup holds the 4 integer barycentric coordinates of each node.
+  template<class V, int W>
+  ALE_FORCE_INLINE void lagrangeValuesSoA(int p0, int p1, int npts, int dim, int n, int nf,
+                                          int const* sup, Real const* inv_denom, Real const* const* x, Real* out)
+  {
+    V const zero = V();
+    V P[4][ALELIB_LAGRANGE_DEG_LIMIT+1];
+
+    for (int p = p0; p + W <= p1; p += W)
+    {
+      V L[4];
+      if (dim == 1)
+      {
+        simd::load(L[1], x[0] + p);
+        L[1] = Real(0.5)*(Real(1.) + L[1]);
+        L[0] = Real(1.) - L[1];
+      }
+      else
+      {
+        L[0] = zero + Real(1.);
+        for (int k = 1; k <= dim; ++k)
+        {
+          simd::load(L[k], x[k-1] + p);
+          L[0] = L[0] - L[k];
+        }
+      }
+
+      for (int k = 0; k <= dim; ++k)
+      {
+        P[k][0] = zero + Real(1.);
+        for (int s = 0; s < n; ++s)
+          P[k][s+1] = P[k][s]*(Real(n)*L[k] - Real(s));
+      }
+
+      for (int i = 0; i < nf; ++i)
+      {
+        V v = P[0][sup[4*i]]*inv_denom[i];
+        for (int k = 1; k <= dim; ++k)
+          v = v*P[k][sup[4*i + k]];
+        simd::store(out + i*npts + p, v);
+      }
+    }
+  }
+
+  #define ALE_LAGRANGE_SOA_ARGS int npts, int dim, int n, int nf, int const* sup, Real const* inv_denom, Real const* const* x, Real* out
+
+  void lagrangeValuesSoAScalar(ALE_LAGRANGE_SOA_ARGS)
+  {
+    lagrangeValuesSoA<Real,1>(0, npts, npts, dim, n, nf, sup, inv_denom, x, out);
+  }
+
+#ifdef ALE_HAS_SIMD_DISPATCH
+  ALE_TARGET_AVX2 void lagrangeValuesSoAAvx2(ALE_LAGRANGE_SOA_ARGS)
+  {
+    int const nv = npts/4*4;
+    lagrangeValuesSoA<simd::RealV4,4>(0, nv, npts, dim, n, nf, sup, inv_denom, x, out);
+    lagrangeValuesSoA<Real,1>(nv, npts, npts, dim, n, nf, sup, inv_denom, x, out);
+  }
+
+  ALE_TARGET_AVX512 void lagrangeValuesSoAAvx512(ALE_LAGRANGE_SOA_ARGS)
+  {
+    int const nv = npts/8*8;
+    lagrangeValuesSoA<simd::RealV8,8>(0, nv, npts, dim, n, nf, sup, inv_denom, x, out);
+    lagrangeValuesSoA<Real,1>(nv, npts, npts, dim, n, nf, sup, inv_denom, x, out);
+  }
+#endif
+
+  #undef ALE_LAGRANGE_SOA_ARGS
+}
 
-ShapeFuncImpl* SfSimplexLagrange::create(std::vector<std::string> /*options*/, int dim, int degree)
+ShapeFuncImpl* SfSimplexLagrange::create(std::vector<std::string> options, int dim, int degree)
 {
+  if (std::find(options.begin(), options.end(), std::string("generic")) == options.end())
+  {
+    #define ALE_LAGRANGE_FIXED_CASE(D,N) if (dim==D && degree==N) return new SfSimplexLagrangeFixed<D,N>();
+    ALE_LAGRANGE_FIXED_CASE(1,1) ALE_LAGRANGE_FIXED_CASE(1,2) ALE_LAGRANGE_FIXED_CASE(1,3)
+    ALE_LAGRANGE_FIXED_CASE(2,1) ALE_LAGRANGE_FIXED_CASE(2,2) ALE_LAGRANGE_FIXED_CASE(2,3)
+    ALE_LAGRANGE_FIXED_CASE(3,1) ALE_LAGRANGE_FIXED_CASE(3,2) ALE_LAGRANGE_FIXED_CASE(3,3)
+    #undef ALE_LAGRANGE_FIXED_CASE
+  }
   return new Self(dim,degree,0);
 }
 
@@ -147,6 +248,15 @@ void SfSimplexLagrange::computeDenominators()
 
   }
 
+  // the tables of the vectorized kernels, so tabulateSoA needs no scratch
+  m_soa_sup.assign(4*m_denominator.size(), 0);
+  m_inv_denom.resize(m_denominator.size());
+  for (int i = 0; i < (int)m_denominator.size(); ++i)
+  {
+    Self::nodeIndices(i, &m_soa_sup[4*i]);
+    m_inv_denom[i] = 1./m_denominator[i];
+  }
+
 }
 
 Real SfSimplexLagrange::value(Real const*x_, unsigned ith) const
@@ -167,55 +277,212 @@ Real SfSimplexLagrange::value(Real const*x_, unsigned ith) const
 Real SfSimplexLagrange::grad(Real const*x_, unsigned ith, unsigned c) const
 {
   const int n_dofs = Self::numDofs();
-  const int degree = Self::degree();
+
+  if (ith >= (unsigned)n_dofs)
+    throw std::out_of_range("SfSimplexLagrange::value: invalid index");
+
+  Real P[ALELIB_LAGRANGE_TAB_SIZE], dP[ALELIB_LAGRANGE_TAB_SIZE];
+  Real g[3];
+
+  Self::factorTables(x_, P, dP, NULL);
+  Self::gradFromTables(ith, P, dP, g);
+
+  return g[c];
+}
+
+Real SfSimplexLagrange::hessian(Real const*x_, unsigned ith, unsigned c, unsigned d) const
+{
+  const int n_dofs = Self::numDofs();
   const int dim    = Self::dim();
 
   if (ith >= (unsigned)n_dofs)
     throw std::out_of_range("SfSimplexLagrange::value: invalid index");
 
-  typedef ead::DFad<Real, 3> adouble;
+  Real P[ALELIB_LAGRANGE_TAB_SIZE], dP[ALELIB_LAGRANGE_TAB_SIZE], d2P[ALELIB_LAGRANGE_TAB_SIZE];
+  Real h[9];
 
-  adouble x[3];
-  
-  for (int i = 0; i < dim; ++i)
+  Self::factorTables(x_, P, dP, d2P);
+  Self::hessianFromTables(ith, P, dP, d2P, h);
+
+  return h[c*dim + d];
+}
+
+// Each function is a product over the barycentric coordinates L_k of the factors
+// P_k(s) = (n*L_k)(n*L_k-1)...(n*L_k-s+1), s being the k-th integer coordinate of
+// the function's node. The tables hold P_k(s) for all k and s <= n, with their first and
+// second derivatives w.r.t. L_k, so that a point's tables serve all the functions.
+void SfSimplexLagrange::factorTables(Real const*x, Real *P, Real *dP, Real *d2P) const
+{
+  const int n   = Self::degree();
+  const int dim = Self::dim();
+  const int ld  = n+1;
+
+  Real L[4];
+  lagrangeBary(x, dim, L);
+
+  for (int k = 0; k <= dim; ++k)
   {
-    x[i].setDiff(i,dim);
-    x[i].val() = x_[i]; 
+    Real *Pk = P + k*ld, *dPk = dP + k*ld;
+    Pk[0] = 1.;
+    dPk[0] = 0.;
+    if (d2P)
+      d2P[k*ld] = 0.;
+    for (int s = 0; s < n; ++s)
+    {
+      Real const f = n*L[k] - s;
+      if (d2P)
+        d2P[k*ld + s+1] = d2P[k*ld + s]*f + 2.*n*dPk[s];
+      dPk[s+1] = dPk[s]*f + n*Pk[s];
+      Pk[s+1]  = Pk[s]*f;
+    }
   }
+}
 
-  adouble ret(0,dim);
-  ret.setNumVars(dim);
-  
-  ret = lagrange(x, ith, degree, dim, m_denominator, m_integer_pts);
+// the integer barycentric coordinates of the node of the ith function
+void SfSimplexLagrange::nodeIndices(unsigned ith, int *sup) const
+{
+  const int dim = Self::dim();
+  sup[0] = Self::degree();
+  for (int k = 1; k <= dim; ++k)
+  {
+    sup[k] = m_integer_pts[dim*ith + k-1];
+    sup[0] -= sup[k];
+  }
+}
+
+Real SfSimplexLagrange::valueFromTables(unsigned ith, Real const*P) const
+{
+  const int dim = Self::dim();
+  const int ld  = Self::degree()+1;
+
+  if (Self::degree() == 0)
+    return 1.;
+
+  int sup[4];
+  Self::nodeIndices(ith, sup);
 
-  return ret.dx(c);
+  Real v = P[sup[0]];
+  for (int k = 1; k <= dim; ++k)
+    v *= P[k*ld + sup[k]];
+  return v/m_denominator[ith];
 }
 
-Real SfSimplexLagrange::hessian(Real const*x_, unsigned ith, unsigned c, unsigned d) const
+// chain rule: x_c = L_{c+1} and L_0 = 1 - sum_c x_c; in 1d, x is also rescaled by 1/2
+void SfSimplexLagrange::gradFromTables(unsigned ith, Real const*P, Real const*dP, Real *g) const
+{
+  const int dim = Self::dim();
+  const int ld  = Self::degree()+1;
+
+  if (Self::degree() == 0)
+  {
+    for (int c = 0; c < dim; ++c)
+      g[c] = 0.;
+    return;
+  }
+
+  int sup[4];
+  Self::nodeIndices(ith, sup);
+
+  Real dL[4]; // derivatives w.r.t. the barycentric coordinates
+  for (int a = 0; a <= dim; ++a)
+  {
+    dL[a] = dP[a*ld + sup[a]];
+    for (int b = 0; b <= dim; ++b)
+      if (b != a)
+        dL[a] *= P[b*ld + sup[b]];
+  }
+
+  Real const scale = (dim==1 ? 0.5 : 1.)/m_denominator[ith];
+  for (int c = 0; c < dim; ++c)
+    g[c] = (dL[c+1] - dL[0])*scale;
+}
+
+void SfSimplexLagrange::hessianFromTables(unsigned ith, Real const*P, Real const*dP, Real const*d2P, Real *h) const
+{
+  const int dim = Self::dim();
+  const int ld  = Self::degree()+1;
+
+  if (Self::degree() == 0)
+  {
+    for (int c = 0; c < dim*dim; ++c)
+      h[c] = 0.;
+    return;
+  }
+
+  int sup[4];
+  Self::nodeIndices(ith, sup);
+
+  Real HL[4][4]; // hessian w.r.t. the barycentric coordinates
+  for (int a = 0; a <= dim; ++a)
+    for (int b = a; b <= dim; ++b)
+    {
+      Real v = a==b ? d2P[a*ld + sup[a]] : dP[a*ld + sup[a]]*dP[b*ld + sup[b]];
+      for (int e = 0; e <= dim; ++e)
+        if (e != a && e != b)
+          v *= P[e*ld + sup[e]];
+      HL[a][b] = HL[b][a] = v;
+    }
+
+  Real const scale = (dim==1 ? 0.25 : 1.)/m_denominator[ith];
+  for (int c = 0; c < dim; ++c)
+    for (int d = 0; d < dim; ++d)
+      h[c*dim + d] = (HL[c+1][d+1] - HL[c+1][0] - HL[0][d+1] + HL[0][0])*scale;
+}
+
+// The factor tables are computed once per point and shared by all the functions.
+void SfSimplexLagrange::tabulate(int npts, Real const* pts, int derivative_order, Real* out) const
 {
   const int n_dofs = Self::numDofs();
-  const int degree = Self::degree();
   const int dim    = Self::dim();
 
-  if (ith >= (unsigned)n_dofs)
-    throw std::out_of_range("SfSimplexLagrange::value: invalid index");
+  if (derivative_order < 0 || derivative_order > 2)
+    throw std::invalid_argument("SfSimplexLagrange::tabulate: `derivative_order` must be 0, 1 or 2");
 
-  typedef ead::D2Fad<Real, 3> adouble;
+  Real P[ALELIB_LAGRANGE_TAB_SIZE], dP[ALELIB_LAGRANGE_TAB_SIZE], d2P[ALELIB_LAGRANGE_TAB_SIZE];
+  int const nd = derivative_order == 0 ? 1 : (derivative_order == 1 ? dim : dim*dim);
 
-  adouble x[3];
-  
-  for (int i = 0; i < dim; ++i)
+  for (int p = 0; p < npts; ++p)
   {
-    x[i].setDiff(i,dim);
-    x[i].val() = x_[i]; 
+    Self::factorTables(pts + p*dim, P, dP, derivative_order == 2 ? d2P : NULL);
+    for (int i = 0; i < n_dofs; ++i, out += nd)
+    {
+      switch (derivative_order)
+      {
+        case 0: *out = Self::valueFromTables(i, P);         break;
+        case 1: Self::gradFromTables(i, P, dP, out);         break;
+        case 2: Self::hessianFromTables(i, P, dP, d2P, out); break;
+      }
+    }
   }
+}
 
-  adouble ret(0,dim);
-  ret.setNumVars(dim);
-  
-  ret = lagrange(x, ith, degree, dim, m_denominator, m_integer_pts);
+void SfSimplexLagrange::tabulateSoA(int npts, Real const* const* x, Real* out) const
+{
+  const int n_dofs = Self::numDofs();
+  const int dim    = Self::dim();
 
-  return ret.d2x(c,d);
+  if (Self::degree() == 0)
+  {
+    std::fill(out, out + npts, 1.);
+    return;
+  }
+
+  int const*  sup       = &m_soa_sup[0];
+  Real const* inv_denom = &m_inv_denom[0];
+
+  switch (simd::level())
+  {
+#ifdef ALE_HAS_SIMD_DISPATCH
+    case SIMD_AVX512:
+      lagrangeValuesSoAAvx512(npts, dim, Self::degree(), n_dofs, sup, inv_denom, x, out);
+      break;
+    case SIMD_AVX2:
+      lagrangeValuesSoAAvx2(npts, dim, Self::degree(), n_dofs, sup, inv_denom, x, out);
+      break;
+#endif
+    default:
+      lagrangeValuesSoAScalar(npts, dim, Self::degree(), n_dofs, sup, inv_denom, x, out);
+  }
 }
 
 const char* SfSimplexLagrange::name() const
@@ -17,6 +17,8 @@ class SfSimplexLagrange : public ShapeFuncImpl
   std::string m_name; // contains name and options
   std::vector<long int> m_denominator; // lagrange functions have the form N/D. the denominators are computed once
   std::vector<int>      m_integer_pts; // integer coordinates of the master cells points
+  std::vector<int>      m_soa_sup;     // the 4 integer barycentric coordinates of each node, for tabulateSoA
+  std::vector<Real>     m_inv_denom;   // 1/m_denominator
 
   typedef SfSimplexLagrange Self;
   typedef ShapeFuncImpl Base;
@@ -34,6 +36,8 @@ public:
   virtual Real value(Real const*x, unsigned ith) const;
   virtual Real grad(Real const*x, unsigned ith, unsigned c) const;
   virtual Real hessian(Real const*x, unsigned ith, unsigned c, unsigned d) const;
+  virtual void tabulate(int npts, Real const* pts, int derivative_order, Real* out) const;
+  virtual void tabulateSoA(int npts, Real const* const* x, Real* out) const;
 
   virtual bool isTauEquivalent() const;
   virtual bool isLinear() const;
@@ -55,7 +59,10 @@ public:
 
   int degree() const;
 
-private:
+protected:
+
+  long int denominator(unsigned ith) const
+  { return m_denominator[ith]; }
 
   void computeDenominators();
 
@@ -63,6 +70,13 @@ private:
   double numeratorAt(int n, int Q, double x) const;
   
   double numeratorAt_d(int n, int Q, double x, double xd, double *numerator_val) const; // derivative of numeratorAt
+
+  // products of the lagrange factors at a point, and their derivatives; see the .cpp
+  void factorTables(Real const*x, Real *P, Real *dP, Real *d2P) const;
+  void nodeIndices(unsigned ith, int *sup) const;
+  Real valueFromTables(unsigned ith, Real const*P) const;
+  void gradFromTables(unsigned ith, Real const*P, Real const*dP, Real *g) const;
+  void hessianFromTables(unsigned ith, Real const*P, Real const*dP, Real const*d2P, Real *h) const;
   
 };
 
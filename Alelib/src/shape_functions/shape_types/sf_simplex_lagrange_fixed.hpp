@@ -0,0 +1,237 @@
+#ifndef ALELIB_SF_SIMPLEX_LAGRANGE_FIXED
+#define ALELIB_SF_SIMPLEX_LAGRANGE_FIXED
+
+#include "sf_simplex_lagrange.hpp"
+#include <stdexcept>
+
+namespace alelib
+{
+
+/* Lagrange functions on simplices with dimension and degree known at compile time.
+ *
+ * The functions and node numbering are those of SfSimplexLagrange; only the evaluation
+ * changes: every function is written in closed form in the barycentric coordinates L,
+ *
+ *   P1: vertex  L_a
+ *   P2: vertex  L_a(2L_a - 1),               edge  4 L_a L_b
+ *   P3: vertex  L_a(3L_a - 1)(3L_a - 2)/2,   edge  9/2 L_a(3L_a - 1) L_b,   face  27 L_a L_b L_c
+ *
+ * with their derivatives w.r.t. L written out too, so no product over the lattice factors
+ * is formed at run time. The constructor only finds the kind of each node and the
+ * coordinates it depends on. SfSimplexLagrange::create returns one of these for
+ * dim = 1,2,3 and degree = 1,2,3.
+ */
+template<int Dim, int Degree>
+class SfSimplexLagrangeFixed : public SfSimplexLagrange
+{
+  typedef SfSimplexLagrangeFixed Self;
+
+  enum { NL    = Dim+1,
+         NDofs = Dim==1 ? (Degree+1) :
+                (Dim==2 ? (Degree+1)*(Degree+2)/2 :
+                          (Degree+1)*(Degree+2)*(Degree+3)/6) };
+
+  enum ENodeKind { VERTEX_NODE, EDGE_NODE, FACE_NODE };
+
+  int m_kind[NDofs];
+  int m_idx[NDofs][3];  // the coordinates a, b, c of the closed forms
+
+  // d(L_k)/dx is 1/2 in 1d due to the [-1,1] -> [0,1] rescaling
+  static Real scale() { return Dim==1 ? 0.5 : 1.; }
+
+  static void bary(Real const*x, Real *L)
+  {
+    if (Dim == 1)
+    {
+      L[1] = 0.5*(1.+x[0]);
+      L[0] = 1. - L[1];
+      return;
+    }
+    L[0] = 1.;
+    for (int k = 1; k < NL; ++k)
+    {
+      L[k] = x[k-1];
+      L[0] -= L[k];
+    }
+  }
+
+  // the function i, and its derivatives w.r.t. L up to `Order` (only the nonzero ones are written)
+  template<int Order>
+  Real evalL(int i, Real const* L, Real* dL, Real (*HL)[NL]) const
+  {
+    int const a = m_idx[i][0], b = m_idx[i][1], c = m_idx[i][2];
+    Real const La = L[a], Lb = L[b], Lc = L[c];
+
+    if (Order > 0)
+      for (int k = 0; k < NL; ++k)
+        dL[k] = 0.;
+    if (Order > 1)
+      for (int k = 0; k < NL; ++k)
+        for (int l = 0; l < NL; ++l)
+          HL[k][l] = 0.;
+
+    switch (m_kind[i])
+    {
+      case VERTEX_NODE:
+        if (Degree == 1)
+        {
+          if (Order > 0) dL[a] = 1.;
+          return La;
+        }
+        if (Degree == 2)
+        {
+          if (Order > 0) dL[a] = 4.*La - 1.;
+          if (Order > 1) HL[a][a] = 4.;
+          return La*(2.*La - 1.);
+        }
+        if (Order > 0) dL[a] = 13.5*La*La - 9.*La + 1.;
+        if (Order > 1) HL[a][a] = 27.*La - 9.;
+        return 0.5*La*(3.*La - 1.)*(3.*La - 2.);
+
+      case EDGE_NODE:
+        if (Degree == 2)
+        {
+          if (Order > 0) { dL[a] = 4.*Lb; dL[b] = 4.*La; }
+          if (Order > 1) HL[a][b] = HL[b][a] = 4.;
+          return 4.*La*Lb;
+        }
+        if (Order > 0) { dL[a] = (27.*La - 4.5)*Lb; dL[b] = 4.5*La*(3.*La - 1.); }
+        if (Order > 1) { HL[a][a] = 27.*Lb; HL[a][b] = HL[b][a] = 27.*La - 4.5; }
+        return 4.5*La*(3.*La - 1.)*Lb;
+
+      default: // FACE_NODE
+        if (Order > 0) { dL[a] = 27.*Lb*Lc; dL[b] = 27.*La*Lc; dL[c] = 27.*La*Lb; }
+        if (Order > 1) { HL[a][b] = HL[b][a] = 27.*Lc; HL[a][c] = HL[c][a] = 27.*Lb; HL[b][c] = HL[c][b] = 27.*La; }
+        return 27.*La*Lb*Lc;
+    }
+  }
+
+  Real valueAt(int i, Real const* L) const
+  {
+    return evalL<0>(i, L, NULL, NULL);
+  }
+
+  void gradAt(int i, Real const* L, Real *g) const
+  {
+    Real dL[NL];
+    evalL<1>(i, L, dL, NULL);
+    for (int c = 0; c < Dim; ++c)
+      g[c] = (dL[c+1] - dL[0])*scale();
+  }
+
+  void hessianAt(int i, Real const* L, Real *h) const
+  {
+    Real dL[NL], HL[NL][NL];
+    evalL<2>(i, L, dL, HL);
+    Real const s = scale()*scale();
+    for (int c = 0; c < Dim; ++c)
+      for (int d = 0; d < Dim; ++d)
+        h[c*Dim + d] = (HL[c+1][d+1] - HL[c+1][0] - HL[0][d+1] + HL[0][0])*s;
+  }
+
+public:
+
+  SfSimplexLagrangeFixed() : SfSimplexLagrange(Dim, Degree, false)
+  {
+    for (int i = 0; i < NDofs; ++i)
+    {
+      int sup[NL];
+      nodeIndices(i, sup);
+
+      // the coordinates with nonzero index, the largest index first
+      int n = 0;
+      for (int p = Degree; p > 0; --p)
+        for (int k = 0; k < NL; ++k)
+          if (sup[k] == p)
+            m_idx[i][n++] = k;
+      m_kind[i] = n == 1 ? VERTEX_NODE : (n == 2 ? EDGE_NODE : FACE_NODE);
+      for (; n < 3; ++n)
+        m_idx[i][n] = m_idx[i][0];
+    }
+  }
+
+  virtual Real value(Real const*x, unsigned ith) const
+  {
+    if (ith >= (unsigned)NDofs)
+      throw std::out_of_range("SfSimplexLagrangeFixed::value: invalid index");
+
+    Real L[NL];
+    bary(x, L);
+    return valueAt(ith, L);
+  }
+
+  virtual Real grad(Real const*x, unsigned ith, unsigned c) const
+  {
+    if (ith >= (unsigned)NDofs)
+      throw std::out_of_range("SfSimplexLagrangeFixed::grad: invalid index");
+
+    Real L[NL], g[Dim];
+    bary(x, L);
+    gradAt(ith, L, g);
+    return g[c];
+  }
+
+  virtual Real hessian(Real const*x, unsigned ith, unsigned c, unsigned d) const
+  {
+    if (ith >= (unsigned)NDofs)
+      throw std::out_of_range("SfSimplexLagrangeFixed::hessian: invalid index");
+
+    if (Degree == 1)
+      return 0.;
+
+    Real L[NL], h[Dim*Dim];
+    bary(x, L);
+    hessianAt(ith, L, h);
+    return h[c*Dim + d];
+  }
+
+  virtual void tabulate(int npts, Real const* pts, int derivative_order, Real* out) const
+  {
+    Real L[NL];
+
+    switch (derivative_order)
+    {
+      case 0:
+        for (int p = 0; p < npts; ++p, out += NDofs)
+        {
+          bary(pts + p*Dim, L);
+          for (int i = 0; i < NDofs; ++i)
+            out[i] = valueAt(i, L);
+        }
+        break;
+
+      case 1:
+        for (int p = 0; p < npts; ++p)
+        {
+          bary(pts + p*Dim, L);
+          for (int i = 0; i < NDofs; ++i, out += Dim)
+            gradAt(i, L, out);
+        }
+        break;
+
+      case 2:
+        for (int p = 0; p < npts; ++p)
+        {
+          bary(pts + p*Dim, L);
+          for (int i = 0; i < NDofs; ++i, out += Dim*Dim)
+            hessianAt(i, L, out);
+        }
+        break;
+
+      default:
+        throw std::invalid_argument("SfSimplexLagrangeFixed::tabulate: `derivative_order` must be 0, 1 or 2");
+    }
+  }
+
+  virtual Self* clone() const
+  {
+    return new Self(*this);
+  }
+
+};
+
+
+} // namespace alelib
+
+
+#endif // ALELIB_SF_SIMPLEX_LAGRANGE_FIXED
@@ -2,6 +2,8 @@
 #define ALELIB_SHAPE_IMPL_HPP
 /* Every Shape type must include this file */
 
+#include <vector>
+
 namespace alelib
 {
 
@@ -22,6 +24,88 @@ public:
   virtual Real grad(Real const*x, unsigned ith, unsigned c) const = 0;
   virtual Real hessian(Real const*x, unsigned ith, unsigned c, unsigned d) const = 0;
 
+  // Batched evaluation; see ShapeFunction::tabulate for the layout of `out`.
+  // This default loops over the scalar methods; override it with a native version.
+  virtual void tabulate(int npts, Real const* pts, int derivative_order, Real* out) const
+  {
+    int const dim    = this->dim();
+    int const n_dofs = this->numDofs();
+
+    for (int p = 0; p < npts; ++p)
+    {
+      Real const* x = pts + p*dim;
+      for (int i = 0; i < n_dofs; ++i)
+      {
+        if (derivative_order == 0)
+          *out++ = this->value(x, i);
+        else
+        if (derivative_order == 1)
+          for (int c = 0; c < dim; ++c)
+            *out++ = this->grad(x, i, c);
+        else
+          for (int c = 0; c < dim; ++c)
+            for (int d = 0; d < dim; ++d)
+              *out++ = this->hessian(x, i, c, d);
+      }
+    }
+  }
+
+  // Values at points given in SoA layout: x[c][p] is the coordinate c of the point p, and
+  // out[i*npts + p] = phi_i(x_p). Vectorized types override this; this default is scalar.
+  virtual void tabulateSoA(int npts, Real const* const* x, Real* out) const
+  {
+    int const dim    = this->dim();
+    int const n_dofs = this->numDofs();
+    Real xp[3];
+
+    for (int p = 0; p < npts; ++p)
+    {
+      for (int c = 0; c < dim; ++c)
+        xp[c] = x[c][p];
+      for (int i = 0; i < n_dofs; ++i)
+        out[i*npts + p] = this->value(xp, i);
+    }
+  }
+
+  // Values and gradients of sum_i coefs[i]*phi_i at the tensor grid of the 1d points pts1d
+  // (the first coordinate varies fastest); see ShapeFunction::interpolateTensor.
+  // This default goes through tabulate(); tensor-product types override it with sum factorization.
+  virtual void interpolateTensor(int nq, Real const* pts1d, Real const* coefs, Real* vals, Real* grads) const
+  {
+    int const dim    = this->dim();
+    int const n_dofs = this->numDofs();
+    int npts = 1;
+    for (int c = 0; c < dim; ++c)
+      npts *= nq;
+
+    std::vector<Real> pts(npts*dim), tab(npts*n_dofs*dim);
+    for (int p = 0; p < npts; ++p)
+      for (int c = 0, r = p; c < dim; ++c, r /= nq)
+        pts[p*dim + c] = pts1d[r % nq];
+
+    if (vals)
+    {
+      this->tabulate(npts, &pts[0], 0, &tab[0]);
+      for (int p = 0; p < npts; ++p)
+      {
+        vals[p] = 0.;
+        for (int i = 0; i < n_dofs; ++i)
+          vals[p] += coefs[i]*tab[p*n_dofs + i];
+      }
+    }
+    if (grads)
+    {
+      this->tabulate(npts, &pts[0], 1, &tab[0]);
+      for (int p = 0; p < npts; ++p)
+        for (int c = 0; c < dim; ++c)
+        {
+          grads[p*dim + c] = 0.;
+          for (int i = 0; i < n_dofs; ++i)
+            grads[p*dim + c] += coefs[i]*tab[(p*n_dofs + i)*dim + c];
+        }
+    }
+  }
+
   virtual bool isTauEquivalent() const = 0;
   virtual bool isLinear() const = 0;
   virtual bool isConforming() const = 0;
@@ -0,0 +1,138 @@
+#include "tabulation_cache.hpp"
+#include "../quadrature/quadrature.hpp"
+#include "../util/assert.hpp"
+#include <map>
+#include <string>
+#include <mutex>
+#include <stdexcept>
+#include <stdint.h>
+
+namespace alelib
+{
+
+namespace
+{
+
+  // number of Reals that keep the next array aligned
+  int alignedLength(int n)
+  {
+    int const k = ALELIB_TABULATION_ALIGN/sizeof(Real);
+    return (n + k - 1)/k*k;
+  }
+
+  struct CacheKey
+  {
+    std::string sf_name;
+    int         sf_dim;
+    int         cell_type;
+    int         quadr_degree;
+    int         quadr_rule;
+
+    bool operator<(CacheKey const& o) const
+    {
+      if (quadr_rule != o.quadr_rule)     return quadr_rule < o.quadr_rule;
+      if (sf_dim != o.sf_dim)             return sf_dim < o.sf_dim;
+      if (cell_type != o.cell_type)       return cell_type < o.cell_type;
+      if (quadr_degree != o.quadr_degree) return quadr_degree < o.quadr_degree;
+      return sf_name < o.sf_name;
+    }
+  };
+
+  // owns the tabulations; they are deleted at exit
+  struct CacheStore
+  {
+    typedef std::map<CacheKey, ReferenceTabulation*> MapT;
+    MapT       table;
+    std::mutex lock;
+
+    ~CacheStore()
+    {
+      for (MapT::iterator it = table.begin(); it != table.end(); ++it)
+        delete it->second;
+    }
+  };
+
+  CacheStore& cacheStore()
+  {
+    static CacheStore store;
+    return store;
+  }
+
+  // the entries a thread has already seen; they are immutable and live until the end of the program,
+  // so a hit needs no lock
+  typedef std::map<CacheKey, ReferenceTabulation const*> LocalMapT;
+
+  LocalMapT& localTable()
+  {
+    static thread_local LocalMapT table;
+    return table;
+  }
+
+}
+
+ReferenceTabulation::ReferenceTabulation(ShapeFunction const& sf, Quadrature const& quadr)
+  : m_npts(quadr.numPoints()), m_nfuncs(sf.numDofs()), m_dim(sf.dim())
+{
+  int const n0 = alignedLength(sf.tabulateSize(m_npts, 0));
+  int const n1 = alignedLength(sf.tabulateSize(m_npts, 1));
+  int const n2 = alignedLength(sf.tabulateSize(m_npts, 2));
+  int const pad = ALELIB_TABULATION_ALIGN/sizeof(Real);
+
+  m_storage.resize(n0 + n1 + n2 + pad);
+
+  Real* base = &m_storage[0];
+  uintptr_t const mis = reinterpret_cast<uintptr_t>(base) % ALELIB_TABULATION_ALIGN;
+  if (mis)
+    base += (ALELIB_TABULATION_ALIGN - mis)/sizeof(Real);
+
+  std::vector<Real> pts(m_npts*m_dim);
+  for (int qp = 0; qp < m_npts; ++qp)
+    for (int c = 0; c < m_dim; ++c)
+      pts[qp*m_dim + c] = quadr.point(qp)[c];
+
+  Real const* x = m_npts > 0 ? &pts[0] : NULL;
+  sf.tabulate(m_npts, x, 0, base);
+  sf.tabulate(m_npts, x, 1, base + n0);
+  sf.tabulate(m_npts, x, 2, base + n0 + n1);
+
+  m_values   = base;
+  m_grads    = base + n0;
+  m_hessians = base + n0 + n1;
+}
+
+ReferenceTabulation const& TabulationCache::get(ShapeFunction const& sf, Quadrature const& quadr)
+{
+  ALELIB_CHECK(sf.isSet(), "shape function type has not been set", std::invalid_argument);
+  ALELIB_CHECK(quadr.cellType() != UNDEFINED_CELLT, "quadrature type has not been set", std::invalid_argument);
+
+  CacheKey key;
+  key.sf_name      = sf.name();
+  key.sf_dim       = sf.dim();
+  key.cell_type    = quadr.cellType();
+  key.quadr_degree = quadr.degree();
+  key.quadr_rule   = quadr.rule();
+
+  LocalMapT& local = localTable();
+  LocalMapT::const_iterator hit = local.find(key);
+  if (hit != local.end())
+    return *hit->second;
+
+  CacheStore& store = cacheStore();
+  std::lock_guard<std::mutex> guard(store.lock);
+
+  CacheStore::MapT::iterator it = store.table.find(key);
+  if (it == store.table.end())
+    it = store.table.insert(std::make_pair(key, new ReferenceTabulation(sf, quadr))).first;
+
+  local.insert(std::make_pair(key, it->second));
+  return *it->second;
+}
+
+int TabulationCache::size()
+{
+  CacheStore& store = cacheStore();
+  std::lock_guard<std::mutex> guard(store.lock);
+  return store.table.size();
+}
+
+} // end namespace alelib
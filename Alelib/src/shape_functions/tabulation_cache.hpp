@@ -0,0 +1,102 @@
+// This file is part of Alelib, a toolbox for finite element codes.
+//
+// Alelib is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// Alelib is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// Alelib. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALELIB_TABULATION_CACHE_HPP
+#define ALELIB_TABULATION_CACHE_HPP
+
+#include "shape_function.hpp"
+#include <vector>
+
+// alignment in bytes of the arrays handed out by TabulationCache
+#define ALELIB_TABULATION_ALIGN 64
+
+namespace alelib
+{
+
+class Quadrature;
+
+/** @brief Values, gradients and hessians of a set of shape functions at the points of a quadrature rule
+ *         in the reference element. It is immutable once built; see \c TabulationCache.
+ *
+ *  The arrays follow the layout of \c ShapeFunction::tabulate and each one starts at an
+ *  address aligned to \c ALELIB_TABULATION_ALIGN bytes.
+ */
+class ReferenceTabulation
+{
+  friend class TabulationCache;
+
+  int m_npts;
+  int m_nfuncs;
+  int m_dim;
+  std::vector<Real> m_storage;
+  Real const* m_values;
+  Real const* m_grads;
+  Real const* m_hessians;
+
+  ReferenceTabulation(ShapeFunction const& sf, Quadrature const& quadr);
+  ReferenceTabulation(ReferenceTabulation const&);
+  ReferenceTabulation& operator=(ReferenceTabulation const&);
+
+public:
+
+  int numPoints()    const { return m_npts;   }
+  int numFunctions() const { return m_nfuncs; }
+  int dim()          const { return m_dim;    }
+
+  /** @brief <tt>values()[p*numFunctions() + i]</tt> is \f$ \varphi^{i}(\bf{x}_p) \f$. */
+  Real const* values()   const { return m_values;   }
+  /** @brief <tt>grads()[(p*numFunctions() + i)*dim() + c]</tt> is \f$ \partial_c\varphi^{i}(\bf{x}_p) \f$. */
+  Real const* grads()    const { return m_grads;    }
+  /** @brief <tt>hessians()[((p*numFunctions() + i)*dim() + c)*dim() + d]</tt> is \f$ \partial_c\partial_d\varphi^{i}(\bf{x}_p) \f$. */
+  Real const* hessians() const { return m_hessians; }
+
+  Real value(int qp, int ith) const
+  { return m_values[qp*m_nfuncs + ith]; }
+
+  Real grad(int qp, int ith, int c) const
+  { return m_grads[(qp*m_nfuncs + ith)*m_dim + c]; }
+
+  Real hessian(int qp, int ith, int c, int d) const
+  { return m_hessians[((qp*m_nfuncs + ith)*m_dim + c)*m_dim + d]; }
+};
+
+/** @brief Process-wide, thread-safe store of reference tabulations.
+ *
+ *  The tabulation of a shape function on a quadrature rule is computed the first time it is requested
+ *  and shared by every later request with the same key: the shape function name (which carries its
+ *  options, dimension and degree), the quadrature cell type, degree and rule.
+ *  The returned references stay valid until the end of the program.
+ *  Each thread also keeps the entries it has already used in a thread-local table, so a hit takes no
+ *  lock; only the first request of an entry by a thread goes to the shared, locked store.
+ */
+class TabulationCache
+{
+public:
+
+  static ReferenceTabulation const& get(ShapeFunction const& sf, Quadrature const& quadr);
+
+  /** @brief returns the number of tabulations stored so far. */
+  static int size();
+};
+
+} // end namespace alelib
+
+#endif // ALELIB_TABULATION_CACHE_HPP
@@ -26,9 +26,7 @@
 #include <vector>
 #include <set>
 #include <utility>
-
-#include <iostream>
-using namespace std;
+#include "conf/directives.hpp"
 
 
 
@@ -167,6 +165,7 @@ public:
             temp_node.number        = i;
             temp_node.pseudom_degree = table[i].size() - PENALTY*marks[i].penalized();
             actual_lvl.insert(temp_node);
+            marks[i].mark();
             break;
           }
         continue;
@@ -262,6 +261,7 @@ public:
             temp_node.number        = i;
             temp_node.pseudom_degree = table[i].size() - PENALTY*marks[i].penalized();
             next_lvl.insert(temp_node);
+            marks[i].mark();
             break;
           }
           
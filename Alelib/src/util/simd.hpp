@@ -0,0 +1,108 @@
+// This file is part of Alelib, a toolbox for finite element codes.
+//
+// Alelib is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 3 of the License, or (at your option) any later version.
+//
+// Alternatively, you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; either version 2 of
+// the License, or (at your option) any later version.
+//
+// Alelib is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License or the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License and a copy of the GNU General Public License along with
+// Alelib. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALELIB_SIMD_HPP
+#define ALELIB_SIMD_HPP
+
+#include <cstring>
+
+// Runtime dispatch needs the GCC/Clang vector extensions, the `target` attribute and
+// __builtin_cpu_supports, all x86 only. Elsewhere only the scalar kernels are compiled.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define ALE_HAS_SIMD_DISPATCH
+#  define ALE_TARGET_AVX2   __attribute__((target("avx2,fma")))
+#  define ALE_TARGET_AVX512 __attribute__((target("avx512f")))
+#  define ALE_FORCE_INLINE  inline __attribute__((always_inline))
+#else
+#  define ALE_FORCE_INLINE  inline
+#endif
+
+namespace alelib
+{
+
+#ifndef ALELIB_SCALAR_TYPE
+typedef double Real;
+#endif
+
+enum ESimdLevel
+{
+  SIMD_SCALAR = 0,
+  SIMD_AVX2   = 1,
+  SIMD_AVX512 = 2
+};
+
+namespace simd
+{
+
+#ifdef ALE_HAS_SIMD_DISPATCH
+  typedef Real RealV4 __attribute__((vector_size(4*sizeof(Real))));
+  typedef Real RealV8 __attribute__((vector_size(8*sizeof(Real))));
+#endif
+
+  // unaligned load/store of W consecutive Reals; V = Real gives the scalar version.
+  // (vectors are not returned by value: that would depend on the ABI of the caller's target)
+  template<class V>
+  ALE_FORCE_INLINE void load(V& v, Real const* p)
+  { std::memcpy(&v, p, sizeof(V)); }
+
+  template<class V>
+  ALE_FORCE_INLINE void store(Real* p, V const& v)
+  { std::memcpy(p, &v, sizeof(V)); }
+
+  inline ESimdLevel detectLevel()
+  {
+  #ifdef ALE_HAS_SIMD_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return SIMD_AVX2;
+  #endif
+    return SIMD_SCALAR;
+  }
+
+  inline int& forcedLevel()
+  {
+    static int forced = -1;
+    return forced;
+  }
+
+  /// the instruction set used by the vectorized kernels: the best one the CPU supports,
+  /// unless lowered by forceLevel().
+  inline ESimdLevel level()
+  {
+    static ESimdLevel const detected = detectLevel();
+    int const forced = forcedLevel();
+    return (forced >= 0 && forced < detected) ? ESimdLevel(forced) : detected;
+  }
+
+  /// restricts the kernels to `lvl` or below (for testing and benchmarking); -1 restores the default.
+  /// Not thread-safe: call it before the kernels run.
+  inline void forceLevel(int lvl)
+  {
+    forcedLevel() = lvl;
+  }
+
+} // end namespace simd
+
+} // end namespace alelib
+
+#endif // ALELIB_SIMD_HPP
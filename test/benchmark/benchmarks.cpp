@@ -0,0 +1,173 @@
+// Rough timings of the kernels; the unit tests (../*.cpp) check the same code for correctness.
+//
+// usage: benchmarks.exe [name]   runs the benchmarks whose name contains `name` (all by default)
+
+#include <Alelib/Mesh>
+#include <Alelib/ShapeFunction>
+#include <Alelib/Quadrature>
+#include <Alelib/src/shape_functions/parametric_pts.hpp>
+#include <Alelib/src/util/timer.hpp>
+#include <Alelib/src/util/simd.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace alelib;
+
+namespace
+{
+
+// the specialized low-order Lagrange kernels against the generic implementation
+void benchLagrangeFixed()
+{
+  std::vector<double> pts;
+  std::vector<Real> a;
+  ShapeFunction fixed, generic;
+  Timer timer;
+
+  for (int dim = 1; dim <= 3; ++dim)
+  for (int deg = 1; deg <= 3; ++deg)
+  {
+    fixed.setType("Lagrange", dim, deg);
+    generic.setType("Lagrange,generic", dim, deg);
+
+    switch (dim)
+    {
+      case 1: genLineParametricPts(5, pts); break;
+      case 2: genTriParametricPts(5, pts); break;
+      case 3: genTetParametricPts(5, pts); break;
+    }
+    int const npts = pts.size()/dim;
+
+    // gradients at all points, repeatedly
+    int const n_rep = 2000;
+    a.resize(fixed.tabulateSize(npts, 1));
+    double t_fixed, t_generic;
+    timer.restart();
+    for (int r = 0; r < n_rep; ++r)
+      fixed.tabulate(npts, pts.data(), 1, a.data());
+    t_fixed = timer.elapsed();
+    timer.restart();
+    for (int r = 0; r < n_rep; ++r)
+      generic.tabulate(npts, pts.data(), 1, a.data());
+    t_generic = timer.elapsed();
+    printf("Lagrange dim %d degree %d, grad tabulation: fixed %.4fs, generic %.4fs\n", dim, deg, t_fixed, t_generic);
+  }
+}
+
+// values of P2 on a tet at many points, at each SIMD level available
+void benchTabulateSoA()
+{
+  int const nbig = 1 << 16;
+  std::vector<Real> big(3*nbig), out;
+  Real const* bxyz[3] = {&big[0], &big[nbig], &big[2*nbig]};
+  for (int p = 0; p < 3*nbig; ++p)
+    big[p] = 0.25*(1. + std::sin(1.*p));
+  ShapeFunction sf;
+  sf.setType("Lagrange", 3, 2);
+  out.resize(sf.numDofs()*nbig);
+  Timer timer;
+  for (int lvl = SIMD_SCALAR; lvl <= (int)simd::detectLevel(); ++lvl)
+  {
+    simd::forceLevel(lvl);
+    timer.restart();
+    for (int r = 0; r < 10; ++r)
+      sf.tabulateSoA(nbig, bxyz, out.data());
+    double const t = timer.elapsed();
+    printf("P2 tet values, simd level %d: %.3g points/s\n", lvl, t > 0 ? 10.*nbig/t : 0.);
+  }
+  simd::forceLevel(-1);
+}
+
+// sizes of the simplex rules handed out by Quadrature, against the collapsed-coordinate rules
+// and the tables used before the symmetric library
+void benchSimplexRules()
+{
+  Quadrature Q;
+  std::vector<Quadrature::Vec3> col_pts;
+  std::vector<Real> col_wts;
+  int const old_tri[] = {1, 1, 3, 6, 7, 7, 12, 15, 16, 19, 25};
+  int const old_tet[] = {1, 1, 4, 8, 14, 14, 24, 36, 46};
+
+  for (int dim = 2; dim <= 3; ++dim)
+  {
+    printf("%s: degree, points, collapsed points, points saved\n", dim==2 ? "triangle" : "tetrahedron");
+    for (int deg = 0; deg <= 20; ++deg)
+    {
+      Q.setType(dim==2 ? TRIANGLE : TETRAHEDRON, deg);
+      int const np = Q.numPoints();
+      Quadrature::igetQuadrPtsCollapsed(deg, dim, col_pts, col_wts);
+      int const old = dim==2 ? (deg <= 10 ? old_tri[deg] : (int)col_pts.size())
+                             : (deg <=  8 ? old_tet[deg] : (int)col_pts.size());
+      printf("  %2d %4d %4d %4d\n", deg, np, (int)col_pts.size(), old - np);
+    }
+  }
+}
+
+// CellGeometry on affine tetrahedra
+void benchCellGeometry()
+{
+  CellGeometry G(TETRAHEDRON, 3);
+  G.setPoints(Quadrature(TETRAHEDRON, 2));
+
+  int const nbig = 1 << 14;
+  std::vector<Real> nodes(nbig*12);
+  for (int k = 0; k < nbig*12; ++k)
+    nodes[k] = ((k % 12)/3 == (k % 3) + 1 ? 1. : 0.) + 0.01*std::sin(1.*k);
+  Timer timer;
+  timer.restart();
+  for (int r = 0; r < 10; ++r)
+    G.compute(nbig, &nodes[0]);
+  double const t = timer.elapsed();
+  printf("tet geometry (J, J^-1, det J, JxW at %d points): %.3g cells/s\n", G.numPoints(), t > 0 ? 10.*nbig/t : 0.);
+}
+
+// P2 tetrahedra Laplace matrices contracted from the reference tensors
+void benchReferenceTensors()
+{
+  ReferenceTensors const& R2 = ReferenceTensors::get(TETRAHEDRON, 2);
+  Real const iJ[9] = {1, 0.1, 0, 0.2, 1.1, 0.1, 0, 0.3, 0.9};
+  Real K2[100];
+  Timer timer;
+  timer.restart();
+  int const nrep = 1 << 16;
+  Real sum = 0;
+  for (int r = 0; r < nrep; ++r)
+  {
+    R2.laplaceMatrix(1. + 1e-6*r, iJ, 3, K2);
+    sum += K2[r % 100];
+  }
+  double const tt = timer.elapsed();
+  printf("P2 tet Laplace matrices from reference tensors: %.3g cells/s (%g)\n", tt > 0 ? nrep/tt : 0., sum);
+}
+
+struct Benchmark
+{
+  const char* name;
+  void (*run)();
+};
+
+Benchmark const benchmarks[] = {
+  {"LagrangeFixed", benchLagrangeFixed},
+  {"TabulateSoA",   benchTabulateSoA},
+  {"SimplexRules",  benchSimplexRules},
+  {"CellGeometry",  benchCellGeometry},
+  {"RefTensors",    benchReferenceTensors},
+};
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+  int const n = sizeof(benchmarks)/sizeof(benchmarks[0]);
+  for (int i = 0; i < n; ++i)
+  {
+    if (argc > 1 && !std::strstr(benchmarks[i].name, argv[1]))
+      continue;
+    printf("== %s\n", benchmarks[i].name);
+    benchmarks[i].run();
+  }
+  return 0;
+}
@@ -801,5 +801,851 @@ TEST(DoffMapper, RegionSplitting)
   // teste lixo
 }
 
+TEST(DoffMapper, RegionDofsStorage)
+{
+  RegionDofs c;
+
+  // 12 regions, 5 entities, 2 comps
+  c.reshape(12, 5, 2);
+  EXPECT_EQ(12, c.numRegions());
+  EXPECT_EQ(5, c.numEntities());
+  EXPECT_EQ(10, c.size()); // not 12*5*2
+
+  for (index_t id = 0; id < 5; ++id)
+    for (int reg = 0; reg < 12; ++reg)
+      EXPECT_TRUE(c.find(reg, id) == NULL);
+
+  // entity 1 in region 7, entity 3 in regions 2, 4 and 9 (interface)
+  index_t* d = c.insert(7, 1);
+  d[0] = 10; d[1] = 11;
+  d = c.insert(2, 3);
+  d[0] = 20; d[1] = 21;
+  d = c.insert(4, 3);
+  d[0] = 22; d[1] = 23;
+  d = c.insert(9, 3);
+  d[0] = 24; d[1] = 25;
+  EXPECT_EQ(14, c.size());
+
+  ASSERT_TRUE(c.find(7, 1) != NULL);
+  EXPECT_EQ(10, c.find(7, 1)[0]);
+  EXPECT_EQ(11, c.find(7, 1)[1]);
+  EXPECT_TRUE(c.find(2, 1) == NULL);
+  EXPECT_EQ(20, c.find(2, 3)[0]);
+  EXPECT_EQ(23, c.find(4, 3)[1]);
+  EXPECT_EQ(24, c.find(9, 3)[0]);
+  EXPECT_TRUE(c.find(5, 3) == NULL);
+  EXPECT_TRUE(c.insert(4, 3) == c.find(4, 3));
+
+  // access() runs over all stored dofs
+  std::vector<index_t> all;
+  for (index_t j = 0; j < c.size(); ++j)
+    if (c.access(j) >= 0)
+      all.push_back(c.access(j));
+  std::sort(all.begin(), all.end());
+  index_t const expected[] = {10, 11, 20, 21, 22, 23, 24, 25};
+  EXPECT_TRUE(std::equal(all.begin(), all.end(), expected));
+  EXPECT_EQ(8u, all.size());
+
+  // growing keeps the dofs
+  c.resize(8);
+  EXPECT_EQ(8, c.numEntities());
+  EXPECT_EQ(10, c.find(7, 1)[0]);
+  EXPECT_EQ(25, c.find(9, 3)[1]);
+  EXPECT_TRUE(c.find(0, 7) == NULL);
+
+  c.erase(3);
+  EXPECT_TRUE(c.find(2, 3) == NULL);
+  EXPECT_TRUE(c.find(4, 3) == NULL);
+  EXPECT_TRUE(c.find(9, 3) == NULL);
+  EXPECT_EQ(10, c.find(7, 1)[0]);
+
+  // the extra blocks of erased entities are reused
+  d = c.insert(7, 6);
+  d[0] = 30; d[1] = 31;
+  d = c.insert(8, 6);
+  d[0] = 32; d[1] = 33;
+  d = c.insert(1, 1);
+  d[0] = 34; d[1] = 35;
+  EXPECT_EQ(20, c.size());
+  EXPECT_EQ(32, c.find(8, 6)[0]);
+  EXPECT_EQ(35, c.find(1, 1)[1]);
+  EXPECT_EQ(11, c.find(7, 1)[1]);
+  d = c.insert(3, 5);
+  d[0] = 36; d[1] = 37;
+  EXPECT_EQ(20, c.size());
+  EXPECT_EQ(37, c.find(3, 5)[1]);
+  EXPECT_TRUE(c.insert(4, 5) != c.find(3, 5));
+  EXPECT_EQ(22, c.size());
+}
+
+// max |i-j| for all dofs i, j sharing a cell
+template<class MeshT, class DofMapperT>
+index_t dofsBandwidth(DofMapperT const& mapper, MeshT const* mp)
+{
+  typedef typename MeshT::CellH CellH;
+
+  index_t band = 0;
+  std::vector<index_t> dofs;
+  for (CellH cell = mp->cellBegin(), c_end = mp->cellEnd(); cell != c_end; ++cell)
+  {
+    if (cell.isDisabled(mp))
+      continue;
+    dofs.clear();
+    for (int i = 0; i < mapper.numVars(); ++i)
+    {
+      int const n = dofs.size();
+      dofs.resize(n + mapper.variable(i).numDofsPerCell());
+      mapper.variable(i).getCellDofs(dofs.data() + n, cell);
+    }
+    for (unsigned k = 0; k < dofs.size(); ++k)
+      for (unsigned l = 0; l < dofs.size(); ++l)
+        if (dofs[k] >= 0 && dofs[l] >= 0)
+          band = std::max(band, (index_t)std::abs(dofs[k] - dofs[l]));
+  }
+  return band;
+}
+
+TEST(DoffMapper, OrderingStrategies)
+{
+  typedef MeshTri MeshT;
+  typedef MeshT::VertexH VertexH;
+
+  MeshTri m;
+  IoMshTri io;
+
+  const char* mesh_in  = "meshes/simptri3.msh";
+
+  io.readFile(mesh_in, &m);
+
+  DofMapTri mapper(&m);
+  //                         ndpv,  ndpr,  ndpf,  ndpc
+  mapper.addVariable("vetor",     2,     0,     1,     0);
+  mapper.addVariable("pressao",   1,     0,     0,     1);
+
+  mapper.SetUp();
+  index_t const n_dofs = mapper.numDofs();
+  index_t const band_blocked = dofsBandwidth(mapper, &m);
+  std::vector<index_t> blocked;
+  getAllDofs(blocked, mapper, &m);
+
+  EDofOrdering const ords[] = {DOF_ORDER_BLOCKED, DOF_ORDER_INTERLEAVED, DOF_ORDER_CELL_LOCALITY, DOF_ORDER_RCM};
+
+  for (int o = 0; o < 4; ++o)
+  {
+    mapper.setOrdering(ords[o]);
+    mapper.SetUp();
+
+    EXPECT_EQ(n_dofs, mapper.numDofs());
+
+    // the permutation maps the blocked numbering to the current one
+    std::vector<index_t> const& perm = mapper.permutation();
+    ASSERT_EQ(n_dofs, (index_t)perm.size());
+    std::vector<index_t> dat;
+    getAllDofs(dat, mapper, &m);
+    ASSERT_EQ(blocked.size(), dat.size());
+    for (unsigned i = 0; i < dat.size(); ++i)
+      EXPECT_EQ(perm[blocked[i]], dat[i]);
+
+    // it is a permutation
+    std::sort(dat.begin(), dat.end());
+    dat.erase(std::unique(dat.begin(), dat.end()), dat.end());
+    ASSERT_EQ(n_dofs, (index_t)dat.size());
+    for (index_t i = 0; i < n_dofs; ++i)
+      EXPECT_EQ(i, dat[i]);
+
+    if (ords[o] == DOF_ORDER_INTERLEAVED)
+    {
+      // all components of a vertex are together
+      index_t dofs[3];
+      for (VertexH v = m.vertexBegin(), v_end = m.vertexEnd(); v != v_end; ++v)
+      {
+        mapper.variable(0).getVertexDofs(dofs, v);
+        mapper.variable(1).getVertexDofs(dofs+2, v);
+        EXPECT_EQ(dofs[0]+1, dofs[1]);
+        EXPECT_EQ(dofs[1]+1, dofs[2]);
+      }
+    }
+
+    if (ords[o] == DOF_ORDER_RCM)
+    {
+      EXPECT_LE(dofsBandwidth(mapper, &m), band_blocked);
+    }
+  }
+
+}
+
+// dofs of all variables, per entity: dat[0][vtx_id], dat[1][facet_id], dat[2][cell_id];
+// empty for disabled entities
+template<class MeshT, class DofMapperT>
+void getDofsPerEntity(std::vector<std::vector<index_t> > dat[3], DofMapperT const& mapper, MeshT const* mp)
+{
+  index_t dofs[20];
+
+  dat[0].assign(mp->numVerticesTotal(), std::vector<index_t>());
+  dat[1].assign(mp->numFacetsTotal(), std::vector<index_t>());
+  dat[2].assign(mp->numCellsTotal(), std::vector<index_t>());
+
+  for (int i = 0; i < mapper.numVars(); ++i)
+  {
+    for (index_t k = 0; k < (index_t)dat[0].size(); ++k)
+    {
+      if (typename MeshT::VertexH(k).isDisabled(mp))
+        continue;
+      mapper.variable(i).getVertexDofs(dofs, typename MeshT::VertexH(k));
+      dat[0][k].insert(dat[0][k].end(), dofs, dofs + mapper.variable(i).numDofsPerVertex());
+    }
+    for (index_t k = 0; k < (index_t)dat[1].size(); ++k)
+    {
+      if (typename MeshT::FacetH(k).isDisabled(mp))
+        continue;
+      mapper.variable(i).getFacetDofs(dofs, typename MeshT::FacetH(k));
+      dat[1][k].insert(dat[1][k].end(), dofs, dofs + mapper.variable(i).numDofsPerFacet());
+    }
+    for (index_t k = 0; k < (index_t)dat[2].size(); ++k)
+    {
+      if (typename MeshT::CellH(k).isDisabled(mp))
+        continue;
+      mapper.variable(i).getCellDofs(dofs, typename MeshT::CellH(k));
+      dat[2][k].insert(dat[2][k].end(), dofs, dofs + mapper.variable(i).numDofsPerCell());
+    }
+  }
+}
+
+// checks that the numbering of `mapper` is sound and consistent with `old_to_new`
+// for the entities that were not touched by `changes`
+template<class MeshT, class DofMapperT>
+void checkUpdatedDofs(std::vector<std::vector<index_t> > const old_dat[3], MeshChanges const& changes,
+                      std::vector<index_t> const& old_to_new, DofMapperT const& mapper, MeshT const* mp)
+{
+  // same number of dofs of a numbering from scratch
+  DofMapperT fresh(mp);
+  for (int i = 0; i < mapper.numVars(); ++i)
+  {
+    typename DofMapperT::VarT const& var = mapper.variable(i);
+    fresh.addVariable("v", var.numDofsInVertex(), var.numDofsInRidge(), var.numDofsInFacet(), var.numDofsInCell());
+  }
+  fresh.SetUp();
+  index_t const n_dofs = mapper.numDofs();
+  EXPECT_EQ(fresh.numDofs(), n_dofs);
+
+  // it is a permutation
+  std::vector<index_t> dat;
+  getAllDofs(dat, mapper, mp);
+  std::sort(dat.begin(), dat.end());
+  dat.erase(std::unique(dat.begin(), dat.end()), dat.end());
+  ASSERT_EQ(n_dofs, (index_t)dat.size());
+  for (index_t i = 0; i < n_dofs; ++i)
+    EXPECT_EQ(i, dat[i]);
+
+  std::vector<std::vector<index_t> > new_dat[3];
+  getDofsPerEntity(new_dat, mapper, mp);
+
+  std::vector<index_t> const* touched[3][2] = {{&changes.added_verts,  &changes.removed_verts},
+                                               {&changes.added_facets, &changes.removed_facets},
+                                               {&changes.added_cells,  &changes.removed_cells}};
+  for (int k = 0; k < 3; ++k)
+    for (index_t id = 0; id < (index_t)old_dat[k].size(); ++id)
+    {
+      if (std::count(touched[k][0]->begin(), touched[k][0]->end(), id) ||
+          std::count(touched[k][1]->begin(), touched[k][1]->end(), id))
+        continue;
+      // facets of cells that were removed may have changed their orientation, so
+      // the closure dofs are compared as sets
+      std::vector<index_t> mapped(old_dat[k][id]), current(new_dat[k][id]);
+      for (unsigned j = 0; j < mapped.size(); ++j)
+        if (mapped[j] >= 0)
+          mapped[j] = old_to_new.at(mapped[j]);
+      std::sort(mapped.begin(), mapped.end());
+      std::sort(current.begin(), current.end());
+      EXPECT_TRUE(mapped == current);
+    }
+}
+
+TEST(DoffMapper, UpdateDofsAfterLocalChanges)
+{
+  typedef MeshTri MeshT;
+  typedef MeshT::VertexH VertexH;
+  typedef MeshT::CellH CellH;
+
+  MeshTri m;
+  IoMshTri io;
+
+  const char* mesh_in  = "meshes/simptri3.msh";
+
+  io.readFile(mesh_in, &m);
+
+  DofMapTri mapper(&m);
+  //                         ndpv,  ndpr,  ndpf,  ndpc
+  mapper.addVariable("vetor",     2,     0,     1,     0);
+  mapper.addVariable("pressao",   1,     0,     0,     1);
+
+  mapper.SetUp();
+
+  MeshChanges changes;
+  m.trackChanges(&changes);
+
+  std::vector<std::vector<index_t> > old_dat[3];
+  std::vector<index_t> old_to_new;
+
+  // remove a cell: there are less dofs and the gaps must be closed
+  VertexH verts[3];
+  Real coords[3][3];
+  CellH(0).vertices(&m, verts);
+  for (int i = 0; i < 3; ++i)
+    verts[i].coord(&m, coords[i]);
+  index_t const n_dofs_before = mapper.numDofs();
+
+  getDofsPerEntity(old_dat, mapper, &m);
+  m.removeCell(CellH(0), true);
+  mapper.updateDofs(changes, old_to_new);
+
+  EXPECT_EQ(n_dofs_before, (index_t)old_to_new.size());
+  EXPECT_LT(mapper.numDofs(), n_dofs_before);
+  checkUpdatedDofs(old_dat, changes, old_to_new, mapper, &m);
+
+  // put it back: the freed numbers are reused
+  changes.clear();
+  getDofsPerEntity(old_dat, mapper, &m);
+  index_t const n_dofs_removed = mapper.numDofs();
+  for (int i = 0; i < 3; ++i)
+    if (verts[i].isDisabled(&m))
+      verts[i] = m.addVertex(coords[i]);
+  m.addCell(verts);
+  mapper.updateDofs(changes, old_to_new);
+
+  EXPECT_EQ(n_dofs_removed, (index_t)old_to_new.size());
+  for (index_t i = 0; i < n_dofs_removed; ++i)
+    EXPECT_EQ(i, old_to_new[i]);
+  EXPECT_EQ(n_dofs_before, mapper.numDofs());
+  checkUpdatedDofs(old_dat, changes, old_to_new, mapper, &m);
+
+  m.trackChanges(NULL);
+}
+
+TEST(DoffMapper, PartitionOwnership)
+{
+  typedef MeshTri MeshT;
+  typedef MeshT::CellH CellH;
+  typedef DofPartition<MeshT> DofPartitionT;
+
+  MeshTri m;
+  IoMshTri io;
+
+  const char* mesh_in  = "meshes/simptri3.msh";
+
+  io.readFile(mesh_in, &m);
+
+  DofMapTri mapper(&m);
+  //                         ndpv,  ndpr,  ndpf,  ndpc
+  mapper.addVariable("vetor",     2,     0,     1,     0);
+  mapper.addVariable("pressao",   1,     0,     0,     1);
+  mapper.SetUp();
+
+  index_t const n_dofs = mapper.numDofs();
+  int const n_parts = 3;
+
+  // split the cells by the x coordinate of their first vertex
+  Real xmin = 1e30, xmax = -1e30;
+  for (MeshT::VertexH v = m.vertexBegin(), v_end = m.vertexEnd(); v != v_end; ++v)
+  {
+    xmin = std::min(xmin, v.coord(&m, 0));
+    xmax = std::max(xmax, v.coord(&m, 0));
+  }
+  std::vector<int> cell_part(m.numCellsTotal(), 0);
+  for (CellH cell = m.cellBegin(), c_end = m.cellEnd(); cell != c_end; ++cell)
+  {
+    MeshT::VertexH verts[3];
+    cell.vertices(&m, verts);
+    int const p = (int)(n_parts * (verts[0].coord(&m, 0) - xmin) / (xmax - xmin + 1e-12));
+    cell_part[cell.id(&m)] = std::min(p, n_parts-1);
+  }
+
+  DofPartitionT part;
+  part.setUp(mapper, n_parts, cell_part.data());
+
+  EXPECT_EQ(n_dofs, mapper.numDofs());
+  EXPECT_EQ(n_parts, part.numParts());
+
+  // owned ranges cover all dofs
+  EXPECT_EQ(0, part.ownedBegin(0));
+  for (int p = 0; p < n_parts - 1; ++p)
+    EXPECT_EQ(part.ownedEnd(p), part.ownedBegin(p+1));
+  EXPECT_EQ(n_dofs, part.ownedEnd(n_parts-1));
+  for (index_t d = 0; d < n_dofs; ++d)
+    EXPECT_TRUE(part.isOwned(part.owner(d), d));
+
+  // every dof of a cell is seen by the cell's partition, ghosts are owned by lower partitions
+  std::vector<index_t> dofs;
+  index_t n_ghosts = 0;
+  for (int p = 0; p < n_parts; ++p)
+  {
+    n_ghosts += part.numGhosts(p);
+    for (index_t k = 0; k < part.numGhosts(p); ++k)
+      EXPECT_LT(part.owner(part.ghosts(p)[k]), p);
+  }
+  EXPECT_GT(n_ghosts, 0);
+
+  // assemble "how many cells contain each dof" per partition and sum the ghosts
+  std::vector<std::vector<Real> > local(n_parts);
+  std::vector<Real*> local_ptrs(n_parts);
+  for (int p = 0; p < n_parts; ++p)
+  {
+    local[p].assign(part.numLocal(p), 0.);
+    local_ptrs[p] = local[p].data();
+  }
+  std::vector<Real> global(n_dofs, 0.);
+  for (CellH cell = m.cellBegin(), c_end = m.cellEnd(); cell != c_end; ++cell)
+  {
+    int const p = cell_part[cell.id(&m)];
+    dofs.clear();
+    for (int i = 0; i < mapper.numVars(); ++i)
+    {
+      int const n = dofs.size();
+      dofs.resize(n + mapper.variable(i).numDofsPerCell());
+      mapper.variable(i).getCellDofs(dofs.data() + n, cell);
+    }
+    for (unsigned k = 0; k < dofs.size(); ++k)
+    {
+      index_t const l = part.localIndex(p, dofs[k]);
+      ASSERT_GE(l, 0);
+      local[p][l] += 1.;
+      global[dofs[k]] += 1.;
+    }
+  }
+
+  // send and receive plans match
+  for (int p = 0; p < n_parts; ++p)
+  {
+    DofPartitionT::ScatterPlan const& send = part.sendPlan(p);
+    EXPECT_EQ(part.numGhosts(p), (index_t)send.dofs.size());
+    for (int k = 0; k < send.numNeighbors(); ++k)
+    {
+      DofPartitionT::ScatterPlan const& recv = part.recvPlan(send.neighbors[k]);
+      int const kk = std::find(recv.neighbors.begin(), recv.neighbors.end(), p) - recv.neighbors.begin();
+      ASSERT_LT(kk, recv.numNeighbors());
+      EXPECT_TRUE(std::equal(send.dofs.begin() + send.offsets[k], send.dofs.begin() + send.offsets[k+1],
+                             recv.dofs.begin() + recv.offsets[kk]));
+    }
+  }
+
+  part.sumGhosts(local_ptrs.data());
+  for (int p = 0; p < n_parts; ++p)
+    for (index_t d = part.ownedBegin(p); d < part.ownedEnd(p); ++d)
+      EXPECT_EQ(global[d], local[p][part.localIndex(p, d)]);
+
+  part.updateGhosts(local_ptrs.data());
+  for (int p = 0; p < n_parts; ++p)
+    for (index_t k = 0; k < part.numGhosts(p); ++k)
+      EXPECT_EQ(global[part.ghosts(p)[k]], local[p][part.numOwned(p) + k]);
+}
+
+TEST(DoffMapper, ConstraintsElimination)
+{
+  typedef MeshTri MeshT;
+
+  MeshTri m;
+  IoMshTri io;
+
+  const char* mesh_in  = "meshes/simptri3.msh";
+
+  io.readFile(mesh_in, &m);
+
+  DofMapTri mapper(&m);
+  //                         ndpv,  ndpr,  ndpf,  ndpc
+  mapper.addVariable("u",         1,     0,     0,     0);
+  mapper.SetUp();
+
+  index_t const n_dofs = mapper.numDofs();
+
+  DofConstraints<MeshT> cons(&mapper);
+
+  int const tags[] = {1};
+  cons.addDirichletByTags(mapper, 0, 1, tags, 2.);
+  index_t const n_dir = cons.numConstrained();
+  ASSERT_GT(n_dir, 0);
+  ASSERT_LT(n_dir + 5, n_dofs);
+
+  index_t dir = -1;
+  std::vector<index_t> fr; // a, b, c, e, f
+  for (index_t d = 0; d < n_dofs; ++d)
+  {
+    if (cons.isConstrained(d))
+    {
+      if (dir < 0) dir = d;
+    }
+    else if (fr.size() < 5)
+      fr.push_back(d);
+  }
+
+  // c = 0.5 a + 0.5 b + 1,  e = c (chain)
+  index_t const ms1[] = {fr[0], fr[1]};
+  Real const ws1[] = {.5, .5};
+  cons.addConstraint(fr[2], 2, ms1, ws1, 1.);
+  Real const one = 1.;
+  cons.addConstraint(fr[3], 1, &fr[2], &one);
+  cons.close();
+
+  EXPECT_EQ(n_dir + 2, cons.numConstrained());
+  EXPECT_EQ(n_dofs - n_dir - 2, cons.numFreeDofs());
+
+  // free numbering is contiguous and keeps the order
+  index_t counter = 0;
+  for (index_t d = 0; d < n_dofs; ++d)
+    if (!cons.isConstrained(d))
+      EXPECT_EQ(counter++, cons.freeIndex(d));
+    else
+      EXPECT_EQ(-1, cons.freeIndex(d));
+
+  // e was expressed in terms of free dofs
+  index_t const* cols;
+  Real const* vals;
+  ASSERT_EQ(2, cons.constraintRow(fr[3], &cols, &vals));
+  EXPECT_EQ(cons.freeIndex(fr[0]), cols[0]);
+  EXPECT_EQ(cons.freeIndex(fr[1]), cols[1]);
+  EXPECT_DOUBLE_EQ(.5, vals[0]);
+  EXPECT_DOUBLE_EQ(.5, vals[1]);
+  EXPECT_DOUBLE_EQ(1., cons.inhomogeneity(fr[3]));
+  EXPECT_EQ(0, cons.constraintRow(dir, &cols, &vals));
+  EXPECT_DOUBLE_EQ(2., cons.inhomogeneity(dir));
+
+  // condensation: compare with C^T K C and C^T (F - K b)
+  int const n = 5;
+  index_t const edofs[n] = {dir, fr[0], fr[2], fr[3], fr[4]};
+  Real Ke[n*n], Fe[n];
+  for (int i = 0; i < n; ++i)
+  {
+    Fe[i] = i + 1.;
+    for (int j = 0; j < n; ++j)
+      Ke[i*n+j] = 1./(1.+i+j) + (i==j ? 3. : 0.);
+  }
+
+  // dense C (n x n_free) and b of the element
+  index_t const n_free = cons.numFreeDofs();
+  std::vector<Real> C(n*n_free, 0.), b(n, 0.);
+  for (int i = 0; i < n; ++i)
+  {
+    if (cons.freeIndex(edofs[i]) >= 0)
+      C[i*n_free + cons.freeIndex(edofs[i])] = 1.;
+    index_t const nc = cons.constraintRow(edofs[i], &cols, &vals);
+    for (index_t k = 0; k < nc; ++k)
+      C[i*n_free + cols[k]] += vals[k];
+    b[i] = cons.inhomogeneity(edofs[i]);
+  }
+
+  std::vector<index_t> fdofs;
+  std::vector<Real> Kf, Ff;
+  cons.condense(n, edofs, Ke, Fe, fdofs, Kf, Ff);
+  int const nf = fdofs.size();
+  EXPECT_EQ(3, nf); // a, b and f
+  for (int I = 0; I < nf; ++I)
+  {
+    Real f_ref = 0;
+    for (int i = 0; i < n; ++i)
+    {
+      Real fi = Fe[i];
+      for (int j = 0; j < n; ++j)
+        fi -= Ke[i*n+j]*b[j];
+      f_ref += C[i*n_free + fdofs[I]]*fi;
+    }
+    EXPECT_NEAR(f_ref, Ff[I], 1e-12);
+
+    for (int J = 0; J < nf; ++J)
+    {
+      Real k_ref = 0;
+      for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+          k_ref += C[i*n_free + fdofs[I]]*Ke[i*n+j]*C[j*n_free + fdofs[J]];
+      EXPECT_NEAR(k_ref, Kf[I*nf+J], 1e-12);
+    }
+  }
+
+  // distribute
+  std::vector<Real> u_free(n_free), u(n_dofs);
+  for (index_t k = 0; k < n_free; ++k)
+    u_free[k] = k*0.1;
+  cons.distribute(u_free.data(), u.data());
+  EXPECT_DOUBLE_EQ(2., u[dir]);
+  EXPECT_DOUBLE_EQ(u_free[cons.freeIndex(fr[4])], u[fr[4]]);
+  EXPECT_DOUBLE_EQ(.5*u[fr[0]] + .5*u[fr[1]] + 1., u[fr[2]]);
+  EXPECT_DOUBLE_EQ(u[fr[2]], u[fr[3]]);
+}
+
+TEST(DoffMapper, ConstraintsChains)
+{
+  typedef MeshTri MeshT;
+
+  MeshTri m;
+  IoMshTri io;
+  io.readFile("meshes/simptri3.msh", &m);
+
+  DofMapTri mapper(&m);
+  //                 ndpv,  ndpr,  ndpf,  ndpc
+  mapper.addVariable("u",  1,     0,     0,    20);
+  mapper.SetUp();
+  index_t const n_dofs = mapper.numDofs();
+  ASSERT_GT(n_dofs, 100);
+
+  // u_d = (u_{d-1} + u_{d-2})/2 + 1: every dof is a master of two others, so
+  // expanding the chains without reusing the closed rows takes ~1.6^n_dofs steps
+  DofConstraints<MeshT> cons(&mapper);
+  Real const ws[] = {.5, .5};
+  for (index_t d = n_dofs - 1; d >= 2; --d)
+  {
+    index_t const ms[] = {d - 1, d - 2};
+    cons.addConstraint(d, 2, ms, ws, 1.);
+  }
+  cons.close();
+  EXPECT_EQ(2, cons.numFreeDofs());
+
+  index_t const* cols;
+  Real const* vals;
+  for (index_t d = 2; d < n_dofs; ++d)
+    ASSERT_EQ(2, cons.constraintRow(d, &cols, &vals));
+
+  Real const u_free[] = {1., -2.};
+  std::vector<Real> u(n_dofs);
+  cons.distribute(u_free, u.data());
+  EXPECT_DOUBLE_EQ(1., u[0]);
+  EXPECT_DOUBLE_EQ(-2., u[1]);
+  for (index_t d = 2; d < n_dofs; ++d)
+    EXPECT_NEAR(.5*u[d-1] + .5*u[d-2] + 1., u[d], 1e-10);
+
+  // cycles are errors
+  DofConstraints<MeshT> cyc(&mapper);
+  Real const one = 1.;
+  index_t const a = 0, b = 1, c = 2;
+  cyc.addConstraint(a, 1, &b, &one);
+  cyc.addConstraint(b, 1, &c, &one);
+  cyc.addConstraint(c, 1, &a, &one);
+  EXPECT_THROW(cyc.close(), std::runtime_error);
+}
+
+// reordering as it was done before the orientation codes (computed per call)
+template<class MeshT>
+void reorderDofsReference(MeshT const* mp, typename MeshT::CellH c, int n, int ncomps, index_t * dofs)
+{
+  typedef typename MeshT::VertexH VertexH;
+
+  if (n<3)
+    return;
+
+  int const n_edges = MeshT::cell_dim == 2 ? MeshT::facets_per_cell : MeshT::ridges_per_cell;
+  for (int i = 0; i < n_edges; ++i)
+  {
+    bool reverse = false;
+    if (MeshT::cell_dim == 2)
+    {
+      int anchor;
+      if (c.facet(mp,i).icellSide0(mp) == c)
+        continue;
+      c.adjSideAndAnchor(mp, i, &anchor);
+      reverse = !anchor;
+    }
+    else
+    {
+      if (c.ridge(mp,i).icell(mp) == c)
+        continue;
+      VertexH ridge_verts_my[2];
+      VertexH ridge_verts_other[2];
+      c.ridge(mp, i).vertices(mp, ridge_verts_other);
+      c.ridgeVertices(mp, i, ridge_verts_my);
+      reverse = ridge_verts_other[0] != ridge_verts_my[0];
+    }
+    if (reverse)
+    {
+      int k = ncomps*( MeshT::verts_per_cell + i*(n-1));
+      int l = ncomps*( MeshT::verts_per_cell + (i+1)*(n-1) - 1);
+      for (; l>k; k += ncomps, l -= ncomps)
+        for (int m = 0; m < ncomps; ++m)
+          std::swap(dofs[k+m], dofs[l+m]);
+    }
+  }
+
+  if (MeshT::cell_dim == 2 || n<4)
+    return;
+
+  std::vector<int> map;
+  int const map_size = (n-1)*(n-2)/2;
+  for (int i = 0; i < MeshT::facets_per_cell; ++i)
+  {
+    if (c.facet(mp,i).icellSide0(mp) == c)
+      continue;
+    int anchor;
+    c.adjSideAndAnchor(mp, i, &anchor);
+    mapTriInteriorPtsToOpp(n, anchor, map);
+    index_t * v = dofs + ncomps*( 4+6*(n-1)  +  i*map_size ) ;
+    for (int k=0; k<map_size; ++k)
+      while (map[k] != k)
+      {
+        int& mmk = map[map[k]];
+        for (int j = 0; j < ncomps; ++j)
+          std::swap(v[ncomps*map[k]+j], v[ncomps*mmk+j]);
+        std::swap(map[k], mmk);
+      }
+  }
+}
+
+template<class MeshT>
+void checkReorderDofsLagrange(MeshT * mp)
+{
+  typedef typename MeshT::CellH CellH;
+
+  int n_reordered = 0;
+  for (int n = 1; n <= 14; ++n)
+  {
+    int const n_nodes = MeshT::cell_dim == 2 ? (n+1)*(n+2)/2 : (n+1)*(n+2)*(n+3)/6;
+    for (int ncomps = 1; ncomps <= 3; ++ncomps)
+    {
+      std::vector<index_t> dofs(n_nodes*ncomps), ref;
+      for (CellH c = mp->cellBegin(), c_end = mp->cellEnd(); c != c_end; ++c)
+      {
+        if (c.isDisabled(mp))
+          continue;
+        for (unsigned k = 0; k < dofs.size(); ++k)
+          dofs[k] = k;
+        ref = dofs;
+        reorderDofsLagrange<MeshT,index_t>(mp, c, n, ncomps, dofs.data());
+        reorderDofsReference(mp, c, n, ncomps, ref.data());
+        EXPECT_TRUE(dofs == ref) << "n=" << n << " ncomps=" << ncomps << " cell=" << c.id(mp);
+        if (mp->orientationCode(c))
+          ++n_reordered;
+      }
+    }
+  }
+  EXPECT_GT(n_reordered, 0);
+}
+
+TEST(DoffMapper, ReorderDofsLagrangeTables)
+{
+  {
+    MeshTri m;
+    IoMshTri io;
+    io.readFile("meshes/simptri3.msh", &m);
+    checkReorderDofsLagrange(&m);
+
+    // the codes are recomputed after topological changes
+    m.removeCell(MeshTri::CellH(0), true);
+    checkReorderDofsLagrange(&m);
+  }
+  {
+    MeshTet m;
+    IoMshTet io;
+    io.readFile("meshes/simptet4.msh", &m);
+    checkReorderDofsLagrange(&m);
+
+    m.removeCell(MeshTet::CellH(0), true);
+    checkReorderDofsLagrange(&m);
+
+    // and after adding a cell, here one removed before with its vertices rotated
+    MeshTet::VertexH v[4];
+    MeshTet::CellH const c(1);
+    for (int i = 0; i < 4; ++i)
+      v[i] = c.vertex(&m, i);
+    m.removeCell(c, false);
+    checkReorderDofsLagrange(&m);
+    MeshTet::VertexH const w[4] = {v[0], v[2], v[3], v[1]}; // same orientation, other ridges
+    m.addCell(w);
+    checkReorderDofsLagrange(&m);
+  }
+}
+
+// checks dofInfo() against the VarDofs tables
+template<class MeshT, class DofMapperT>
+void checkInverseMap(DofMapperT const& mapper, MeshT const* mp)
+{
+  typedef typename MeshT::VertexH VertexH;
+  typedef typename MeshT::FacetH FacetH;
+  typedef typename MeshT::CellH CellH;
+
+  index_t dofs[8];
+  std::vector<bool> seen(mapper.numDofs(), false);
+  for (int i = 0; i < mapper.numVars(); ++i)
+  {
+    for (VertexH v = mp->vertexBegin(), v_end = mp->vertexEnd(); v != v_end; ++v)
+    {
+      int const n = mapper.variable(i).numDofsInVertex();
+      mapper.variable(i).getVertexDofs(dofs, v);
+      for (int j = 0; j < n; ++j)
+      {
+        if (dofs[j] < 0 || seen[dofs[j]])
+          continue;
+        seen[dofs[j]] = true;
+        DofInfo const& info = mapper.dofInfo(dofs[j]);
+        EXPECT_EQ(i, info.var);
+        EXPECT_EQ(DOF_AT_VERTEX, info.kind);
+        EXPECT_EQ(v.id(mp), info.entity);
+        EXPECT_EQ(j, info.comp);
+      }
+    }
+    for (FacetH f = mp->facetBegin(), f_end = mp->facetEnd(); f != f_end; ++f)
+    {
+      int const n = mapper.variable(i).numDofsInFacet();
+      mapper.variable(i).getDofsInFacet(dofs, f);
+      for (int j = 0; j < n; ++j)
+      {
+        DofInfo const& info = mapper.dofInfo(dofs[j]);
+        EXPECT_EQ(i, info.var);
+        EXPECT_EQ(DOF_AT_FACET, info.kind);
+        EXPECT_EQ(f.id(mp), info.entity);
+        EXPECT_EQ(j, info.comp);
+      }
+    }
+    for (CellH c = mp->cellBegin(), c_end = mp->cellEnd(); c != c_end; ++c)
+    {
+      int const n = mapper.variable(i).numDofsInCell();
+      mapper.variable(i).getDofsInCell(dofs, c);
+      for (int j = 0; j < n; ++j)
+      {
+        DofInfo const& info = mapper.dofInfo(dofs[j]);
+        EXPECT_EQ(i, info.var);
+        EXPECT_EQ(DOF_AT_CELL, info.kind);
+        EXPECT_EQ(c.id(mp), info.entity);
+        EXPECT_EQ(j, info.comp);
+      }
+    }
+  }
+}
+
+TEST(DoffMapper, InverseDofMap)
+{
+  typedef MeshTri MeshT;
+  typedef MeshT::VertexH VertexH;
+
+  MeshTri m;
+  IoMshTri io;
+
+  io.readFile("meshes/simptri3.msh", &m);
+
+  DofMapTri mapper(&m);
+  //                         ndpv,  ndpr,  ndpf,  ndpc
+  mapper.addVariable("vetor",     2,     0,     1,     0);
+  mapper.addVariable("pressao",   1,     0,     0,     1);
+  mapper.SetUp();
+
+  EXPECT_FALSE(mapper.hasInverseMap());
+  mapper.buildInverseMap();
+  EXPECT_TRUE(mapper.hasInverseMap());
+  checkInverseMap(mapper, &m);
+
+  // kept up to date
+  mapper.setOrdering(DOF_ORDER_RCM);
+  mapper.SetUp();
+  checkInverseMap(mapper, &m);
+
+  // linked dofs are described by the first entity
+  index_t dofs1[3], dofs2[3];
+  mapper.setOrdering(DOF_ORDER_BLOCKED);
+  mapper.SetUp();
+  mapper.variable(0).getVertexDofs(dofs1,   VertexH(0));
+  mapper.variable(1).getVertexDofs(dofs1+2, VertexH(0));
+  mapper.variable(0).getVertexDofs(dofs2,   VertexH(7));
+  mapper.variable(1).getVertexDofs(dofs2+2, VertexH(7));
+  mapper.linkDofs(3, dofs1, dofs2);
+  ASSERT_EQ(mapper.numDofs(), (index_t)3*m.numVertices() + m.numFacets() + m.numCells() - 3);
+  checkInverseMap(mapper, &m);
+  index_t d[2];
+  mapper.variable(0).getVertexDofs(d, VertexH(7));
+  EXPECT_EQ(0, mapper.dofInfo(d[0]).entity);
+}
 
 } // DOF_MAPPER_TEST_CPP
@@ -35,6 +35,7 @@
 #include <Alelib/DofMapper>
 #include <Alelib/Mesh>
 #include <Alelib/IO>
+#include <Alelib/ShapeFunction>
 #include <algorithm>
 #include <cmath>
 #include <typeinfo>
@@ -1156,6 +1157,388 @@ TEST(MshIoTests, ReadFileTest)
 }
 
 
+// checks the cached geometry of every cell against the vertex coordinates
+template<class MeshT>
+void checkGeometryCache(MeshT const& m)
+{
+  typedef typename MeshT::CellH CellH;
+  typedef typename MeshT::VertexH VertexH;
+  int const dim = MeshT::cell_dim, sd = MeshT::SpaceDim, nf = MeshT::facets_per_cell;
+  Real x[4*3];
+
+  for (index_t id = 0; id < (index_t)m.numCellsTotal(); ++id)
+  {
+    CellH c(id);
+    if (c.isDisabled(&m))
+      continue;
+    c.verticesCoord(&m, x);
+
+    // J^-1 J = I
+    for (int j = 0; j < dim; ++j)
+      for (int l = 0; l < dim; ++l)
+      {
+        Real s = 0;
+        for (int i = 0; i < sd; ++i)
+          s += m.cellInvJacobians(j, i)[id]*(x[(l+1)*sd + i] - x[i]);
+        ASSERT_NEAR(j == l ? 1. : 0., s, 1e-12);
+      }
+
+    // volume from the cross product / triple product of the edges
+    Real const* e0 = x + sd, *e1 = x + 2*sd, *e2 = x + 3*sd;
+    Real a[3], b[3], n[3];
+    for (int i = 0; i < 3; ++i)
+    {
+      a[i] = e0[i] - x[i];
+      b[i] = e1[i] - x[i];
+    }
+    n[0] = a[1]*b[2] - a[2]*b[1];
+    n[1] = a[2]*b[0] - a[0]*b[2];
+    n[2] = a[0]*b[1] - a[1]*b[0];
+    Real vol = dim == 2 ? std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2])/2.
+                        : std::fabs(n[0]*(e2[0]-x[0]) + n[1]*(e2[1]-x[1]) + n[2]*(e2[2]-x[2]))/6.;
+    ASSERT_NEAR(vol, m.cellVolumes()[id], 1e-13);
+    ASSERT_NEAR(vol, std::fabs(m.cellDetJacobians()[id])*(dim == 2 ? 0.5 : 1./6.), 1e-13);
+
+    // closed surface: sum of area*normal vanishes; normals are unit and point outwards
+    Real closure[3] = {0,0,0}, centroid[3] = {0,0,0};
+    for (int v = 0; v <= dim; ++v)
+      for (int i = 0; i < sd; ++i)
+        centroid[i] += x[v*sd + i]/(dim + 1);
+    for (int f = 0; f < nf; ++f)
+    {
+      VertexH fv[3];
+      Real y[3];
+      c.facetVertices(&m, f, fv);
+      fv[0].coord(&m, y);
+      Real len = 0, out = 0;
+      for (int i = 0; i < sd; ++i)
+      {
+        Real const ni = m.cellFacetNormals(f, i)[id];
+        len += ni*ni;
+        out += ni*(y[i] - centroid[i]);
+        closure[i] += m.cellFacetAreas(f)[id]*ni;
+      }
+      ASSERT_NEAR(1., len, 1e-12);
+      ASSERT_GT(out, 0.);
+    }
+    for (int i = 0; i < sd; ++i)
+      ASSERT_NEAR(0., closure[i], 1e-12);
+  }
+}
+
+
+template<class MeshT>
+void checkGeometryCacheUpdates(const char* mesh_in)
+{
+  typedef typename MeshT::VertexH VertexH;
+  MeshT m;
+  MeshIoMsh<MeshT> io;
+  io.readFile(mesh_in, &m);
+
+  m.enableGeometryCache();
+  EXPECT_FALSE(m.geometryCacheUpToDate());
+  EXPECT_EQ((index_t)m.numCells(), m.updateGeometryCache());
+  EXPECT_TRUE(m.geometryCacheUpToDate());
+  checkGeometryCache(m);
+  EXPECT_EQ(0u, m.updateGeometryCache());
+
+  // move two vertices: only their stars are recomputed
+  VertexH v0(0), v1(m.numVerticesTotal()/2);
+  Real x[3];
+  v0.coord(&m, x);
+  x[0] += 0.01;  x[1] -= 0.02;
+  v0.setCoord(&m, x);
+  v1.coord(&m, x);
+  x[1] += 0.015;
+  v1.setCoord(&m, x);
+  EXPECT_FALSE(m.geometryCacheUpToDate());
+
+  std::vector<typename MeshT::CellH> star = v0.star(&m), star1 = v1.star(&m);
+  star.insert(star.end(), star1.begin(), star1.end());
+  std::sort(star.begin(), star.end());
+  index_t const nstar = std::unique(star.begin(), star.end()) - star.begin();
+  EXPECT_EQ(nstar, m.updateGeometryCache());
+  EXPECT_LT(nstar, (index_t)m.numCells());
+  checkGeometryCache(m);
+
+  // removing a cell changes no other cell; adding one computes only it
+  typename MeshT::CellH const c(0);
+  VertexH cv[MeshT::verts_per_cell];
+  for (int i = 0; i < MeshT::verts_per_cell; ++i)
+    cv[i] = c.vertex(&m, i);
+  m.removeCell(c, false);
+  EXPECT_TRUE(m.geometryCacheUpToDate());
+  m.addCell(cv);
+  EXPECT_FALSE(m.geometryCacheUpToDate());
+  EXPECT_EQ(1u, m.updateGeometryCache());
+  checkGeometryCache(m);
+
+  // the partial update gives the same as a full one
+  index_t const nc = m.numCellsTotal();
+  std::vector<Real> partial;
+  for (int f = 0; f < MeshT::facets_per_cell; ++f)
+    for (int i = 0; i < MeshT::SpaceDim; ++i)
+      partial.insert(partial.end(), m.cellFacetNormals(f, i), m.cellFacetNormals(f, i) + nc);
+  partial.insert(partial.end(), m.cellVolumes(), m.cellVolumes() + nc);
+  m.enableGeometryCache();
+  EXPECT_EQ((index_t)m.numCells(), m.updateGeometryCache());
+  int k = 0;
+  for (int f = 0; f < MeshT::facets_per_cell; ++f)
+    for (int i = 0; i < MeshT::SpaceDim; ++i)
+      for (index_t c = 0; c < nc; ++c)
+        ASSERT_EQ(partial[k++], m.cellFacetNormals(f, i)[c]);
+  for (index_t c = 0; c < nc; ++c)
+    ASSERT_EQ(partial[k++], m.cellVolumes()[c]);
+
+  m.enableGeometryCache(false);
+  EXPECT_FALSE(m.geometryCacheEnabled());
+}
+
+TEST(MeshTest, GeometryCache)
+{
+  checkGeometryCacheUpdates<MeshTri>("meshes/simple_tri0.msh"); // triangles in R^3
+  checkGeometryCacheUpdates<MeshTet>("meshes/simple_tet0.msh");
+}
+
+// measure of the mesh through the isoparametric map of its geometry nodes
+template<class MeshT>
+Real isoparametricMeasure(const char* mesh_in, int expected_degree, int* naffine = NULL, bool linear = false)
+{
+  typedef typename MeshT::CellH CellH;
+  MeshT m;
+  MeshIoMsh<MeshT> R;
+  R.readFile(mesh_in, &m);
+  EXPECT_EQ(expected_degree, m.geometryDegree());
+
+  std::vector<CellH> cells;
+  for (CellH c = m.cellBegin(); c != m.cellEnd(); ++c)
+    if (!c.isDisabled(&m))
+      cells.push_back(c);
+
+  CellGeometry geo(MeshT::CellType, MeshT::SpaceDim, linear ? 1 : m.geometryDegree());
+  Quadrature quadr;
+  quadr.setType(MeshT::CellType, 2*m.geometryDegree() + 2);
+  geo.setPoints(quadr);
+  geo.compute(&m, cells.data(), cells.size(), GEOM_JxW);
+
+  Real vol = 0;
+  if (naffine)
+    *naffine = 0;
+  for (int k = 0; k < (int)cells.size(); ++k)
+  {
+    for (int qp = 0; qp < geo.numPoints(); ++qp)
+      vol += geo.JxW(k)[qp];
+    if (naffine)
+      *naffine += geo.isAffine(k);
+  }
+  return vol;
+}
+
+TEST(MeshTest, HighOrderGeometry)
+{
+  Real const pi = 3.14159265358979323846;
+
+  // the unit disk with 4 triangles, of degree 1, 2, 3, 4 and 10
+  Real err[5];
+  err[0] = std::fabs(isoparametricMeasure<MeshTri>("meshes/circle_tri0.msh", 1) - pi);
+  err[1] = std::fabs(isoparametricMeasure<MeshTri>("meshes/circle_tri1.msh", 2) - pi);
+  err[2] = std::fabs(isoparametricMeasure<MeshTri>("meshes/circle_tri2.msh", 3) - pi);
+  err[3] = std::fabs(isoparametricMeasure<MeshTri>("meshes/circle_tri3.msh", 4) - pi);
+  err[4] = std::fabs(isoparametricMeasure<MeshTriNoC>("meshes/circle_tri9.msh", 10) - pi);
+  EXPECT_NEAR(pi - 2., err[0], 1e-10);
+  for (int i = 1; i < 5; ++i)
+    EXPECT_LT(err[i], err[i-1]/4.) << "degree index " << i;
+
+  // half of the unit ball with 4 tetrahedra, of degree 2 and 3
+  Real const ball = 2.*pi/3.;
+  Real const vol0 = isoparametricMeasure<MeshTet>("meshes/sphere_tet1.msh", 2, NULL, true);
+  Real const vol1 = isoparametricMeasure<MeshTet>("meshes/sphere_tet1.msh", 2);
+  Real const vol2 = isoparametricMeasure<MeshTetNoC>("meshes/sphere_tet2.msh", 3);
+  EXPECT_NEAR(4./6., vol0, 1e-10);
+  EXPECT_LT(std::fabs(vol1 - ball), std::fabs(vol0 - ball)/4.);
+  EXPECT_LT(std::fabs(vol2 - ball), std::fabs(vol1 - ball));
+
+  // tetrahedra of degree 4 are read with straight edges
+  isoparametricMeasure<MeshTet>("meshes/sphere_tet3.msh", 1);
+
+  // straight high-order cells take the affine path and give the measure of the linear mesh
+  int naffine;
+  Real const area6 = isoparametricMeasure<MeshTri>("meshes/cortri6.msh", 2, &naffine);
+  EXPECT_NEAR(isoparametricMeasure<MeshTri>("meshes/cortri3.msh", 1), area6, 1e-10);
+  EXPECT_EQ(66, naffine);
+  Real const vol27 = isoparametricMeasure<MeshHex>("meshes/corhex27.msh", 2, &naffine);
+  EXPECT_NEAR(isoparametricMeasure<MeshHex>("meshes/corhex8.msh", 1), vol27, 1e-10);
+}
+
+
+// P1 weights of the vertices at the Lagrange nodes of degree n of a simplex: w[k*(dim+1) + j]
+static std::vector<Real> simplexNodeWeights(int dim, int n)
+{
+  std::vector<double> pts;
+  if (dim == 2)
+    genTriParametricPts(n, pts);
+  else
+    genTetParametricPts(n, pts);
+  int const np = pts.size()/dim;
+  std::vector<Real> w(np*(dim + 1));
+  for (int k = 0; k < np; ++k)
+  {
+    w[k*(dim + 1)] = 1.;
+    for (int d = 0; d < dim; ++d)
+    {
+      w[k*(dim + 1) + d + 1] = pts[k*dim + d];
+      w[k*(dim + 1)] -= pts[k*dim + d];
+    }
+  }
+  return w;
+}
+
+// the nodes of the straight cell c
+template<class MeshT>
+void straightGeometryNodes(MeshT const& m, typename MeshT::CellH c, std::vector<Real> const& w, Real* X)
+{
+  int const nv = MeshT::verts_per_cell, sd = MeshT::SpaceDim;
+  int const np = w.size()/nv;
+  typename MeshT::VertexH verts[MeshT::verts_per_cell];
+  c.vertices(&m, verts);
+  for (int k = 0; k < np; ++k)
+    for (int i = 0; i < sd; ++i)
+    {
+      X[k*sd + i] = 0;
+      for (int j = 0; j < nv; ++j)
+        X[k*sd + i] += w[k*nv + j]*verts[j].coord(&m, i);
+    }
+}
+
+TEST(MeshTest, HighOrderGeometryChanges)
+{
+  // the nodes of the shared edges and faces are stored once, so every cell sees the same
+  // nodes, and they follow the vertices
+  {
+    typedef MeshTri MeshT;
+    typedef MeshT::CellH CellH;
+    typedef MeshT::VertexH VertexH;
+    int const sd = MeshT::SpaceDim, nv = MeshT::verts_per_cell;
+    MeshT m;
+    MeshIoMsh<MeshT> R;
+    R.readFile("meshes/circle_tri2.msh", &m);
+    ASSERT_EQ(3, m.geometryDegree());
+    int const np = MeshT::numGeometryNodes(3);
+    index_t const nc = m.numCellsTotal();
+    std::vector<Real> const w = simplexNodeWeights(2, 3);
+
+    // the mesh keeps the nodes of the file
+    DofMapper<MeshT> map(&m);
+    map.addVariable("coordinate", sd, 0, 2*sd, sd);
+    map.SetUp();
+    std::vector<Real> coords(map.numDofs()), kept(map.numDofs());
+    R.readCoordinates("meshes/circle_tri2.msh", &m, coords.data(), map.variable(0));
+    R.getCoordinates(&m, kept.data(), map.variable(0));
+    for (int i = 0; i < (int)coords.size(); ++i)
+      EXPECT_NEAR(coords[i], kept[i], 1e-14);
+
+    std::vector<Real> X0(nc*np*sd), X(np*sd);
+    for (index_t c = 0; c < nc; ++c)
+      m.cellGeometryNodes(CellH(c), &X0[c*np*sd]);
+
+    // moving a vertex moves the nodes around it by its P1 weight
+    VertexH v = CellH(0).vertex(&m, 0);
+    Real const d[3] = {0.1, -0.05, 0.02};
+    Real x[3];
+    v.coord(&m, x);
+    for (int i = 0; i < sd; ++i)
+      x[i] += d[i];
+    v.setCoord(&m, x);
+    for (index_t c = 0; c < nc; ++c)
+    {
+      m.cellGeometryNodes(CellH(c), X.data());
+      int j = -1;
+      for (int k = 0; k < nv; ++k)
+        if (CellH(c).vertex(&m, k) == v)
+          j = k;
+      for (int k = 0; k < np; ++k)
+        for (int i = 0; i < sd; ++i)
+          EXPECT_NEAR(X0[(c*np + k)*sd + i] + (j < 0 ? 0. : w[k*nv + j]*d[i]), X[k*sd + i], 1e-14) << "cell " << c << " node " << k;
+    }
+  }
+
+  // tetrahedra of degree 4: faces with 3 nodes, in any orientation
+  {
+    typedef MeshTet MeshT;
+    typedef MeshT::CellH CellH;
+    typedef MeshT::VertexH VertexH;
+    int const sd = MeshT::SpaceDim;
+    MeshT m;
+    MeshIoMsh<MeshT> R;
+    R.readFile("meshes/sphere_tet0.msh", &m);
+    m.setGeometryDegree(4);
+    int const np = MeshT::numGeometryNodes(4);
+    index_t const nc = m.numCellsTotal();
+    std::vector<Real> const w = simplexNodeWeights(3, 4);
+    std::vector<Real> X(np*sd), Y(np*sd);
+    for (index_t c = 0; c < nc; ++c)
+    {
+      m.cellGeometryNodes(CellH(c), X.data());
+      straightGeometryNodes(m, CellH(c), w, Y.data());
+      for (int k = 0; k < np*sd; ++k)
+        ASSERT_NEAR(Y[k], X[k], 1e-14) << "cell " << c;
+    }
+
+    // curve the cells, with nodes that tell where they come from
+    std::vector<Real> X0(nc*np*sd);
+    for (index_t c = 0; c < nc; ++c)
+    {
+      m.cellGeometryNodes(CellH(c), &X0[c*np*sd]);
+      for (int k = 4; k < np; ++k)
+        for (int i = 0; i < sd; ++i)
+          X0[(c*np + k)*sd + i] += 1e-3*std::sin(1. + 7.*X0[(c*np + k)*sd + (i + 1)%sd]);
+    }
+    for (index_t c = 0; c < nc; ++c)
+      m.setCellGeometryNodes(CellH(c), &X0[c*np*sd]);
+    for (index_t c = 0; c < nc; ++c)
+    {
+      m.cellGeometryNodes(CellH(c), X.data());
+      for (int k = 0; k < np*sd; ++k)
+        ASSERT_NEAR(X0[c*np*sd + k], X[k], 1e-14) << "cell " << c;
+    }
+
+    // the facets and ridges of a removed cell pass to its neighbors, which keep their nodes
+    VertexH verts[4];
+    CellH(0).vertices(&m, verts);
+    m.removeCell(CellH(0), false);
+    for (index_t c = 1; c < nc; ++c)
+    {
+      m.cellGeometryNodes(CellH(c), X.data());
+      for (int k = 0; k < np*sd; ++k)
+        ASSERT_NEAR(X0[c*np*sd + k], X[k], 1e-14) << "cell " << c;
+    }
+
+    // the cell added in its place takes the nodes of the entities it shares, and straight ones
+    // on the others, not the ones of the removed cell
+    CellH const c0 = m.addCell(verts);
+    ASSERT_EQ(CellH(0), c0);
+    m.cellGeometryNodes(c0, X.data());
+    straightGeometryNodes(m, c0, w, Y.data());
+    int const interior = 4 + 6*3 + 4*3;
+    for (int i = 0; i < sd; ++i)
+      EXPECT_NEAR(Y[interior*sd + i], X[interior*sd + i], 1e-14);
+    for (int f = 0; f < 4; ++f)
+    {
+      bool const shared = c0.facet(&m, f).valency(&m) > 1;
+      for (int k = 4 + 6*3 + 3*f; k < 4 + 6*3 + 3*(f + 1); ++k)
+        for (int i = 0; i < sd; ++i)
+          EXPECT_NEAR(shared ? X0[k*sd + i] : Y[k*sd + i], X[k*sd + i], 1e-14) << "facet " << f;
+    }
+    m.setCellGeometryNodes(c0, &X0[0]);
+    for (index_t c = 0; c < nc; ++c)
+    {
+      m.cellGeometryNodes(CellH(c), X.data());
+      for (int k = 0; k < np*sd; ++k)
+        ASSERT_NEAR(X0[c*np*sd + k], X[k], 1e-14) << "cell " << c;
+    }
+  }
+}
+
 
 // ------------------------------------------
 // CUSTOM COORDINATES STORAGE VERSION
@@ -37,6 +37,8 @@
 #include <Alelib/ShapeFunction>
 #include <Alelib/Quadrature>
 #include <Alelib/src/shape_functions/parametric_pts.hpp>
+#include <Alelib/src/util/simd.hpp>
+#include <Alelib/src/shape_functions/shape_types/sf_simplex_bernstein.hpp>
 #include <algorithm>
 #include <limits> // for std::numeric_limits<Real>::epsilon()
 //#include <functional>
@@ -751,6 +753,400 @@ TEST_F(ShapeTet1Tests, LagrangeBubble)
 }
 
 
+TEST(ShapeFunctionTests, BatchedTabulation)
+{
+  char const* types[] = {"Lagrange", "Bubble", "Lagrange+Bubble", "Bubble+Lagrange"};
+  std::vector<double> pts;
+  std::vector<Real> out;
+  ShapeFunction sf;
+
+  for (int dim = 1; dim <= 3; ++dim)
+  for (int t = 0; t < 4; ++t)
+  for (int deg = (t==1 ? 1 : 0); deg <= (t==1 ? 1 : 4); ++deg)
+  {
+    sf.setType(types[t], dim, deg);
+    switch (dim)
+    {
+      case 1: genLineParametricPts(3, pts); break;
+      case 2: genTriParametricPts(3, pts); break;
+      case 3: genTetParametricPts(3, pts); break;
+    }
+    int const npts = pts.size()/dim;
+    int const nf   = sf.numDofs();
+
+    out.assign(sf.tabulateSize(npts,0), -1.);
+    sf.tabulate(npts, pts.data(), 0, out.data());
+    for (int p = 0; p < npts; ++p)
+      for (int i = 0; i < nf; ++i)
+        EXPECT_NEAR(sf.value(&pts[p*dim], i), out[p*nf + i], ALE_TOL) << types[t] << " " << dim << " " << deg;
+
+    out.assign(sf.tabulateSize(npts,1), -1.);
+    sf.tabulate(npts, pts.data(), 1, out.data());
+    for (int p = 0; p < npts; ++p)
+      for (int i = 0; i < nf; ++i)
+        for (int c = 0; c < dim; ++c)
+          EXPECT_NEAR(sf.grad(&pts[p*dim], i, c), out[(p*nf + i)*dim + c], ALE_TOL) << types[t] << " " << dim << " " << deg;
+
+    out.assign(sf.tabulateSize(npts,2), -1.);
+    sf.tabulate(npts, pts.data(), 2, out.data());
+    for (int p = 0; p < npts; ++p)
+      for (int i = 0; i < nf; ++i)
+        for (int c = 0; c < dim; ++c)
+          for (int d = 0; d < dim; ++d)
+            EXPECT_NEAR(sf.hessian(&pts[p*dim], i, c, d), out[((p*nf + i)*dim + c)*dim + d], ALE_TOL) << types[t] << " " << dim << " " << deg;
+  }
+}
+
+
+TEST(ShapeFunctionTests, TabulationCache)
+{
+  ShapeFunction sf, sf2;
+  Quadrature Q(TRIANGLE, 4), Q2(TRIANGLE, 4), Q3(TRIANGLE, 2);
+
+  sf.setType("Lagrange+Bubble", /*dim*/2, /*degree*/2);
+  sf2 = sf;
+
+  int const n0 = TabulationCache::size();
+  ReferenceTabulation const& tab = TabulationCache::get(sf, Q);
+  ASSERT_EQ(n0+1, TabulationCache::size());
+
+  // same key, same object
+  EXPECT_EQ(&tab, &TabulationCache::get(sf2, Q2));
+  EXPECT_EQ(n0+1, TabulationCache::size());
+  EXPECT_NE(&tab, &TabulationCache::get(sf, Q3));
+  EXPECT_EQ(n0+2, TabulationCache::size());
+
+  ASSERT_EQ(Q.numPoints(), tab.numPoints());
+  ASSERT_EQ(sf.numDofs(), tab.numFunctions());
+  ASSERT_EQ(2, tab.dim());
+
+  EXPECT_EQ(0u, (uintptr_t)tab.values()   % ALELIB_TABULATION_ALIGN);
+  EXPECT_EQ(0u, (uintptr_t)tab.grads()    % ALELIB_TABULATION_ALIGN);
+  EXPECT_EQ(0u, (uintptr_t)tab.hessians() % ALELIB_TABULATION_ALIGN);
+
+  for (int qp = 0; qp < Q.numPoints(); ++qp)
+    for (int i = 0; i < sf.numDofs(); ++i)
+    {
+      EXPECT_NEAR(sf.value(Q.point(qp), i), tab.value(qp, i), ALE_TOL);
+      for (int c = 0; c < 2; ++c)
+      {
+        EXPECT_NEAR(sf.grad(Q.point(qp), i, c), tab.grad(qp, i, c), ALE_TOL);
+        for (int d = 0; d < 2; ++d)
+          EXPECT_NEAR(sf.hessian(Q.point(qp), i, c, d), tab.hessian(qp, i, c, d), ALE_TOL);
+      }
+    }
+}
+
+
+TEST(ShapeFunctionTests, SharedImpls)
+{
+  ShapeFunction sf, sf2, sf3;
+
+  sf.setType("Lagrange + Bubble", 3, 2);
+  int const n0 = ShapeFunction::numSharedImpls();
+
+  // same type, up to white spaces: same implementation
+  sf2.setType("Lagrange+Bubble", 3, 2);
+  EXPECT_EQ(n0, ShapeFunction::numSharedImpls());
+  EXPECT_EQ(sf.name(), sf2.name());
+
+  // copies share it too
+  sf3 = sf;
+  ShapeFunction sf4(sf3);
+  EXPECT_EQ(sf.name(), sf3.name());
+  EXPECT_EQ(sf.name(), sf4.name());
+  EXPECT_EQ(n0, ShapeFunction::numSharedImpls());
+
+  sf2.setType("Lagrange+Bubble", 3, 7); // not used anywhere else
+  EXPECT_EQ(n0+1, ShapeFunction::numSharedImpls());
+  EXPECT_NE(sf.numDofs(), sf2.numDofs());
+  EXPECT_EQ(sf.numDofs(), sf4.numDofs());
+
+  // an invalid type leaves the object as it was
+  EXPECT_THROW(sf2.setType("Lagrange+Foo", 3, 7), std::invalid_argument);
+  EXPECT_EQ(n0+1, ShapeFunction::numSharedImpls());
+  EXPECT_STREQ("Lagrange,3,7+Bubble,3", sf2.name());
+}
+
+
+// the specialized low-order kernels must agree with the generic implementation
+// (benchmark/benchmarks.cpp times both)
+TEST(ShapeFunctionTests, LagrangeFixedKernels)
+{
+  std::vector<double> pts;
+  std::vector<Real> a, b;
+  ShapeFunction fixed, generic;
+
+  for (int dim = 1; dim <= 3; ++dim)
+  for (int deg = 1; deg <= 3; ++deg)
+  {
+    fixed.setType("Lagrange", dim, deg);
+    generic.setType("Lagrange,generic", dim, deg);
+    ASSERT_EQ(generic.numDofs(), fixed.numDofs());
+    ASSERT_STREQ(generic.name(), fixed.name());
+
+    switch (dim)
+    {
+      case 1: genLineParametricPts(5, pts); break;
+      case 2: genTriParametricPts(5, pts); break;
+      case 3: genTetParametricPts(5, pts); break;
+    }
+    int const npts = pts.size()/dim;
+
+    for (int order = 0; order <= 2; ++order)
+    {
+      a.resize(fixed.tabulateSize(npts, order));
+      b.resize(a.size());
+      fixed.tabulate(npts, pts.data(), order, a.data());
+      generic.tabulate(npts, pts.data(), order, b.data());
+      for (int k = 0; k < (int)a.size(); ++k)
+        ASSERT_NEAR(b[k], a[k], ALE_TOL) << "dim " << dim << " degree " << deg << " order " << order;
+    }
+
+    for (int p = 0; p < npts; ++p)
+      for (int i = 0; i < fixed.numDofs(); ++i)
+      {
+        ASSERT_NEAR(generic.value(&pts[p*dim], i), fixed.value(&pts[p*dim], i), ALE_TOL);
+        for (int c = 0; c < dim; ++c)
+        {
+          ASSERT_NEAR(generic.grad(&pts[p*dim], i, c), fixed.grad(&pts[p*dim], i, c), ALE_TOL);
+          for (int d = 0; d < dim; ++d)
+            ASSERT_NEAR(generic.hessian(&pts[p*dim], i, c, d), fixed.hessian(&pts[p*dim], i, c, d), ALE_TOL);
+        }
+      }
+  }
+}
+
+
+TEST(ShapeFunctionTests, LagrangeHcube)
+{
+  std::vector<double> pts;
+  std::vector<Real> coefs, vals, grads, tab;
+  ShapeFunction sf;
+  Quadrature Q1;
+  // Shape function placeholder
+  Tr1::function<Real (Real const*)> Func;
+
+  for (int dim = 2; dim <= 3; ++dim)
+  for (int deg = 1; deg <= 4; ++deg)
+  {
+    sf.setType("Lagrange_hcube", dim, deg);
+    if (dim == 2) genQuadParametricPts(deg, pts);
+    else          genHexParametricPts(deg, pts);
+    int const nf = sf.numDofs();
+    ASSERT_EQ(nf*dim, (int)pts.size());
+    ASSERT_EQ(nf, (dim==2 ? 4 : 8)*sf.numDofsPerVertex() + (dim==2 ? 4*sf.numDofsInFacet()
+                    : 12*sf.numDofsInRidge() + 6*sf.numDofsInFacet()) + sf.numDofsInCell());
+
+    // delta property and gradients
+    for (int p = 0; p < nf; ++p)
+      for (int i = 0; i < nf; ++i)
+      {
+        ASSERT_NEAR(i==p ? 1. : 0., sf.value(&pts[p*dim], i), ALE_TOL);
+        Func = Tr1::bind(Tr1::mem_fn(&ShapeFunction::value), sf, _1, i);
+        for (int c = 0; c < dim; ++c)
+          ASSERT_NEAR(diff_( Func, &pts[p*dim], c, dim ), sf.grad(&pts[p*dim], i, c), 1e-8);
+      }
+
+    // sum factorization against the plain sum over all functions
+    Q1.setType(EDGE, deg+1);
+    int const nq = Q1.numPoints();
+    std::vector<Real> pts1d(nq);
+    for (int q = 0; q < nq; ++q)
+      pts1d[q] = Q1.point(q)[0];
+    int nqd = 1;
+    for (int c = 0; c < dim; ++c)
+      nqd *= nq;
+
+    coefs.resize(nf);
+    for (int i = 0; i < nf; ++i)
+      coefs[i] = std::cos(1.+i);
+    vals.resize(nqd);
+    grads.resize(nqd*dim);
+    sf.interpolateTensor(nq, pts1d.data(), coefs.data(), vals.data(), grads.data());
+
+    Quadrature Q(dim==2 ? QUADRANGLE : HEXAHEDRON, deg+1);
+    ASSERT_EQ(nqd, Q.numPoints());
+    for (int q = 0; q < nqd; ++q)
+    {
+      Real u = 0, du[3] = {0,0,0};
+      for (int i = 0; i < nf; ++i)
+      {
+        u += coefs[i]*sf.value(Q.point(q), i);
+        for (int c = 0; c < dim; ++c)
+          du[c] += coefs[i]*sf.grad(Q.point(q), i, c);
+      }
+      ASSERT_NEAR(u, vals[q], ALE_TOL);
+      for (int c = 0; c < dim; ++c)
+        ASSERT_NEAR(du[c], grads[q*dim + c], ALE_TOL);
+    }
+
+    // partition of unity
+    pts.resize(nqd*dim);
+    for (int q = 0; q < nqd; ++q)
+      std::copy(Q.point(q), Q.point(q)+dim, &pts[q*dim]);
+    tab.resize(sf.tabulateSize(nqd, 0));
+    sf.tabulate(nqd, pts.data(), 0, tab.data());
+    Real integ = 0;
+    for (int q = 0; q < Q.numPoints(); ++q)
+      for (int i = 0; i < nf; ++i)
+        integ += tab[q*nf + i]*Q.weight(q);
+    ASSERT_NEAR(dim==2 ? 4. : 8., integ, 1e-13);
+  }
+}
+
+
+// every SIMD level available must agree with the scalar evaluation (benchmark/benchmarks.cpp times them)
+TEST(ShapeFunctionTests, TabulateSoA)
+{
+  char const* types[] = {"Lagrange", "Lagrange,generic", "Bubble", "Lagrange+Bubble"};
+  int const npts = 37; // not a multiple of the vector width
+  std::vector<Real> xyz_v(3*npts), out;
+  Real const* xyz[3] = {&xyz_v[0], &xyz_v[npts], &xyz_v[2*npts]};
+  ShapeFunction sf;
+
+  for (int p = 0; p < npts; ++p) // inside the simplex
+  {
+    xyz_v[p]          = 0.3*(1. + std::sin(3.*p));
+    xyz_v[npts + p]   = 0.2*(1. + std::cos(5.*p));
+    xyz_v[2*npts + p] = 0.1*(1. + std::sin(7.*p+1.));
+  }
+
+  for (int lvl = SIMD_SCALAR; lvl <= (int)simd::detectLevel(); ++lvl)
+  {
+    simd::forceLevel(lvl);
+    for (int dim = 1; dim <= 3; ++dim)
+    for (int t = 0; t < 4; ++t)
+    for (int deg = (t==2 ? 1 : 0); deg <= (t==2 ? 1 : 5); ++deg)
+    {
+      sf.setType(types[t], dim, deg);
+      int const nf = sf.numDofs();
+      out.assign(nf*npts, -1.);
+      sf.tabulateSoA(npts, xyz, out.data());
+      for (int p = 0; p < npts; ++p)
+      {
+        Real const x[3] = {xyz[0][p], xyz[1][p], xyz[2][p]};
+        for (int i = 0; i < nf; ++i)
+          ASSERT_NEAR(sf.value(x, i), out[i*npts + p], ALE_TOL) << types[t] << " dim " << dim << " degree " << deg << " level " << lvl;
+      }
+    }
+  }
+
+  simd::forceLevel(-1);
+}
+
+
+TEST(ShapeFunctionTests, Bernstein)
+{
+  ShapeFunction sf;
+  Quadrature Q;
+  std::vector<Real> pts, tab, grads, coefs, M, K;
+  Tr1::function<Real (Real const*)> Func;
+  ECellType const cells[] = {EDGE, TRIANGLE, TETRAHEDRON};
+  Real const vols[] = {2., 1./2., 1./6.};
+  // gradients of the barycentric coordinates of the reference simplices
+  Real const gradL[3][12] = { {-0.5, 0.5},
+                              {-1,-1,  1,0,  0,1},
+                              {-1,-1,-1,  1,0,0,  0,1,0,  0,0,1} };
+
+  for (int dim = 1; dim <= 3; ++dim)
+  for (int deg = 0; deg <= 4; ++deg)
+  {
+    sf.setType("Bernstein", dim, deg);
+    SfSimplexBernstein B(dim, deg, false);
+    int const nf = B.numDofs();
+    ASSERT_EQ(nf, sf.numDofs());
+
+    Q.setType(cells[dim-1], std::max(2*deg, 1)); // exact for the mass matrix
+    int const nq = Q.numPoints();
+    pts.resize(nq*dim);
+    for (int q = 0; q < nq; ++q)
+      std::copy(Q.point(q), Q.point(q)+dim, &pts[q*dim]);
+
+    tab.resize(sf.tabulateSize(nq, 0));
+    grads.resize(sf.tabulateSize(nq, 1));
+    sf.tabulate(nq, pts.data(), 0, tab.data());
+    sf.tabulate(nq, pts.data(), 1, grads.data());
+
+    coefs.resize(nf);
+    for (int i = 0; i < nf; ++i)
+      coefs[i] = std::cos(1.+i);
+
+    for (int q = 0; q < nq; ++q)
+    {
+      // partition of unity and de Casteljau
+      Real sum = 0, u = 0;
+      for (int i = 0; i < nf; ++i)
+      {
+        sum += tab[q*nf + i];
+        u   += coefs[i]*tab[q*nf + i];
+      }
+      ASSERT_NEAR(1., sum, ALE_TOL);
+      ASSERT_NEAR(u, B.deCasteljau(&pts[q*dim], coefs.data()), ALE_TOL);
+
+      // derivatives
+      for (int i = 0; i < nf; ++i)
+        for (int c = 0; c < dim; ++c)
+        {
+          Func = Tr1::bind(Tr1::mem_fn(&ShapeFunction::value), sf, _1, i);
+          ASSERT_NEAR(diff_( Func, &pts[q*dim], c, dim ), grads[(q*nf + i)*dim + c], 1e-7);
+          Func = Tr1::bind(Tr1::mem_fn(&ShapeFunction::grad), sf, _1, i, c);
+          for (int d = 0; d < dim; ++d)
+            ASSERT_NEAR(diff_( Func, &pts[q*dim], d, dim ), sf.hessian(&pts[q*dim], i, c, d), 1e-6);
+        }
+    }
+
+    // closed-form mass and stiffness matrices against quadrature
+    M.resize(nf*nf);
+    K.resize(nf*nf);
+    B.massMatrix(vols[dim-1], M.data());
+    B.stiffnessMatrix(vols[dim-1], gradL[dim-1], dim, K.data());
+    for (int i = 0; i < nf; ++i)
+      for (int j = 0; j < nf; ++j)
+      {
+        Real m = 0, k = 0;
+        for (int q = 0; q < nq; ++q)
+        {
+          m += tab[q*nf + i]*tab[q*nf + j]*Q.weight(q);
+          for (int c = 0; c < dim; ++c)
+            k += grads[(q*nf + i)*dim + c]*grads[(q*nf + j)*dim + c]*Q.weight(q);
+        }
+        ASSERT_NEAR(m, M[i*nf + j], ALE_TOL) << "dim " << dim << " degree " << deg;
+        ASSERT_NEAR(k, K[i*nf + j], ALE_TOL) << "dim " << dim << " degree " << deg;
+      }
+
+    // sum-factorized moments against the plain sum over the same collapsed rule
+    std::vector<Quadrature::Vec3> cpts;
+    std::vector<Real> cwts, fv, mu(nf), mu1(nf);
+    int const order = 2*deg + 3;
+    if (dim == 1)
+      Quadrature::igetQuadrPtsHypercube(order, 1, cpts, cwts);
+    else
+      Quadrature::igetQuadrPtsCollapsed(order, dim, cpts, cwts);
+    Real wsum = 0;
+    for (int p = 0; p < (int)cpts.size(); ++p)
+    {
+      fv.push_back(std::exp(cpts[p][0] - cpts[p][1]*cpts[p][2]));
+      wsum += cwts[p];
+    }
+    B.moments(vols[dim-1], order, fv.data(), mu.data());
+    for (int i = 0; i < nf; ++i)
+    {
+      Real m = 0;
+      for (int p = 0; p < (int)cpts.size(); ++p)
+        m += cwts[p]/wsum*vols[dim-1]*fv[p]*sf.value(cpts[p], i);
+      ASSERT_NEAR(m, mu[i], ALE_TOL) << "dim " << dim << " degree " << deg;
+    }
+
+    // int_T B_i = |T|/numDofs()
+    std::fill(fv.begin(), fv.end(), 1.);
+    B.moments(vols[dim-1], order, fv.data(), mu1.data());
+    for (int i = 0; i < nf; ++i)
+      ASSERT_NEAR(vols[dim-1]/nf, mu1[i], ALE_TOL);
+  }
+}
+
+
 //
 //
 // Testing the quadrature points
@@ -846,5 +1242,724 @@ TEST_F(ShapeTet1Tests, LagrangeIntegration)
 }
 
 
+TEST(QuadratureTests, GaussRules1d)
+{
+  std::vector<Real> x, w;
+
+  // against the values that used to be tabulated
+  Quadrature::gaussRule1d(3, x, w);
+  EXPECT_NEAR(-7.745966692414834e-1, x[0], 1e-15);
+  EXPECT_NEAR( 8.888888888888889e-1, w[1], 1e-15);
+  Quadrature::gaussRule1d(4, x, w, GAUSS_LOBATTO);
+  EXPECT_NEAR(-1., x[0], 0);
+  EXPECT_NEAR(-1./std::sqrt(5.), x[1], 1e-15);
+  EXPECT_NEAR(5./6., w[2], 1e-15);
+
+  // monomials up to the exactness degree
+  for (int rule = GAUSS_LEGENDRE; rule <= GAUSS_LOBATTO; ++rule)
+    for (int n = (rule == GAUSS_LOBATTO ? 2 : 1); n <= 40; ++n)
+    {
+      Quadrature::gaussRule1d(n, x, w, EQuadrRule(rule));
+      ASSERT_EQ(n, (int)x.size());
+      int const exact = rule == GAUSS_LOBATTO ? 2*n-3 : 2*n-1;
+      for (int k = 0; k <= exact; ++k)
+      {
+        Real integ = 0;
+        for (int q = 0; q < n; ++q)
+          integ += w[q]*std::pow(x[q], k);
+        ASSERT_NEAR(k%2 ? 0. : 2./(k+1), integ, 1e-14) << "rule " << rule << " n " << n << " k " << k;
+      }
+    }
+
+  // high degree tensor rules
+  Quadrature Q;
+  for (int rule = GAUSS_LEGENDRE; rule <= GAUSS_LOBATTO; ++rule)
+    for (int deg = 10; deg <= 30; deg += 5)
+    {
+      Q.setType(HEXAHEDRON, deg, EQuadrRule(rule));
+      Real integ = 0;
+      int const a = deg/2 - (deg/2)%2, b = deg - a - (deg-a)%2; // even powers, a + b <= deg
+      for (int q = 0; q < Q.numPoints(); ++q)
+        integ += Q.weight(q)*std::pow(Q.point(q)[0], a)*std::pow(Q.point(q)[2], b);
+      ASSERT_NEAR(2.*2./(a+1)*2./(b+1), integ, 1e-13) << "rule " << rule << " degree " << deg;
+    }
+}
+
+
+// int_T x^i y^j z^k = i! j! k! / (i+j+k+dim)!, over all monomials up to `deg`
+static void checkSimplexMonomials(int dim, int deg, std::vector<Quadrature::Vec3> const& pts, std::vector<Real> const& wts, Real measure)
+{
+  Real fact[64];
+  fact[0] = 1;
+  for (int k = 1; k < 64; ++k)
+    fact[k] = k*fact[k-1];
+
+  for (int i = 0; i <= deg; ++i)
+    for (int j = 0; i+j <= deg; ++j)
+      for (int k = 0; i+j+k <= deg && (dim==3 || k==0); ++k)
+      {
+        Real integ = 0;
+        for (int q = 0; q < (int)pts.size(); ++q)
+        {
+          Real const* x = pts[q];
+          ASSERT_TRUE(x[0] >= 0 && x[1] >= 0 && x[0]+x[1]+(dim==3 ? x[2] : 0.) <= 1);
+          ASSERT_GT(wts[q], 0.);
+          integ += wts[q]*measure*std::pow(x[0], i)*std::pow(x[1], j)*(dim==3 ? std::pow(x[2], k) : 1.);
+        }
+        ASSERT_NEAR(fact[i]*fact[j]*fact[k]/fact[i+j+k+dim], integ, 1e-15) << "dim " << dim << " degree " << deg
+                                                                           << " monomial " << i << " " << j << " " << k;
+      }
+}
+
+TEST(QuadratureTests, CollapsedSimplexRules)
+{
+  std::vector<Quadrature::Vec3> pts;
+  std::vector<Real> wts;
+
+  for (int dim = 2; dim <= 3; ++dim)
+    for (int deg = 0; deg <= 20; ++deg)
+    {
+      Quadrature::igetQuadrPtsCollapsed(deg, dim, pts, wts);
+      ASSERT_EQ(dim==2 ? (deg/2+1)*(deg/2+1) : (deg/2+1)*(deg/2+1)*(deg/2+1), (int)pts.size());
+      checkSimplexMonomials(dim, deg, pts, wts, dim==2 ? 1./2. : 1./6.);
+    }
+}
+
+// every rule handed out by Quadrature for simplices, never bigger than the tables used before the
+// symmetric library (benchmark/benchmarks.cpp prints the points saved)
+TEST(QuadratureTests, SymmetricSimplexRules)
+{
+  Quadrature Q;
+  std::vector<Quadrature::Vec3> pts, col_pts;
+  std::vector<Real> wts, col_wts;
+  int const old_tri[] = {1, 1, 3, 6, 7, 7, 12, 15, 16, 19, 25};
+  int const old_tet[] = {1, 1, 4, 8, 14, 14, 24, 36, 46};
+
+  for (int dim = 2; dim <= 3; ++dim)
+  {
+    for (int deg = 0; deg <= 20; ++deg)
+    {
+      Q.setType(dim==2 ? TRIANGLE : TETRAHEDRON, deg);
+      int const np = Q.numPoints();
+      pts.resize(np);
+      wts.resize(np);
+      for (int q = 0; q < np; ++q)
+      {
+        std::copy(Q.point(q), Q.point(q)+3, &pts[q][0]);
+        wts[q] = Q.weight(q);
+      }
+      checkSimplexMonomials(dim, deg, pts, wts, 1.);
+
+      Quadrature::igetQuadrPtsCollapsed(deg, dim, col_pts, col_wts);
+      int const old = dim==2 ? (deg <= 10 ? old_tri[deg] : (int)col_pts.size())
+                             : (deg <=  8 ? old_tet[deg] : (int)col_pts.size());
+      EXPECT_LE(np, old);
+    }
+  }
+}
+
+
+// divergence theorem with g = m e_c, m = (1 + x + 2y + 3z)^deg, checks points, weights and normals of every orientation
+TEST(QuadratureTests, FacetQuadratureReference)
+{
+  ECellType const cts[] = {EDGE, TRIANGLE, QUADRANGLE, TETRAHEDRON, HEXAHEDRON};
+  Quadrature Q;
+
+  for (int t = 0; t < 5; ++t)
+    for (int deg = 1; deg <= 6; ++deg)
+    {
+      FacetQuadrature const& FQ = FacetQuadrature::get(cts[t], deg);
+      EXPECT_EQ(&FQ, &FacetQuadrature::get(cts[t], deg));
+      int const dim = FQ.dim();
+      Q.setType(cts[t], deg);
+
+      for (int c = 0; c < dim; ++c)
+      {
+        Real const a = c + 1;
+        Real vol_integ = 0;
+        for (int q = 0; q < Q.numPoints(); ++q)
+        {
+          Real s = 1;
+          for (int k = 0; k < dim; ++k)
+            s += (k+1)*Q.point(q)[k];
+          vol_integ += Q.weight(q)*deg*a*std::pow(s, deg-1);
+        }
+
+        for (int o = 0; o < FQ.numOrientations(); ++o)
+        {
+          Real surf_integ = 0;
+          for (int f = 0; f < FQ.numFacets(); ++f)
+          {
+            Real const* n = FQ.normal(f);
+            Real len = 0, wsum = 0;
+            for (int k = 0; k < dim; ++k)
+              len += n[k]*n[k];
+            ASSERT_NEAR(1., len, ALE_TOL);
+
+            for (int q = 0; q < FQ.numPoints(); ++q)
+            {
+              Real const* x = FQ.point(f, o, q);
+              ASSERT_EQ(x, FQ.points(f, o) + q*dim);
+              Real s = 1;
+              for (int k = 0; k < dim; ++k)
+                s += (k+1)*x[k];
+              surf_integ += FQ.weight(f, q)*std::pow(s, deg)*n[c];
+              wsum += FQ.weight(f, q);
+            }
+            ASSERT_NEAR(FQ.measure(f), wsum, ALE_TOL);
+          }
+          EXPECT_NEAR(vol_integ, surf_integ, 1e-9*std::max(1., std::fabs(vol_integ)))
+            << "cell " << cts[t] << " degree " << deg << " component " << c << " orientation " << o;
+        }
+      }
+    }
+}
+
+// the points of a facet seen from both of its cells must be the same physical points
+template<class MeshT>
+void checkFacetQuadratureMatch(const char* mesh_in, ECellType ct, const char* sf_name)
+{
+  typedef typename MeshT::CellH CellH;
+
+  MeshT m;
+  MeshIoMsh<MeshT> io;
+  io.readFile(mesh_in, &m);
+
+  FacetQuadrature const& FQ = FacetQuadrature::get(ct, 4);
+  int const dim = FQ.dim();
+  int const sd  = m.spaceDim();
+  ShapeFunction phi;
+  phi.setType(sf_name, dim, 1);
+  int const nv = phi.numDofs();
+
+  Real xc[8*3], xa[8*3];
+  int n_interior = 0;
+  for (CellH c = m.cellBegin(), c_end = m.cellEnd(); c != c_end; ++c)
+  {
+    c.verticesCoord(&m, xc);
+    for (int s = 0; s < FQ.numFacets(); ++s)
+    {
+      int adj_side, anchor;
+      CellH adj = c.adjCellSideAndAnchor(&m, s, &adj_side, &anchor);
+      if (adj.isNull())
+        continue;
+      ++n_interior;
+      adj.verticesCoord(&m, xa);
+      int const o = FacetQuadrature::orientationFromAnchor(anchor);
+      for (int q = 0; q < FQ.numPoints(); ++q)
+        for (int k = 0; k < sd; ++k)
+        {
+          Real X = 0, Y = 0;
+          for (int v = 0; v < nv; ++v)
+          {
+            X += phi.value(FQ.point(s, 0, q), v)*xc[v*sd + k];
+            Y += phi.value(FQ.point(adj_side, o, q), v)*xa[v*sd + k];
+          }
+          ASSERT_NEAR(X, Y, ALE_TOL) << mesh_in << ": side " << s << " anchor " << anchor << " point " << q;
+        }
+    }
+  }
+  EXPECT_GT(n_interior, 0);
+}
+
+TEST(QuadratureTests, FacetQuadratureOrientations)
+{
+  checkFacetQuadratureMatch<MeshTri>("meshes/simple_tri0.msh",  TRIANGLE,    "Lagrange");
+  checkFacetQuadratureMatch<MeshQua>("meshes/simple_quad0.msh", QUADRANGLE,  "Lagrange_hcube");
+  checkFacetQuadratureMatch<MeshTet>("meshes/simple_tet0.msh",  TETRAHEDRON, "Lagrange");
+  checkFacetQuadratureMatch<MeshHex>("meshes/simple_hex0.msh",  HEXAHEDRON,  "Lagrange_hcube");
+}
+
+
+TEST(QuadratureTests, PointsSoA)
+{
+  ECellType const cts[] = {POINT, EDGE, TRIANGLE, QUADRANGLE, TETRAHEDRON, HEXAHEDRON};
+  int const dims[] = {0, 1, 2, 2, 3, 3};
+  int const width = ALELIB_QUADRATURE_ALIGN/sizeof(Real);
+  ShapeFunction sf;
+  std::vector<Real> out, ref;
+
+  for (int t = 0; t < 6; ++t)
+    for (int deg = 0; deg <= 9; ++deg)
+    {
+      Quadrature Q(cts[t], deg);
+      Quadrature const C(Q); // the copy has its own aligned arrays
+      Quadrature A;
+      A = C;
+      Quadrature const* qs[] = {&Q, &C, &A};
+      for (int k = 0; k < 3; ++k)
+      {
+        Quadrature const& q = *qs[k];
+        int const np = q.numPoints(), npad = q.numPointsPadded();
+        ASSERT_EQ(0, npad % width);
+        ASSERT_TRUE(npad >= np && npad < np + width);
+        for (int c = 0; c < 4; ++c)
+        {
+          Real const* a = c < 3 ? q.pointsSoA(c) : q.weightsSoA();
+          ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(a) % ALELIB_QUADRATURE_ALIGN);
+          if (c < 3)
+          {
+            ASSERT_EQ(a, q.pointsSoA()[c]);
+          }
+          for (int qp = 0; qp < npad; ++qp)
+          {
+            int const p = qp < np ? qp : 0;
+            Real const expected = c == 3 ? (qp < np ? q.weight(qp) : 0.) : (c < dims[t] ? q.point(p)[c] : 0.);
+            ASSERT_EQ(expected, a[qp]) << "cell " << cts[t] << " degree " << deg << " component " << c;
+          }
+        }
+      }
+
+      // the padded points can be tabulated directly
+      if (dims[t] == 0 || cts[t] == QUADRANGLE || cts[t] == HEXAHEDRON)
+        continue;
+      sf.setType("Lagrange", dims[t], 2);
+      int const nf = sf.numDofs(), npad = C.numPointsPadded();
+      out.resize(nf*npad);
+      sf.tabulateSoA(npad, C.pointsSoA(), out.data());
+      for (int qp = 0; qp < C.numPoints(); ++qp)
+        for (int i = 0; i < nf; ++i)
+          ASSERT_NEAR(sf.value(C.point(qp), i), out[i*npad + qp], ALE_TOL);
+    }
+}
+
+
+namespace
+{
+  // vertices of a deformed reference simplex in R^sdim: x_v = A*xi_v + b with a well-conditioned A
+  void deformedSimplex(int dim, int sdim, int seed, std::vector<Real>& X)
+  {
+    X.assign((dim+1)*sdim, 0.);
+    for (int v = 0; v <= dim; ++v)
+      for (int i = 0; i < sdim; ++i)
+      {
+        Real xi = 0;
+        for (int j = 0; j < dim; ++j)
+        {
+          Real const ref = dim == 1 ? (v == 0 ? -1. : 1.) : (v == j+1 ? 1. : 0.);
+          xi += ((i == j ? 1.5 : 0.) + 0.3*std::sin(seed + 3.*i + 7.*j))*ref;
+        }
+        X[v*sdim + i] = xi + 0.2*std::cos(seed + i);
+      }
+  }
+
+  Real det3(Real const* a, Real const* b, Real const* c)
+  { return a[0]*(b[1]*c[2] - b[2]*c[1]) - a[1]*(b[0]*c[2] - b[2]*c[0]) + a[2]*(b[0]*c[1] - b[1]*c[0]); }
+
+  void checkInverse(CellGeometry const& G, int cell)
+  {
+    for (int qp = 0; qp < G.numPointsPadded(); ++qp)
+      for (int j = 0; j < G.dim(); ++j)
+        for (int l = 0; l < G.dim(); ++l)
+        {
+          Real s = 0;
+          for (int i = 0; i < G.spaceDim(); ++i)
+            s += G.invJacobian(cell, j, i)[qp]*G.jacobian(cell, i, l)[qp];
+          ASSERT_NEAR(j == l ? 1. : 0., s, 1e-12);
+        }
+  }
+}
+
+TEST(GeometryTests, AffineSimplices)
+{
+  ECellType const cts[] = {EDGE, TRIANGLE, TETRAHEDRON};
+  std::vector<Real> X, nodes;
+
+  for (int dim = 1; dim <= 3; ++dim)
+    for (int sdim = dim; sdim <= 3; ++sdim)
+    {
+      CellGeometry G(cts[dim-1], sdim);
+      G.setPoints(Quadrature(cts[dim-1], 3));
+      int const nv = dim + 1;
+      nodes.clear();
+      for (int cell = 0; cell < 3; ++cell)
+      {
+        deformedSimplex(dim, sdim, cell, X);
+        nodes.insert(nodes.end(), X.begin(), X.end());
+      }
+      G.compute(3, &nodes[0]);
+      ASSERT_EQ(3, G.numCells());
+
+      for (int cell = 0; cell < 3; ++cell)
+      {
+        Real const* x = &nodes[cell*nv*sdim];
+        EXPECT_TRUE(G.isAffine(cell));
+
+        // J columns are the edges from the vertex 0
+        Real E[3][3];
+        for (int j = 0; j < dim; ++j)
+          for (int i = 0; i < sdim; ++i)
+          {
+            E[j][i] = (x[(j+1)*sdim + i] - x[i])/(dim == 1 ? 2. : 1.);
+            for (int qp = 0; qp < G.numPointsPadded(); ++qp)
+              ASSERT_NEAR(E[j][i], G.jacobian(cell, i, j)[qp], ALE_TOL);
+          }
+        checkInverse(G, cell);
+
+        // mapped points and measure
+        Quadrature const Q(cts[dim-1], 3);
+        Real meas = 0;
+        for (int qp = 0; qp < G.numPointsPadded(); ++qp)
+        {
+          meas += G.JxW(cell)[qp];
+          Real const* xi = Q.point(qp < Q.numPoints() ? qp : 0);
+          for (int i = 0; i < sdim; ++i)
+          {
+            Real y = dim == 1 ? (x[i] + x[sdim + i])/2. : x[i];
+            for (int j = 0; j < dim; ++j)
+              y += E[j][i]*xi[j];
+            ASSERT_NEAR(y, G.points(cell, i)[qp], ALE_TOL);
+          }
+        }
+        Real exact;
+        if (dim == 1)
+        {
+          exact = 0;
+          for (int i = 0; i < sdim; ++i)
+            exact += 4*E[0][i]*E[0][i];
+          exact = std::sqrt(exact);
+        }
+        else if (dim == 2)
+        {
+          Real const a[3] = {E[0][0], E[0][1], sdim == 3 ? E[0][2] : 0.};
+          Real const b[3] = {E[1][0], E[1][1], sdim == 3 ? E[1][2] : 0.};
+          Real const c[3] = {a[1]*b[2] - a[2]*b[1], a[2]*b[0] - a[0]*b[2], a[0]*b[1] - a[1]*b[0]};
+          exact = std::sqrt(c[0]*c[0] + c[1]*c[1] + c[2]*c[2])/2.;
+        }
+        else
+          exact = std::fabs(det3(E[0], E[1], E[2]))/6.;
+        EXPECT_NEAR(exact, meas, 1e-12) << "dim " << dim << " sdim " << sdim;
+      }
+    }
+}
+
+TEST(GeometryTests, Hypercubes)
+{
+  // trapezoid and parallelogram; frustum of a square pyramid and parallelepiped
+  Real const quads[2][4*2] = {{0,0, 2,0, 1.5,1, 0.5,1}, {0,0, 2,0, 3,1, 1,1}};
+  Real const quad_area[2] = {1.5, 2.};
+  Real hexs[2][8*3] = {{-1,-1,0, 1,-1,0, 1,1,0, -1,1,0, -.5,-.5,1, .5,-.5,1, .5,.5,1, -.5,.5,1}};
+  Real const a[3] = {1, 0.2, 0}, b[3] = {0.1, 2, 0.3}, c[3] = {0.2, 0.1, 1.5};
+  for (int v = 0; v < 8; ++v)
+    for (int i = 0; i < 3; ++i)
+    {
+      Real const sx = (v == 1 || v == 2 || v == 5 || v == 6), sy = (v == 2 || v == 3 || v == 6 || v == 7), sz = v >= 4;
+      hexs[1][v*3 + i] = sx*a[i] + sy*b[i] + sz*c[i];
+    }
+  Real const hex_vol[2] = {7./3., std::fabs(det3(a, b, c))};
+
+  for (int dim = 2; dim <= 3; ++dim)
+  {
+    ECellType const ct = dim == 2 ? QUADRANGLE : HEXAHEDRON;
+    CellGeometry G(ct, dim);
+    G.setPoints(Quadrature(ct, 5));
+    G.compute(2, dim == 2 ? &quads[0][0] : &hexs[0][0]);
+    for (int cell = 0; cell < 2; ++cell)
+    {
+      EXPECT_EQ(cell == 1, G.isAffine(cell));
+      checkInverse(G, cell);
+      Real meas = 0;
+      for (int qp = 0; qp < G.numPointsPadded(); ++qp)
+        meas += G.JxW(cell)[qp];
+      EXPECT_NEAR(dim == 2 ? quad_area[cell] : hex_vol[cell], meas, 1e-12);
+    }
+
+    // Jacobian of the non-affine cell against finite differences of the map
+    Real const h = 1e-6;
+    Real const xi[3] = {0.3, -0.4, 0.6};
+    std::vector<Real> pts;
+    for (int k = 0; k <= 2*dim; ++k)
+      for (int j = 0; j < dim; ++j)
+        pts.push_back(xi[j] + (k > 0 && (k-1)/2 == j ? ((k-1) % 2 ? -h : h) : 0.));
+    G.setPoints(2*dim + 1, &pts[0]);
+    G.compute(1, dim == 2 ? &quads[0][0] : &hexs[0][0]);
+    for (int i = 0; i < dim; ++i)
+      for (int j = 0; j < dim; ++j)
+        EXPECT_NEAR((G.points(0, i)[1 + 2*j] - G.points(0, i)[2 + 2*j])/(2*h), G.jacobian(0, i, j)[0], 1e-8);
+  }
+}
+
+TEST(GeometryTests, FacetNormals)
+{
+  std::vector<Real> X;
+  Real const frustum[8*3] = {-1,-1,0, 1,-1,0, 1,1,0, -1,1,0, -.5,-.5,1, .5,-.5,1, .5,.5,1, -.5,.5,1};
+  ECellType const cts[] = {TRIANGLE, TETRAHEDRON, HEXAHEDRON};
+
+  for (int t = 0; t < 3; ++t)
+  {
+    ECellType const ct = cts[t];
+    int const sdim = 3;
+    if (ct == HEXAHEDRON)
+      X.assign(frustum, frustum + 24);
+    else
+      deformedSimplex(ct == TRIANGLE ? 2 : 3, sdim, 5, X);
+    int const nv = X.size()/sdim;
+    Real centroid[3] = {0,0,0};
+    for (int v = 0; v < nv; ++v)
+      for (int i = 0; i < sdim; ++i)
+        centroid[i] += X[v*sdim + i]/nv;
+
+    CellGeometry G(ct, sdim);
+    FacetQuadrature const& FQ = FacetQuadrature::get(ct, 3);
+    Real closure[3] = {0,0,0}, perimeter = 0;
+    for (int f = 0; f < FQ.numFacets(); ++f)
+      for (int o = 0; o < FQ.numOrientations(); ++o)
+      {
+        G.setPoints(FQ, f, o);
+        G.compute(1, &X[0]);
+        for (int qp = 0; qp < G.numPoints(); ++qp)
+        {
+          Real len = 0, out = 0, w = G.JxW(0)[qp];
+          for (int i = 0; i < sdim; ++i)
+          {
+            Real const n = G.normals(0, i)[qp];
+            len += n*n;
+            out += n*(G.points(0, i)[qp] - centroid[i]);
+            closure[i] += o == 0 ? w*n : 0.;
+          }
+          ASSERT_NEAR(1., len, ALE_TOL);
+          ASSERT_GT(out, 0.);
+          if (o == 0)
+            perimeter += w;
+        }
+        for (int qp = G.numPoints(); qp < G.numPointsPadded(); ++qp)
+          ASSERT_EQ(0., G.JxW(0)[qp]);
+      }
+    for (int i = 0; i < sdim; ++i)
+      EXPECT_NEAR(0., closure[i], 1e-12) << "cell " << ct;
+
+    if (ct == TRIANGLE)
+    {
+      Real p = 0;
+      for (int k = 0; k < 3; ++k)
+      {
+        Real l = 0;
+        for (int i = 0; i < sdim; ++i)
+          l += std::pow(X[((k+1)%3)*sdim + i] - X[k*sdim + i], 2);
+        p += std::sqrt(l);
+      }
+      EXPECT_NEAR(p, perimeter, 1e-12);
+    }
+    if (ct == HEXAHEDRON) // 4 + 1 + 4 trapezoids of height sqrt(1.25) and bases 2 and 1
+    {
+      EXPECT_NEAR(5. + 4.*1.5*std::sqrt(1.25), perimeter, 1e-12);
+    }
+  }
+}
+
+TEST(GeometryTests, InverseMap)
+{
+  // a triangle in R^3 (affine), a trapezoid and a frustum (multilinear), and a P2 triangle with a curved edge
+  std::vector<Real> tri;
+  deformedSimplex(2, 3, 4, tri);
+  Real const trapezoid[4*2] = {0,0, 2,0, 1.5,1, 0.5,1};
+  Real const frustum[8*3] = {-1,-1,0, 1,-1,0, 1,1,0, -1,1,0, -.5,-.5,1, .5,-.5,1, .5,.5,1, -.5,.5,1};
+  Real const curved[6*2] = {0,0, 1,0, 0,1, 0.5,-0.1, 0.6,0.6, 0,0.5};
+
+  struct Case { ECellType ct; int sdim, degree; Real const* nodes; int naffine; };
+  Case const cases[4] = {{TRIANGLE, 3, 1, &tri[0], 1}, {QUADRANGLE, 2, 1, trapezoid, 0},
+                         {HEXAHEDRON, 3, 1, frustum, 0}, {TRIANGLE, 2, 2, curved, 0}};
+
+  for (int t = 0; t < 4; ++t)
+  {
+    Case const& c = cases[t];
+    CellGeometry G(c.ct, c.sdim, c.degree);
+    int const dim = G.dim();
+
+    // reference points inside and outside the cell; the map gives the physical ones
+    std::vector<Real> ref;
+    std::vector<char> expected;
+    for (int p = 0; p < 12; ++p)
+    {
+      bool const in = p % 3 != 2;
+      for (int j = 0; j < dim; ++j)
+      {
+        Real const r = 0.5 + 0.4*std::sin(3.*p + 5.*j);  // in (0.1, 0.9)
+        Real xi = c.ct == TRIANGLE ? r/dim : 2.*r - 1.;
+        if (!in && j == 0)
+          xi = c.ct == TRIANGLE ? -0.05 : 1.1;
+        ref.push_back(xi);
+      }
+      expected.push_back(in);
+    }
+    int const np = expected.size();
+    G.setPoints(np, &ref[0]);
+    G.compute(1, c.nodes, GEOM_POINTS);
+    EXPECT_EQ(c.naffine, (int)G.isAffine(0));
+
+    std::vector<Real> x(np*c.sdim), xi(np*dim);
+    std::vector<int>  cells(np, 0);
+    for (int p = 0; p < np; ++p)
+      for (int i = 0; i < c.sdim; ++i)
+        x[p*c.sdim + i] = G.points(0, i)[p];
+    std::vector<char> inside(np);
+    int const nin = G.inverseMap(np, c.nodes, &cells[0], &x[0], &xi[0], &inside[0]);
+
+    EXPECT_EQ(8, nin) << "case " << t;
+    for (int p = 0; p < np; ++p)
+    {
+      EXPECT_EQ(expected[p], inside[p]) << "case " << t << ", point " << p;
+      for (int j = 0; j < dim; ++j)
+        EXPECT_NEAR(ref[p*dim + j], xi[p*dim + j], 1e-10) << "case " << t << ", point " << p;
+    }
+  }
+
+  // cell centroids of a mesh
+  typedef MeshTri::CellH CellH;
+  MeshTri m;
+  MeshIoMsh<MeshTri> io;
+  io.readFile("meshes/simple_tri0.msh", &m);
+  std::vector<CellH> cells;
+  std::vector<Real> x;
+  Real X[3*3];
+  for (CellH c = m.cellBegin(), c_end = m.cellEnd(); c != c_end; ++c)
+  {
+    cells.push_back(c);
+    c.verticesCoord(&m, X);
+    for (int i = 0; i < 3; ++i)
+      x.push_back((X[i] + X[3 + i] + X[6 + i])/3.);
+  }
+  int const nc = cells.size();
+  std::vector<Real> xi(2*nc);
+  CellGeometry G(TRIANGLE, 3);
+  EXPECT_EQ(nc, G.inverseMap(&m, &cells[0], nc, &x[0], &xi[0]));
+  for (int k = 0; k < 2*nc; ++k)
+    EXPECT_NEAR(1./3., xi[k], 1e-12);
+}
+
+TEST(GeometryTests, ReferenceTensors)
+{
+  // against quadratures through CellGeometry on deformed simplices, also in higher space dimension
+  int const cases[5][3] = {{1, 2, 2}, {2, 2, 1}, {2, 3, 2}, {3, 3, 1}, {3, 3, 2}}; // dim, sdim, degree
+  for (int t = 0; t < 5; ++t)
+  {
+    int const dim = cases[t][0], sdim = cases[t][1], deg = cases[t][2];
+    ECellType const ct = dim == 1 ? EDGE : (dim == 2 ? TRIANGLE : TETRAHEDRON);
+    ReferenceTensors const& R = ReferenceTensors::get(ct, deg);
+    EXPECT_EQ(&R, &ReferenceTensors::get(ct, deg));
+    int const n = R.numDofs();
+
+    std::vector<Real> X;
+    deformedSimplex(dim, sdim, t, X);
+    Quadrature const quadr(ct, 3*deg);
+    CellGeometry G(ct, sdim);
+    G.setPoints(quadr);
+    G.compute(1, &X[0]);
+
+    ShapeFunction sf;
+    sf.setType("Lagrange", dim, deg);
+    std::vector<Real> pts, vals(sf.tabulateSize(quadr.numPoints(), 0)), grads(sf.tabulateSize(quadr.numPoints(), 1));
+    for (int qp = 0; qp < quadr.numPoints(); ++qp)
+      for (int j = 0; j < dim; ++j)
+        pts.push_back(quadr.point(qp)[j]);
+    sf.tabulate(quadr.numPoints(), &pts[0], 0, &vals[0]);
+    sf.tabulate(quadr.numPoints(), &pts[0], 1, &grads[0]);
+
+    std::vector<Real> u(n*sdim);
+    for (int k = 0; k < n*sdim; ++k)
+      u[k] = std::sin(1. + 2.*k);
+
+    std::vector<Real> M0(n*n, 0.), K0(n*n, 0.), C0(n*n, 0.);
+    for (int qp = 0; qp < quadr.numPoints(); ++qp)
+    {
+      Real const w = G.JxW(0)[qp];
+      Real gx[20][3], uq[3] = {0, 0, 0}; // physical gradients, velocity
+      for (int a = 0; a < n; ++a)
+        for (int i = 0; i < sdim; ++i)
+        {
+          gx[a][i] = 0;
+          for (int j = 0; j < dim; ++j)
+            gx[a][i] += grads[(qp*n + a)*dim + j]*G.invJacobian(0, j, i)[qp];
+          uq[i] += vals[qp*n + a]*u[a*sdim + i];
+        }
+      for (int a = 0; a < n; ++a)
+        for (int b = 0; b < n; ++b)
+        {
+          M0[a*n + b] += w*vals[qp*n + a]*vals[qp*n + b];
+          for (int i = 0; i < sdim; ++i)
+          {
+            K0[a*n + b] += w*gx[a][i]*gx[b][i];
+            C0[a*n + b] += w*vals[qp*n + a]*uq[i]*gx[b][i];
+          }
+        }
+    }
+
+    Real invJ[9];
+    for (int j = 0; j < dim; ++j)
+      for (int i = 0; i < sdim; ++i)
+        invJ[j*sdim + i] = G.invJacobian(0, j, i)[0];
+    std::vector<Real> M(n*n), K(n*n), C(n*n);
+    R.massMatrix(G.detJacobian(0)[0], &M[0]);
+    R.laplaceMatrix(G.detJacobian(0)[0], invJ, sdim, &K[0]);
+    R.convectionMatrix(G.detJacobian(0)[0], invJ, sdim, &u[0], &C[0]);
+    for (int k = 0; k < n*n; ++k)
+    {
+      ASSERT_NEAR(M0[k], M[k], 1e-12) << "case " << t;
+      ASSERT_NEAR(K0[k], K[k], 1e-11) << "case " << t;
+      ASSERT_NEAR(C0[k], C[k], 1e-11) << "case " << t;
+    }
+  }
+
+  // P1 Laplace matrices of a mesh, from its geometry cache
+  typedef MeshTet::CellH CellH;
+  MeshTet m;
+  MeshIoMsh<MeshTet> io;
+  io.readFile("meshes/simple_tet0.msh", &m);
+  m.enableGeometryCache();
+  m.updateGeometryCache();
+  std::vector<CellH> cells;
+  for (CellH c = m.cellBegin(), c_end = m.cellEnd(); c != c_end; ++c)
+    cells.push_back(c);
+  int const nc = cells.size();
+  ReferenceTensors const& R = ReferenceTensors::get(TETRAHEDRON, 1);
+  std::vector<Real> K(nc*16);
+  R.laplaceMatrices(&m, &cells[0], nc, &K[0]);
+
+  CellGeometry G(TETRAHEDRON, 3);
+  G.setPoints(Quadrature(TETRAHEDRON, 1));
+  G.compute(&m, &cells[0], nc);
+  for (int k = 0; k < nc; ++k)
+  {
+    Real invJ[9], Kk[16];
+    for (int n = 0; n < 9; ++n)
+      invJ[n] = G.invJacobian(k, n/3, n%3)[0];
+    R.laplaceMatrix(G.detJacobian(k)[0], invJ, 3, Kk);
+    for (int a = 0; a < 16; ++a)
+      ASSERT_NEAR(Kk[a], K[k*16 + a], 1e-12);
+    for (int a = 0; a < 4; ++a)
+      EXPECT_NEAR(0., K[k*16 + a*4] + K[k*16 + a*4 + 1] + K[k*16 + a*4 + 2] + K[k*16 + a*4 + 3], 1e-12);
+  }
+}
+
+TEST(GeometryTests, MeshCells)
+{
+  typedef MeshTet::CellH CellH;
+  MeshTet m;
+  MeshIoMsh<MeshTet> io;
+  io.readFile("meshes/simple_tet0.msh", &m);
+
+  std::vector<CellH> cells;
+  for (CellH c = m.cellBegin(), c_end = m.cellEnd(); c != c_end; ++c)
+    cells.push_back(c);
+  int const nc = cells.size();
+
+  CellGeometry G(TETRAHEDRON, 3);
+  G.setPoints(Quadrature(TETRAHEDRON, 2));
+  G.compute(&m, &cells[0], nc);
+
+  Real x[4*3];
+  for (int k = 0; k < nc; ++k)
+  {
+    cells[k].verticesCoord(&m, x);
+    Real const e[3][3] = {{x[3]-x[0], x[4]-x[1], x[5]-x[2]},
+                          {x[6]-x[0], x[7]-x[1], x[8]-x[2]},
+                          {x[9]-x[0], x[10]-x[1], x[11]-x[2]}};
+    Real vol = 0;
+    for (int qp = 0; qp < G.numPointsPadded(); ++qp)
+      vol += G.JxW(k)[qp];
+    ASSERT_NEAR(std::fabs(det3(e[0], e[1], e[2]))/6., vol, 1e-13);
+  }
+}
+
 } // SHAPEF_TEST_CPP
 